@@ -0,0 +1,40 @@
+#pragma once
+/*
+Helpers used in pretty much all benchmarks
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// number of distinct plates (AAA000 - ZZZ999)
+#define BENCH_PLATE_SPACE 17576000ULL
+
+// monotonic time in nanoseconds
+static inline uint64_t bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// nth distinct plate in a scrambled order, so that consecutive n don't give
+// neighbouring plates. plate must hold 7 chars, it is null-terminated
+static inline void bench_nth_plate(uint64_t n, char *plate) {
+  // 7919 is coprime with the plate space so this is a permutation
+  n = (n * 7919) % BENCH_PLATE_SPACE;
+  for (int j = 5; j >= 3; j--) {
+    plate[j] = '0' + n % 10;
+    n /= 10;
+  }
+  for (int j = 2; j >= 0; j--) {
+    plate[j] = 'A' + n % 26;
+    n /= 26;
+  }
+  plate[6] = '\0';
+}
+
+// print a heading in yellow like the tests do
+static inline void bench_heading(const char *name) {
+  printf("\033[0;33m%s\033[0m\n", name);
+}
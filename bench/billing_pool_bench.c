@@ -0,0 +1,91 @@
+/*
+Allocations and time per car lifecycle in the billing table, with every item
+malloc'd on its own (htab_create) against items from a slab pool
+(htab_create_pooled).
+
+  ./build/bench/billing_pool_bench [num_cars] [visits_per_car]
+
+A lifecycle is what the manager does for one visit: upsert the entry time at
+the entrance, then look it up at the exit. "churn" also removes the car once
+it's billed, like a manager that only keeps cars that are still parked.
+Without a pool every pool_alloc would have been a malloc, so the pool's
+allocs count is the "before" figure and its system_allocs the "after".
+*/
+#include "bench.h"
+#include "hashtable.h"
+
+static void bench_billing(const char *name, char (*plates)[7], size_t cars,
+                          size_t visits, bool pooled, bool churn) {
+  ht_t *h = NULL;
+  h = pooled ? htab_create_pooled(h, 5) : htab_create(h, 5);
+  size_t lifecycles = cars * visits;
+  uint64_t start = bench_now_ns();
+  for (size_t v = 0; v < visits; v++) {
+    for (size_t i = 0; i < cars; i++) {
+      long long *entry_time =
+          htab_upsert(h, plates[i], sizeof(long long), NULL);
+      *entry_time = (long long)v;
+      // the exit reads it back
+      entry_time = htab_get(h, plates[i]);
+      if (churn) {
+        htab_remove(h, plates[i]);
+      }
+    }
+  }
+  uint64_t lifecycle_ns = bench_now_ns() - start;
+  start = bench_now_ns();
+  htab_destroy(h);
+  uint64_t destroy_ns = bench_now_ns() - start;
+  printf("%-14s %8zu cars x %zu | %6.1f ns/lifecycle | destroy %7.2f ms\n",
+         name, cars, visits, (double)lifecycle_ns / lifecycles,
+         destroy_ns / 1e6);
+}
+
+// pooled run again, just to read the counts
+static void report_allocs(const char *name, char (*plates)[7], size_t cars,
+                          size_t visits, bool churn) {
+  ht_t *h = NULL;
+  h = htab_create_pooled(h, 5);
+  for (size_t v = 0; v < visits; v++) {
+    for (size_t i = 0; i < cars; i++) {
+      long long *entry_time =
+          htab_upsert(h, plates[i], sizeof(long long), NULL);
+      *entry_time = (long long)v;
+      if (churn) {
+        htab_remove(h, plates[i]);
+      }
+    }
+  }
+  struct pool_stats stats;
+  pool_get_stats(htab_pool(h), &stats);
+  double lifecycles = (double)cars * visits;
+  printf("%-14s allocations per lifecycle: %.3f malloc without pool, %.6f "
+         "malloc with pool (%zu slabs)\n",
+         name, stats.allocs / lifecycles, stats.system_allocs / lifecycles,
+         stats.slabs);
+  htab_destroy(h);
+}
+
+int main(int argc, char *argv[]) {
+  size_t cars = argc > 1 ? strtoull(argv[1], NULL, 10) : 100000;
+  size_t visits = argc > 2 ? strtoull(argv[2], NULL, 10) : 10;
+  char(*plates)[7] = malloc(cars * sizeof(*plates));
+  if (!plates) {
+    perror("malloc plates");
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < cars; i++) {
+    bench_nth_plate(i, plates[i]);
+  }
+
+  bench_heading("Billing Pool Benchmark");
+  bench_billing("malloc", plates, cars, visits, false, false);
+  bench_billing("pool", plates, cars, visits, true, false);
+  bench_billing("malloc churn", plates, cars, visits, false, true);
+  bench_billing("pool churn", plates, cars, visits, true, true);
+  report_allocs("billing", plates, cars, visits, false);
+  report_allocs("churn", plates, cars, visits, true);
+
+  free(plates);
+  return 0;
+}
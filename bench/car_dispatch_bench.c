@@ -0,0 +1,152 @@
+/*
+Dispatching new cars to idle car threads, like the simulator's main loop
+handing cars to its car threads, comparing:
+  queue    Queue, a mutex and one condition variable that every push
+           broadcasts on (how car_queue used to work)
+  ring     Ring, the bounded lock-free ring where a push wakes one thread
+
+  ./build/bench/car_dispatch_bench [num_cars] [num_threads]
+
+One producer pushes num_cars (default 20000) cars as fast as it can to
+num_threads (default 200, what the simulator starts for the default car park)
+threads that do nothing with them.
+Reports cars per second and how many times a thread woke up per car.
+*/
+#include "bench.h"
+#include "queue.h"
+#include <pthread.h>
+
+// same size as the simulator's ct_data
+struct car {
+  void *entry_queue;
+  uint64_t plate;
+  void *shm;
+};
+
+static size_t num_cars = 20000;
+static int num_threads = 200;
+
+static Queue *queue;
+static Ring *ring;
+static volatile int queue_run;
+static long wakeups;
+static long cars_taken;
+
+static void *queue_worker(void *arg) {
+  (void)arg;
+  long woke = 0;
+  while (1) {
+    QItem *item = NULL;
+    pthread_mutex_lock(&queue->mutex);
+    // like car_handler had, but checking for a car before waiting (the old
+    // loop always waited first, so a burst of cars could be left sitting in
+    // the queue with every thread asleep)
+    while ((item = unsafe_queue_pop_return(queue)) == NULL && queue_run) {
+      pthread_cond_wait(&queue->condition, &queue->mutex);
+      woke++;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    if (item == NULL) {
+      break;
+    }
+    free(item->value);
+    free(item);
+    __atomic_fetch_add(&cars_taken, 1, __ATOMIC_RELEASE);
+  }
+  __atomic_fetch_add(&wakeups, woke, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+static void *ring_worker(void *arg) {
+  (void)arg;
+  long woke = 0;
+  struct car car;
+  // at most one wakeup per pop
+  while (ring_pop(ring, &car)) {
+    woke++;
+    __atomic_fetch_add(&cars_taken, 1, __ATOMIC_RELEASE);
+  }
+  __atomic_fetch_add(&wakeups, woke, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+static void report(const char *name, uint64_t ns) {
+  printf("%-6s %4d threads | %9.0f cars/s | %6.2f wakeups/car | taken %ld\n",
+         name, num_threads, num_cars / (ns / 1e9), (double)wakeups / num_cars,
+         cars_taken);
+}
+
+static void bench_queue(pthread_t *threads) {
+  queue = queue_create(0);
+  queue_run = 1;
+  wakeups = cars_taken = 0;
+  for (int i = 0; i < num_threads; i++) {
+    pthread_create(&threads[i], NULL, queue_worker, NULL);
+  }
+  struct car car = {0};
+  uint64_t start = bench_now_ns();
+  for (size_t i = 0; i < num_cars; i++) {
+    car.plate = i;
+    queue_push(queue, &car, sizeof(car));
+  }
+  // wait for every car to be taken
+  while (__atomic_load_n(&cars_taken, __ATOMIC_ACQUIRE) < (long)num_cars) {
+    sched_yield();
+  }
+  uint64_t ns = bench_now_ns() - start;
+  pthread_mutex_lock(&queue->mutex);
+  queue_run = 0;
+  pthread_cond_broadcast(&queue->condition);
+  pthread_mutex_unlock(&queue->mutex);
+  for (int i = 0; i < num_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  report("queue", ns);
+  destroy_queue(queue);
+}
+
+static void bench_ring(pthread_t *threads) {
+  ring = ring_create(num_threads, sizeof(struct car));
+  wakeups = cars_taken = 0;
+  for (int i = 0; i < num_threads; i++) {
+    pthread_create(&threads[i], NULL, ring_worker, NULL);
+  }
+  struct car car = {0};
+  uint64_t start = bench_now_ns();
+  for (size_t i = 0; i < num_cars; i++) {
+    car.plate = i;
+    while (!ring_push(ring, &car)) {
+      sched_yield();
+    }
+  }
+  // wait for every car to be taken
+  while (__atomic_load_n(&cars_taken, __ATOMIC_ACQUIRE) < (long)num_cars) {
+    sched_yield();
+  }
+  uint64_t ns = bench_now_ns() - start;
+  ring_close(ring);
+  for (int i = 0; i < num_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  report("ring", ns);
+  ring_destroy(ring);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    num_cars = strtoull(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    num_threads = atoi(argv[2]);
+  }
+  pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+  if (!threads) {
+    perror("malloc threads");
+    exit(EXIT_FAILURE);
+  }
+  bench_heading("Car Dispatch Benchmark");
+  bench_queue(threads);
+  bench_ring(threads);
+  free(threads);
+  return 0;
+}
@@ -0,0 +1,98 @@
+/*
+Cost of letting cars through an entrance queue as it gets longer, every
+queued car waiting for its turn like the simulator's car threads do.
+
+  ./build/bench/entry_queue_bench [num_admissions] [max_waiting]
+
+  shared    every car sleeps on one condition, each pop broadcasts and every
+            car wakes to check if it's at the front now
+  targeted  iqueue_wait_front, each car sleeps on its own condition and a
+            pop only wakes the car behind it
+
+All the cars are queued before their threads start, so every one of them is
+asleep in the queue while the queue drains (the times include starting the
+threads). This is repeated until num_admissions (default 20000) cars have
+been let in.
+*/
+#include "bench.h"
+#include "queue.h"
+#include <pthread.h>
+
+static size_t num_admissions = 20000;
+
+struct entrance {
+  IQueue *q;
+  // only used by the shared version
+  pthread_cond_t condition;
+};
+
+struct car {
+  struct entrance *e;
+  QNode node;
+};
+
+static void *shared_car(void *arg) {
+  struct car *car = arg;
+  struct entrance *e = car->e;
+  pthread_mutex_lock(&e->q->mutex);
+  while (iqueue_peek(e->q) != &car->node) {
+    pthread_cond_wait(&e->condition, &e->q->mutex);
+  }
+  unsafe_iqueue_pop_return(e->q);
+  pthread_cond_broadcast(&e->condition);
+  pthread_mutex_unlock(&e->q->mutex);
+  return NULL;
+}
+
+static void *targeted_car(void *arg) {
+  struct car *car = arg;
+  iqueue_wait_front(car->e->q, &car->node);
+  iqueue_pop(car->e->q);
+  return NULL;
+}
+
+static void run(const char *name, void *(*car_fn)(void *), size_t waiting) {
+  struct entrance e = {iqueue_create(0), PTHREAD_COND_INITIALIZER};
+  struct car *cars = calloc(waiting, sizeof(struct car));
+  pthread_t *threads = malloc(waiting * sizeof(pthread_t));
+  size_t admitted = 0;
+  uint64_t ns = 0;
+  while (admitted < num_admissions) {
+    for (size_t i = 0; i < waiting; i++) {
+      cars[i].e = &e;
+      iqueue_push(e.q, &cars[i].node);
+    }
+    uint64_t start = bench_now_ns();
+    // start from the back so the front cars' threads aren't ahead
+    for (size_t i = waiting; i-- > 0;) {
+      pthread_create(&threads[i], NULL, car_fn, &cars[i]);
+    }
+    for (size_t i = 0; i < waiting; i++) {
+      pthread_join(threads[i], NULL);
+    }
+    ns += bench_now_ns() - start;
+    admitted += waiting;
+  }
+  printf("%-8s %5zu waiting | %8.0f cars/s | %7.2f us/car\n", name, waiting,
+         admitted * 1e9 / ns, (double)ns / admitted / 1000);
+  free(threads);
+  free(cars);
+  pthread_cond_destroy(&e.condition);
+  destroy_iqueue(e.q);
+}
+
+int main(int argc, char *argv[]) {
+  size_t max_waiting = 256;
+  if (argc > 1) {
+    num_admissions = strtoull(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    max_waiting = strtoull(argv[2], NULL, 10);
+  }
+  bench_heading("Entry Queue Benchmark");
+  for (size_t waiting = 4; waiting <= max_waiting; waiting *= 4) {
+    run("shared", shared_car, waiting);
+    run("targeted", targeted_car, waiting);
+  }
+  return 0;
+}
@@ -0,0 +1,116 @@
+/*
+Lookup throughput of the chained hashtable (htab_*) for 100k, 1M and 10M
+plates, comparing:
+  djb      djb_hash, one htab_find at a time (the original lookup path)
+  hash     htab_hash, one htab_find at a time
+  batch    htab_hash, htab_find_batch over BATCH_SIZE keys at a time
+
+  ./build/bench/htab_batch_bench [max_plates]
+
+Every plate is looked up once in a random order, like replaying recorded LPR
+traffic, along with the average chain length each hash gives.
+*/
+#include "bench.h"
+#include "hashtable.h"
+
+// keys handed to htab_find_batch per call, like a page of recorded traffic
+#define BATCH_SIZE 256
+
+static ht_t *fill(char (*plates)[7], size_t n, htab_hash_fn hash) {
+  long long entry_time = 0;
+  ht_t *h = NULL;
+  h = htab_create(h, 5);
+  htab_set_hash(h, hash);
+  htab_reserve(h, n);
+  for (size_t i = 0; i < n; i++) {
+    htab_set(h, plates[i], &entry_time, sizeof(long long));
+  }
+  return h;
+}
+
+// average number of keys compared per successful lookup
+static double avg_chain(ht_t *h, char (*plates)[7], size_t n,
+                        htab_hash_fn hash) {
+  // count, for every bucket, how many of the plates land in it
+  size_t capacity = htab_capacity(h);
+  size_t *counts = calloc(capacity, sizeof(size_t));
+  for (size_t i = 0; i < n; i++) {
+    counts[hash(plates[i]) & (capacity - 1)]++;
+  }
+  // a plate k deep in a chain takes k compares
+  double compares = 0;
+  for (size_t b = 0; b < capacity; b++) {
+    compares += counts[b] * (counts[b] + 1) / 2.0;
+  }
+  free(counts);
+  return compares / n;
+}
+
+static void bench_single(const char *name, char (*plates)[7], char **keys,
+                         size_t n, htab_hash_fn hash) {
+  ht_t *h = fill(plates, n, hash);
+  size_t found = 0;
+  uint64_t start = bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    found += htab_find(h, keys[i]) != NULL;
+  }
+  uint64_t ns = bench_now_ns() - start;
+  printf("%-6s %9zu plates | %7.1f ns/lookup | chain %.2f | found %zu\n", name,
+         n, (double)ns / n, avg_chain(h, plates, n, hash), found);
+  htab_destroy(h);
+}
+
+static void bench_batch(const char *name, char (*plates)[7], char **keys,
+                        size_t n) {
+  ht_t *h = fill(plates, n, htab_hash);
+  item_t *items[BATCH_SIZE];
+  size_t found = 0;
+  uint64_t start = bench_now_ns();
+  for (size_t i = 0; i < n; i += BATCH_SIZE) {
+    size_t batch = n - i < BATCH_SIZE ? n - i : BATCH_SIZE;
+    found += htab_find_batch(h, &keys[i], batch, items);
+  }
+  uint64_t ns = bench_now_ns() - start;
+  printf("%-6s %9zu plates | %7.1f ns/lookup | chain %.2f | found %zu\n", name,
+         n, (double)ns / n, avg_chain(h, plates, n, htab_hash), found);
+  htab_destroy(h);
+}
+
+int main(int argc, char *argv[]) {
+  size_t sizes[] = {100000, 1000000, 10000000};
+  size_t max_plates = argc > 1 ? strtoull(argv[1], NULL, 10) : sizes[2];
+
+  bench_heading("Hashtable Batch Lookup Benchmark");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    size_t n = sizes[s];
+    if (n > max_plates) {
+      break;
+    }
+    char(*plates)[7] = malloc(n * sizeof(*plates));
+    char **keys = malloc(n * sizeof(char *));
+    if (!plates || !keys) {
+      perror("malloc plates");
+      exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < n; i++) {
+      bench_nth_plate(i, plates[i]);
+    }
+    // shuffle the lookups so no hash gets lucky with the order they come in
+    srand(1);
+    for (size_t i = 0; i < n; i++) {
+      keys[i] = plates[i];
+    }
+    for (size_t i = n - 1; i > 0; i--) {
+      size_t j = ((size_t)rand() * RAND_MAX + rand()) % (i + 1);
+      char *tmp = keys[i];
+      keys[i] = keys[j];
+      keys[j] = tmp;
+    }
+    bench_single("hash", plates, keys, n, htab_hash);
+    bench_single("djb", plates, keys, n, djb_hash);
+    bench_batch("batch", plates, keys, n);
+    free(plates);
+    free(keys);
+  }
+  return 0;
+}
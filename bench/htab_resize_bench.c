@@ -0,0 +1,72 @@
+/*
+Worst-case insert latency of the chained hashtable (htab_*) while it grows from
+10 buckets to millions of items, the way billing_ht and the whitelist do.
+
+  ./build/bench/htab_resize_bench [num_plates]
+
+Compares one-shot resizing, incremental resizing (htab_set_incremental) and
+pre-sizing with htab_reserve. The max is the insert that stalled the longest,
+which is what an LPR handler holding billing_mutex would see.
+*/
+#include "bench.h"
+#include "hashtable.h"
+#include <malloc.h>
+
+// same start size as the manager's tables
+#define START_CAPACITY 10
+
+// sorted latencies -> nth percentile
+static int cmp_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void bench_inserts(const char *name, char (*plates)[7], size_t n,
+                          bool incremental, bool reserve, uint64_t *lat) {
+  long long entry_time = 0;
+  ht_t *h = NULL;
+  h = htab_create(h, START_CAPACITY);
+  htab_set_incremental(h, incremental);
+  uint64_t start = bench_now_ns();
+  if (reserve) {
+    htab_reserve(h, n);
+  }
+  for (size_t i = 0; i < n; i++) {
+    uint64_t t0 = bench_now_ns();
+    htab_set(h, plates[i], &entry_time, sizeof(long long));
+    lat[i] = bench_now_ns() - t0;
+  }
+  uint64_t total_ns = bench_now_ns() - start;
+  qsort(lat, n, sizeof(uint64_t), cmp_u64);
+  printf("%-12s %9zu plates | total %7.1f ms | p50 %6llu ns | p99.9 %7llu ns "
+         "| max %10llu ns\n",
+         name, n, total_ns / 1e6, (unsigned long long)lat[n / 2],
+         (unsigned long long)lat[n - n / 1000 - 1],
+         (unsigned long long)lat[n - 1]);
+  htab_destroy(h);
+  // hand the millions of freed items back now, otherwise malloc tidies them
+  // up inside whichever insert of the next run happens to trigger it
+  malloc_trim(0);
+}
+
+int main(int argc, char *argv[]) {
+  size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 2000000;
+  char(*plates)[7] = malloc(n * sizeof(*plates));
+  uint64_t *lat = malloc(n * sizeof(uint64_t));
+  if (!plates || !lat) {
+    perror("malloc plates");
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < n; i++) {
+    bench_nth_plate(i, plates[i]);
+  }
+
+  bench_heading("Hashtable Resize Benchmark");
+  bench_inserts("one-shot", plates, n, false, false, lat);
+  bench_inserts("incremental", plates, n, true, false, lat);
+  bench_inserts("reserved", plates, n, false, true, lat);
+
+  free(plates);
+  free(lat);
+  return 0;
+}
@@ -0,0 +1,214 @@
+/*
+Picking a level for every car let in, with each of the level policies in
+libs/occupancy.h (LEVEL_POLICY in src/config.h):
+  random         a random level with room, what the manager has always done
+  least-loaded   the emptiest level, off a tournament tree of the counts
+  round-robin    each level in turn, from one counter for every entrance
+  spread         each level in turn from a counter per entrance, entrances
+                 starting on different levels
+
+  ./build/bench/level_policy_bench [cars_per_entrance] [num_entrances]
+                                   [num_levels] [ignore_pct] [load_pct]
+
+An entrance thread for each of num_entrances (default NUM_ENTRANCES) lets
+cars_per_entrance (default 1M) cars in as fast as it can. Each wants its
+share of load_pct (default 110) of the spots (LEVEL_CAPACITY a level) parked,
+so past 100 there are more cars than spots. One of its parked cars leaves
+before each new one once it has its share, or after a car was turned away.
+Like the manager, a car claims its spot with occ_try_add as soon as its level
+is picked, picking again if another entrance filled the level first, and is
+turned away once every level is full. ignore_pct (default 10) of cars ignore
+the sign and go to a random level, moving their spot there if it has room
+and keeping the one they were given if it's full (the manager's "Car trying
+to enter full level").
+Reports admissions per second, how many cars were turned away with the car
+park full, how many went to a full level, how many picks another entrance
+filled first, how many times a level was seen over capacity (never, with
+occ_try_add) and how far apart the fullest and emptiest levels were on
+average.
+*/
+#include "bench.h"
+#include "config.h"
+#include "occupancy.h"
+#include <pthread.h>
+#include <sched.h>
+
+// average the level spread over a sample every this many cars
+#define SAMPLE_EVERY 1024
+
+struct policy {
+  const char *name;
+  occ_policy_fn pick;
+};
+
+static const struct policy policies[] = {
+    {"random", occ_random},
+    {"least-loaded", occ_least_loaded},
+    {"round-robin", occ_round_robin},
+    {"spread", occ_spread},
+};
+
+static size_t cars_per_entrance = 1000000;
+static int num_entrances = NUM_ENTRANCES;
+static int num_levels = NUM_LEVELS;
+static int ignore_pct = 10;
+static int load_pct = 110;
+
+struct entrance {
+  pthread_t thread;
+  int id;
+  const struct policy *policy;
+  occupancy_t *o;
+  pthread_barrier_t *start;
+  int *parked; // level of each of its parked cars
+  int share;   // cars it keeps parked
+  size_t admitted;
+  size_t full;        // sign said full, turned away
+  size_t wrong_level; // ignored the sign and went to a full level
+  size_t lost;        // picked a level another entrance filled first
+  size_t over;        // saw a level over capacity
+  double spread_sum;  // fullest minus emptiest level, summed over samples
+  size_t samples;
+};
+
+static void *let_cars_in(void *arg) {
+  struct entrance *e = arg;
+  unsigned seed = 7919 * (e->id + 1);
+  int num_parked = 0;
+  bool turned_away = false;
+  pthread_barrier_wait(e->start);
+  for (size_t car = 0; car < cars_per_entrance; car++) {
+    if (num_parked > 0 && (num_parked >= e->share || turned_away)) {
+      // a car leaves to make room
+      int leaving = rand_r(&seed) % num_parked;
+      occ_add(e->o, e->parked[leaving], -1);
+      e->parked[leaving] = e->parked[--num_parked];
+    }
+    // pick and claim a level like the manager's entry_decide
+    int level;
+    for (;;) {
+      level = e->policy->pick(e->o, e->id, rand_r(&seed));
+      if (level == -1 ? occ_num_free(e->o) == 0 : occ_try_add(e->o, level)) {
+        break;
+      }
+      e->lost++;
+      sched_yield(); // let whoever filled it finish updating the counts
+    }
+    turned_away = level == -1;
+    if (turned_away) {
+      e->full++;
+      continue;
+    }
+    if (rand_r(&seed) % 100 < ignore_pct) {
+      int went = rand_r(&seed) % num_levels;
+      if (went != level && occ_try_add(e->o, went)) {
+        occ_add(e->o, level, -1);
+        level = went;
+      } else if (went != level) {
+        e->wrong_level++; // keeps the spot it was given
+      }
+    }
+    if (occ_cars(e->o, level) > LEVEL_CAPACITY) {
+      e->over++;
+    }
+    e->parked[num_parked++] = level;
+    e->admitted++;
+    if (e->id == 0 && car % SAMPLE_EVERY == 0) {
+      int most = 0, least = LEVEL_CAPACITY;
+      for (int l = 0; l < num_levels; l++) {
+        int cars = occ_cars(e->o, l);
+        most = cars > most ? cars : most;
+        least = cars < least ? cars : least;
+      }
+      e->spread_sum += most - least;
+      e->samples++;
+    }
+  }
+  return NULL;
+}
+
+static void bench_policy(const struct policy *policy) {
+  occupancy_t *o = occ_create(num_levels, LEVEL_CAPACITY);
+  struct entrance *entrances = calloc(num_entrances, sizeof(struct entrance));
+  if (o == NULL || entrances == NULL) {
+    perror("level policy bench");
+    exit(EXIT_FAILURE);
+  }
+  int share = num_levels * LEVEL_CAPACITY * load_pct / 100 / num_entrances;
+  pthread_barrier_t start;
+  pthread_barrier_init(&start, NULL, num_entrances + 1);
+  for (int i = 0; i < num_entrances; i++) {
+    struct entrance *e = &entrances[i];
+    e->id = i;
+    e->policy = policy;
+    e->o = o;
+    e->start = &start;
+    e->share = share > 0 ? share : 1;
+    e->parked = calloc(e->share, sizeof(int));
+    if (e->parked == NULL) {
+      perror("level policy bench");
+      exit(EXIT_FAILURE);
+    }
+    pthread_create(&e->thread, NULL, let_cars_in, e);
+  }
+  pthread_barrier_wait(&start);
+  uint64_t begin = bench_now_ns();
+  for (int i = 0; i < num_entrances; i++) {
+    pthread_join(entrances[i].thread, NULL);
+  }
+  uint64_t elapsed = bench_now_ns() - begin;
+
+  size_t admitted = 0, full = 0, wrong_level = 0, lost = 0, over = 0;
+  for (int i = 0; i < num_entrances; i++) {
+    admitted += entrances[i].admitted;
+    full += entrances[i].full;
+    wrong_level += entrances[i].wrong_level;
+    lost += entrances[i].lost;
+    over += entrances[i].over;
+    free(entrances[i].parked);
+  }
+  double cars = (double)cars_per_entrance * num_entrances;
+  printf("%-12s | %9.2f M/s | %6.2f%% | %6.2f%% | %6.2f%% | %8zu | %7.2f\n",
+         policy->name, admitted / (elapsed / 1e9) / 1e6, 100.0 * full / cars,
+         100.0 * wrong_level / cars, 100.0 * lost / cars, over,
+         entrances[0].samples ? entrances[0].spread_sum / entrances[0].samples
+                              : 0.0);
+  pthread_barrier_destroy(&start);
+  free(entrances);
+  occ_destroy(o);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    cars_per_entrance = strtoull(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    num_entrances = atoi(argv[2]);
+  }
+  if (argc > 3) {
+    num_levels = atoi(argv[3]);
+  }
+  if (argc > 4) {
+    ignore_pct = atoi(argv[4]);
+  }
+  if (argc > 5) {
+    load_pct = atoi(argv[5]);
+  }
+  if (num_entrances < 1 || num_levels < 1 || num_levels > OCC_MAX_LEVELS) {
+    fprintf(stderr, "need at least one entrance and level\n");
+    return EXIT_FAILURE;
+  }
+  bench_heading("Level allocation policies");
+  printf("%zu cars through each of %d entrances, %d levels of %d, %d%% "
+         "load, %d%% ignore the sign\n",
+         cars_per_entrance, num_entrances, num_levels, LEVEL_CAPACITY,
+         load_pct, ignore_pct);
+  printf("policy       | admissions    | turned  | wrong   | lost    | "
+         "over     | spread\n");
+  printf("             |               | away    | level   | picks   | "
+         "capacity | (cars)\n");
+  for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+    bench_policy(&policies[i]);
+  }
+  return 0;
+}
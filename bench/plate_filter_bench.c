@@ -0,0 +1,96 @@
+/*
+Cost of turning away plates that aren't on the whitelist, for whitelists of
+100k, 1M and 10M plates, comparing:
+  table    wl_contains straight away (how the entrance checked before)
+  filter   wl_maybe_contains first, wl_contains only if the filter lets the
+           plate through (how the entrance checks now)
+for plates on the list and plates that aren't (random_available_plate gives
+half and half), along with how many unknown plates got past the filter.
+
+  ./build/bench/plate_filter_bench [max_plates]
+*/
+#include "bench.h"
+#include "whitelist.h"
+
+#define TEXT_PATH "/tmp/plate_filter_bench.txt"
+#define IMAGE_PATH "/tmp/plate_filter_bench.wl"
+
+// look plates up in a different order to the file (7919 is coprime with
+// every n we use)
+#define LOOKUP(i, n) (((i) * 7919) % (n))
+
+static void bench(size_t n) {
+  // the first n plates go on the list, the next n are the same but lower case
+  // so they are never on it
+  FILE *fp = fopen(TEXT_PATH, "w");
+  plate_t *plates = malloc(2 * n * sizeof(plate_t));
+  if (fp == NULL || plates == NULL) {
+    perror("writing plates");
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < n; i++) {
+    char plate[7];
+    bench_nth_plate(i, plate);
+    plates[i] = plate_encode(plate);
+    fprintf(fp, "%s\n", plate);
+    plate[0] += 'a' - 'A';
+    plates[n + i] = plate_encode(plate);
+  }
+  fclose(fp);
+  if (!wl_compile(TEXT_PATH, IMAGE_PATH, WL_FILTER_BITS)) {
+    perror("compiling whitelist");
+    exit(EXIT_FAILURE);
+  }
+  wl_t *wl = wl_open(IMAGE_PATH);
+
+  // plates on the list, then plates that aren't
+  uint64_t table_ns[2], filter_ns[2];
+  size_t found = 0;
+  for (int unknown = 0; unknown < 2; unknown++) {
+    plate_t *lookups = plates + unknown * n;
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < n; i++) {
+      found += wl_contains(wl, lookups[LOOKUP(i, n)]);
+    }
+    table_ns[unknown] = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    for (size_t i = 0; i < n; i++) {
+      plate_t plate = lookups[LOOKUP(i, n)];
+      found += wl_maybe_contains(wl, plate) && wl_contains(wl, plate);
+    }
+    filter_ns[unknown] = bench_now_ns() - start;
+  }
+
+  size_t false_positives = 0;
+  for (size_t i = n; i < 2 * n; i++) {
+    false_positives += wl_maybe_contains(wl, plates[i]);
+  }
+
+  if (found != 2 * n) {
+    printf("found %zu/%zu plates\n", found, 2 * n);
+  }
+  printf("%9zu plates | known: table %6.1f ns, filter %6.1f ns | unknown: "
+         "table %6.1f ns, filter %6.1f ns | %.2f%% unknown got through\n",
+         n, (double)table_ns[0] / n, (double)filter_ns[0] / n,
+         (double)table_ns[1] / n, (double)filter_ns[1] / n,
+         100.0 * false_positives / n);
+  wl_close(wl);
+  free(plates);
+  remove(TEXT_PATH);
+  remove(IMAGE_PATH);
+}
+
+int main(int argc, char *argv[]) {
+  size_t sizes[] = {100000, 1000000, 10000000};
+  size_t max_plates = argc > 1 ? strtoull(argv[1], NULL, 10) : sizes[2];
+
+  bench_heading("Plate Filter Benchmark");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    if (sizes[s] > max_plates) {
+      break;
+    }
+    bench(sizes[s]);
+  }
+  return 0;
+}
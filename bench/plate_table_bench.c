@@ -0,0 +1,125 @@
+/*
+Compare the chained string hashtable (htab_*) against the open-addressing
+plate table (ptab_*) for whitelists of 100, 100k and 10M plates.
+
+  ./build/bench/plate_table_bench [max_plates]
+
+Each table is filled the way the manager fills cars_ht (starting small and
+growing), then every plate is looked up once in a scrambled order (hits) along
+with the same number of plates that aren't in the table (misses).
+*/
+#include "bench.h"
+#include "hashtable.h"
+#include "plate_table.h"
+
+// value stored per plate, same as the manager's struct car_levels
+struct car_levels {
+  int8_t current;
+  int8_t assigned;
+};
+
+// both tables start this small, like the manager's EXPECTED_NUM_PLATES
+#define START_CAPACITY 10
+
+// look plates up in a different order to how they were inserted, like cars
+// arriving at the LPRs (7919 is coprime with every n we use)
+#define LOOKUP(i, n) (((i) * 7919) % (n))
+
+static void report(const char *table, size_t n, uint64_t insert_ns,
+                   uint64_t hit_ns, uint64_t miss_ns) {
+  printf("%-6s %10zu plates | insert %7.1f ns | hit %7.1f ns | miss %7.1f "
+         "ns\n",
+         table, n, (double)insert_ns / n, (double)hit_ns / n,
+         (double)miss_ns / n);
+}
+
+static void bench_htab(char (*plates)[7], char (*misses)[7], size_t n) {
+  struct car_levels unassigned = {-1, -1};
+  ht_t *h = NULL;
+  h = htab_create(h, START_CAPACITY);
+
+  uint64_t start = bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    htab_set(h, plates[i], &unassigned, sizeof(struct car_levels));
+  }
+  uint64_t insert_ns = bench_now_ns() - start;
+
+  size_t found = 0;
+  start = bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    found += htab_get(h, plates[LOOKUP(i, n)]) != NULL;
+  }
+  uint64_t hit_ns = bench_now_ns() - start;
+
+  start = bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    found += htab_get(h, misses[LOOKUP(i, n)]) != NULL;
+  }
+  uint64_t miss_ns = bench_now_ns() - start;
+
+  if (found != n) {
+    printf("htab found %zu/%zu plates\n", found, n);
+  }
+  report("htab", n, insert_ns, hit_ns, miss_ns);
+  htab_destroy(h);
+}
+
+static void bench_ptab(char (*plates)[7], char (*misses)[7], size_t n) {
+  struct car_levels unassigned = {-1, -1};
+  ptab_t *t = ptab_create(START_CAPACITY, sizeof(struct car_levels));
+
+  uint64_t start = bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    ptab_set(t, plate_encode(plates[i]), &unassigned);
+  }
+  uint64_t insert_ns = bench_now_ns() - start;
+
+  size_t found = 0;
+  start = bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    found += ptab_get(t, plate_encode(plates[LOOKUP(i, n)])) != NULL;
+  }
+  uint64_t hit_ns = bench_now_ns() - start;
+
+  start = bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    found += ptab_get(t, plate_encode(misses[LOOKUP(i, n)])) != NULL;
+  }
+  uint64_t miss_ns = bench_now_ns() - start;
+
+  if (found != n) {
+    printf("ptab found %zu/%zu plates\n", found, n);
+  }
+  report("ptab", n, insert_ns, hit_ns, miss_ns);
+  ptab_destroy(t);
+}
+
+int main(int argc, char *argv[]) {
+  size_t sizes[] = {100, 100000, 10000000};
+  size_t max_plates = argc > 1 ? strtoull(argv[1], NULL, 10) : sizes[2];
+
+  bench_heading("Plate Table Benchmark");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    size_t n = sizes[s];
+    if (n > max_plates) {
+      break;
+    }
+    char(*plates)[7] = malloc(n * sizeof(*plates));
+    char(*misses)[7] = malloc(n * sizeof(*misses));
+    if (!plates || !misses) {
+      perror("malloc plates");
+      exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < n; i++) {
+      bench_nth_plate(i, plates[i]);
+      // lower case plates are never in the table
+      memcpy(misses[i], plates[i], 7);
+      misses[i][0] += 'a' - 'A';
+    }
+    bench_htab(plates, misses, n);
+    bench_ptab(plates, misses, n);
+    free(plates);
+    free(misses);
+  }
+  return 0;
+}
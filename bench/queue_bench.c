@@ -0,0 +1,197 @@
+/*
+Push/pop cost of the copying Queue against the intrusive IQueue, and of the
+car Ring, with the simulator's car data (ct_data sized) as the item.
+
+  ./build/bench/queue_bench [num_items]
+
+  fifo     push num_items (default 1M), then pop them all
+  steady   push one, pop one, num_items times (like a short entrance queue)
+  threads  one thread pushing while another pops, num_items times
+  burst    push BURST at a time then take them all out, one by one against
+           queue_push_n/queue_drain (ring_push_n for the Ring)
+  stats    steady again, with QueueStats recording
+*/
+#include "bench.h"
+#include "queue.h"
+#include <pthread.h>
+
+// same layout as the simulator's ct_data
+struct car {
+  void *entry_queue;
+  QNode node;
+  uint64_t plate;
+  void *shm;
+};
+
+// cars handed over together in the burst test
+#define BURST 64
+
+static size_t num_items = 1000000;
+static struct car *cars;
+// where the burst tests copy cars out to
+static struct car out[BURST];
+
+static void report(const char *name, const char *test, uint64_t ns) {
+  printf("%-7s %-7s | %6.1f ns/item\n", name, test, (double)ns / num_items);
+}
+
+static void *queue_popper(void *arg) {
+  Queue *q = arg;
+  for (size_t i = 0; i < num_items;) {
+    pthread_mutex_lock(&q->mutex);
+    QItem *item = unsafe_queue_pop_return(q);
+    pthread_mutex_unlock(&q->mutex);
+    if (item) {
+      free(item->value);
+      free(item);
+      i++;
+    }
+  }
+  return NULL;
+}
+
+static void *iqueue_popper(void *arg) {
+  IQueue *q = arg;
+  for (size_t i = 0; i < num_items;) {
+    if (iqueue_pop(q)) {
+      i++;
+    }
+  }
+  return NULL;
+}
+
+static void bench_queue(void) {
+  Queue *q = queue_create(0);
+  uint64_t start = bench_now_ns();
+  for (size_t i = 0; i < num_items; i++) {
+    queue_push(q, &cars[i], sizeof(struct car));
+  }
+  for (size_t i = 0; i < num_items; i++) {
+    queue_pop(q);
+  }
+  report("Queue", "fifo", bench_now_ns() - start);
+
+  start = bench_now_ns();
+  for (size_t i = 0; i < num_items; i++) {
+    queue_push(q, &cars[i], sizeof(struct car));
+    queue_pop(q);
+  }
+  report("Queue", "steady", bench_now_ns() - start);
+
+  pthread_t popper;
+  start = bench_now_ns();
+  pthread_create(&popper, NULL, queue_popper, q);
+  for (size_t i = 0; i < num_items; i++) {
+    queue_push(q, &cars[i], sizeof(struct car));
+  }
+  pthread_join(popper, NULL);
+  report("Queue", "threads", bench_now_ns() - start);
+
+  start = bench_now_ns();
+  for (size_t i = 0; i + BURST <= num_items; i += BURST) {
+    for (size_t j = 0; j < BURST; j++) {
+      queue_push(q, &cars[i + j], sizeof(struct car));
+    }
+    for (size_t j = 0; j < BURST; j++) {
+      pthread_mutex_lock(&q->mutex);
+      QItem *item = unsafe_queue_pop_return(q);
+      pthread_mutex_unlock(&q->mutex);
+      memcpy(&out[j], item->value, sizeof(struct car));
+      free(item->value);
+      free(item);
+    }
+  }
+  report("Queue", "burst", bench_now_ns() - start);
+
+  start = bench_now_ns();
+  for (size_t i = 0; i + BURST <= num_items; i += BURST) {
+    queue_push_n(q, &cars[i], sizeof(struct car), BURST);
+    queue_drain(q, out, sizeof(struct car), BURST);
+  }
+  report("Queue", "burst_n", bench_now_ns() - start);
+  destroy_queue(q);
+}
+
+static void bench_iqueue(void) {
+  IQueue *q = iqueue_create(0);
+  uint64_t start = bench_now_ns();
+  for (size_t i = 0; i < num_items; i++) {
+    iqueue_push(q, &cars[i].node);
+  }
+  for (size_t i = 0; i < num_items; i++) {
+    iqueue_pop(q);
+  }
+  report("IQueue", "fifo", bench_now_ns() - start);
+
+  start = bench_now_ns();
+  for (size_t i = 0; i < num_items; i++) {
+    iqueue_push(q, &cars[i].node);
+    iqueue_pop(q);
+  }
+  report("IQueue", "steady", bench_now_ns() - start);
+
+  QueueStats *stats = qstats_create(100);
+  iqueue_set_stats(q, stats);
+  start = bench_now_ns();
+  for (size_t i = 0; i < num_items; i++) {
+    iqueue_push(q, &cars[i].node);
+    iqueue_pop(q);
+  }
+  report("IQueue", "stats", bench_now_ns() - start);
+  iqueue_set_stats(q, NULL);
+  qstats_destroy(stats);
+
+  pthread_t popper;
+  start = bench_now_ns();
+  pthread_create(&popper, NULL, iqueue_popper, q);
+  for (size_t i = 0; i < num_items; i++) {
+    iqueue_push(q, &cars[i].node);
+  }
+  pthread_join(popper, NULL);
+  report("IQueue", "threads", bench_now_ns() - start);
+  destroy_iqueue(q);
+}
+
+static void bench_ring(void) {
+  Ring *r = ring_create(BURST, sizeof(struct car));
+  uint64_t start = bench_now_ns();
+  for (size_t i = 0; i + BURST <= num_items; i += BURST) {
+    for (size_t j = 0; j < BURST; j++) {
+      ring_push(r, &cars[i + j]);
+    }
+    for (size_t j = 0; j < BURST; j++) {
+      ring_try_pop(r, &out[j]);
+    }
+  }
+  report("Ring", "burst", bench_now_ns() - start);
+
+  start = bench_now_ns();
+  for (size_t i = 0; i + BURST <= num_items; i += BURST) {
+    ring_push_n(r, &cars[i], BURST);
+    for (size_t j = 0; j < BURST; j++) {
+      ring_try_pop(r, &out[j]);
+    }
+  }
+  report("Ring", "burst_n", bench_now_ns() - start);
+  ring_destroy(r);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    num_items = strtoull(argv[1], NULL, 10);
+  }
+  cars = calloc(num_items, sizeof(struct car));
+  if (!cars) {
+    perror("calloc cars");
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < num_items; i++) {
+    cars[i].plate = i;
+  }
+  bench_heading("Queue Benchmark");
+  bench_queue();
+  bench_iqueue();
+  bench_ring();
+  free(cars);
+  return 0;
+}
@@ -0,0 +1,130 @@
+/*
+LPR round-trip latency between a car and the manager, with the entrances laid
+out however SHM_CACHE_ALIGNED (src/config.h) lays out the real SharedMemory.
+Build it once for each layout and compare:
+
+  make clean bench OPT=-O2 && ./build/bench/shm_layout_bench
+  make clean bench OPT="-O2 -DSHM_CACHE_ALIGNED=1" && \
+    ./build/bench/shm_layout_bench
+
+(add -DSHM_FUTEX=1 to both for the futex devices)
+
+  ./build/bench/shm_layout_bench [round_trips] [num_entrances]
+
+Every entrance of a segment of its own (not the simulator's) has a car thread
+that sends a plate to its LPR and waits for the sign, a manager thread that
+waits on the LPR and sets the sign, and a gate thread that keeps raising and
+lowering the gate (the load). Each car does round_trips (default 20000) round
+trips, num_entrances defaults to NUM_ENTRANCES.
+*/
+#include "bench.h"
+#include "config.h"
+#include "shm_parking.h"
+#include <pthread.h>
+
+#define BENCH_SHM_NAME "PARKING_LAYOUT_BENCH"
+
+static size_t round_trips = 20000;
+static volatile int loading;
+
+struct entrance {
+  struct Entrance *devices;
+  uint64_t *latencies;
+};
+
+static void *car(void *arg) {
+  struct entrance *e = arg;
+  struct Entrance *d = e->devices;
+  for (size_t i = 0; i < round_trips; i++) {
+    uint64_t start = bench_now_ns();
+    lpr_wait_turn(&d->lpr, lpr_send(&d->lpr, "ABC123"));
+    sign_wait(&d->sign, NULL);
+    e->latencies[i] = bench_now_ns() - start;
+    sign_set(&d->sign, '\0', 0);
+  }
+  return NULL;
+}
+
+static void *manager(void *arg) {
+  struct Entrance *d = ((struct entrance *)arg)->devices;
+  for (size_t i = 0; i < round_trips; i++) {
+    char plate[6];
+    uint32_t seq;
+    lpr_wait(&d->lpr, plate, &seq, NULL);
+    sign_set(&d->sign, '1', 1);
+    lpr_ack(&d->lpr, seq);
+  }
+  return NULL;
+}
+
+static void *gate(void *arg) {
+  struct Boomgate *gate = &((struct entrance *)arg)->devices->gate;
+  while (loading) {
+    gate_set(gate, gate_get(gate) == 'O' ? 'C' : 'O');
+  }
+  return NULL;
+}
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+  struct ShmTopology topology = SHM_DEFAULT_TOPOLOGY;
+  if (argc > 1) {
+    round_trips = strtoull(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    topology.num_entrances = atoi(argv[2]);
+  }
+  bench_heading("Shared Memory Layout Benchmark");
+  struct SharedMemory *shm = create_shm(BENCH_SHM_NAME, &topology, 0);
+  size_t num_entrances = shm->num_entrances;
+
+  struct entrance *entrances = calloc(num_entrances, sizeof(struct entrance));
+  uint64_t *latencies = malloc(num_entrances * round_trips * sizeof(uint64_t));
+  pthread_t(*threads)[3] = malloc(num_entrances * sizeof(*threads));
+  for (size_t i = 0; i < num_entrances; i++) {
+    entrances[i].devices = &shm->entrances[i];
+    entrances[i].latencies = latencies + i * round_trips;
+  }
+
+  loading = 1;
+  for (size_t i = 0; i < num_entrances; i++) {
+    pthread_create(&threads[i][0], NULL, gate, &entrances[i]);
+    pthread_create(&threads[i][1], NULL, manager, &entrances[i]);
+    pthread_create(&threads[i][2], NULL, car, &entrances[i]);
+  }
+  for (size_t i = 0; i < num_entrances; i++) {
+    pthread_join(threads[i][1], NULL);
+    pthread_join(threads[i][2], NULL);
+  }
+  loading = 0;
+  for (size_t i = 0; i < num_entrances; i++) {
+    pthread_join(threads[i][0], NULL);
+  }
+
+  size_t n = num_entrances * round_trips;
+  uint64_t total = 0;
+  for (size_t i = 0; i < n; i++) {
+    total += latencies[i];
+  }
+  qsort(latencies, n, sizeof(uint64_t), compare_u64);
+  // where the devices the threads touch actually are
+  printf("%s %s devices, entrance %zu B: lpr %zu B, gate at %zu, sign at %zu\n",
+         SHM_CACHE_ALIGNED ? "aligned" : "packed",
+         SHM_FUTEX ? "futex" : "pthread", sizeof(struct Entrance),
+         sizeof(struct LPR), offsetof(struct Entrance, gate),
+         offsetof(struct Entrance, sign));
+  printf("%zu entrances | mean %7.2f us | p50 %7.2f us | p99 %8.2f us\n",
+         num_entrances, (double)total / n / 1000,
+         (double)latencies[n / 2] / 1000,
+         (double)latencies[n * 99 / 100] / 1000);
+
+  free(threads);
+  free(latencies);
+  free(entrances);
+  destroy_shm(shm);
+  return 0;
+}
@@ -0,0 +1,159 @@
+/*
+First-event latency and TLB misses on a big car park's shared memory, mapped
+with each of the SHM_MAP_* options (see libs/shm_parking.h)
+
+  ./build/bench/shm_map_bench [num_entrances] [accesses]
+
+The segment is created once per option by a plain create_shm (like the
+simulator), then mapped again with get_shm and the option (like the manager),
+so every page is already allocated and what's measured is this process
+finding it. Then:
+- map: how long get_shm took
+- first event: a gate_set on every entrance in turn, the first time this
+  mapping touches it, and the page faults they took
+- dTLB misses: for accesses (default 1M) gate_gets on random entrances, from
+  perf_event_open, n/a if the kernel won't count them for us
+- huge: how much of the segment is mapped with huge pages (ShmemPmdMapped)
+
+num_entrances defaults to 16384, a few MB of segment with the spec's layout.
+*/
+#include "bench.h"
+#include "config.h"
+#include "shm_parking.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define BENCH_SHM_NAME "PARKING_BENCH"
+
+struct option {
+  const char *name;
+  int flags;
+};
+
+static const struct option options[] = {
+    {"default", 0},
+    {"prefault", SHM_MAP_PREFAULT},
+    {"prefault+lock", SHM_MAP_PREFAULT | SHM_MAP_LOCK},
+    {"prefault+lock+huge", SHM_MAP_ALL},
+};
+
+// counter of data TLB read misses in this thread, -1 if there isn't one
+static int open_dtlb_counter(void) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long minor_faults(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+}
+
+// kB of shared memory this process has mapped with huge pages
+static long shmem_huge_kb(void) {
+  FILE *f = fopen("/proc/self/smaps_rollup", "r");
+  if (f == NULL) {
+    return -1;
+  }
+  char line[256];
+  long kb = -1;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "ShmemPmdMapped: %ld kB", &kb) == 1) {
+      break;
+    }
+  }
+  fclose(f);
+  return kb;
+}
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+  struct ShmTopology topology = SHM_DEFAULT_TOPOLOGY;
+  topology.num_entrances = argc > 1 ? atoi(argv[1]) : 16384;
+  size_t accesses = argc > 2 ? strtoull(argv[2], NULL, 10) : 1000000;
+  bench_heading("Shared Memory Mapping Benchmark");
+  size_t n = topology.num_entrances;
+  uint64_t *latencies = malloc(n * sizeof(uint64_t));
+  size_t *order = malloc(accesses * sizeof(size_t));
+  if (latencies == NULL || order == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  srand(1);
+  for (size_t i = 0; i < accesses; i++) {
+    order[i] = rand() % n;
+  }
+  int dtlb = open_dtlb_counter();
+  size_t segment_size = 0;
+
+  for (size_t o = 0; o < sizeof(options) / sizeof(options[0]); o++) {
+    struct SharedMemory *created = create_shm(BENCH_SHM_NAME, &topology, 0);
+    uint64_t start = bench_now_ns();
+    struct SharedMemory *shm = get_shm(BENCH_SHM_NAME, options[o].flags);
+    uint64_t map_ns = bench_now_ns() - start;
+    segment_size = shm->map_size;
+
+    long faults = minor_faults();
+    for (size_t i = 0; i < n; i++) {
+      uint64_t event = bench_now_ns();
+      gate_set(&shm->entrances[i].gate, 'R');
+      latencies[i] = bench_now_ns() - event;
+    }
+    faults = minor_faults() - faults;
+    qsort(latencies, n, sizeof(uint64_t), compare_u64);
+
+    char misses[32] = "n/a";
+    if (dtlb != -1) {
+      ioctl(dtlb, PERF_EVENT_IOC_RESET, 0);
+      ioctl(dtlb, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    for (size_t i = 0; i < accesses; i++) {
+      gate_get(&shm->entrances[order[i]].gate);
+    }
+    uint64_t count;
+    if (dtlb != -1) {
+      ioctl(dtlb, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(dtlb, &count, sizeof(count)) == sizeof(count)) {
+        snprintf(misses, sizeof(misses), "%.3f", (double)count / accesses);
+      }
+    }
+
+    printf("%-18s | map %8.1f us | first event p50 %6.2f us p99 %7.2f us "
+           "max %8.2f us | %6ld faults | dTLB misses/access %s | huge %ld "
+           "kB\n",
+           options[o].name, map_ns / 1e3, latencies[n / 2] / 1e3,
+           latencies[n * 99 / 100] / 1e3, latencies[n - 1] / 1e3, faults,
+           misses, shmem_huge_kb());
+
+    // the second view only needs unmapping, the first cleans up the segment
+    munmap(shm->map, shm->map_size);
+    free(shm->name);
+    free(shm);
+    destroy_shm(created);
+  }
+  printf("%s devices, %zu entrances, %zu B segment\n",
+         SHM_FUTEX ? "futex" : "pthread", n, segment_size);
+  if (dtlb != -1) {
+    close(dtlb);
+  }
+  free(order);
+  free(latencies);
+  return 0;
+}
@@ -0,0 +1,159 @@
+/*
+Latency of a car going through an entrance, signalled through the shared
+memory devices (lpr_*, gate_*, sign_*). Build it once for each device layout
+and compare:
+
+  make clean bench OPT=-O2 && ./build/bench/shm_signal_bench
+  make clean bench OPT="-O2 -DSHM_FUTEX=1" && ./build/bench/shm_signal_bench
+
+and add -DLPR_RING_SLOTS=8 (say) to the futex build for rings of plates.
+
+  ./build/bench/shm_signal_bench [round_trips] [num_entrances]
+
+Every entrance has a car thread and a manager thread in their own segment
+(not the simulator's). The car sends its plate and waits for the sign and the
+gate to open, the manager answers the plate with the sign and the gate. Then
+the car lowers the gate, and the manager clears everything for the next car.
+Each car does round_trips (default 20000) of these, num_entrances defaults to
+NUM_ENTRANCES.
+
+Then LEVEL_CARS cars each send round_trips plates to one level's LPR as fast
+as they can, with the manager reading and acknowledging them.
+*/
+#include "bench.h"
+#include "config.h"
+#include "shm_parking.h"
+#include <pthread.h>
+
+#define BENCH_SHM_NAME "PARKING_BENCH"
+// cars sending plates to the level at once
+#define LEVEL_CARS 4
+
+static size_t round_trips = 20000;
+
+struct entrance {
+  struct Entrance *devices;
+  uint64_t *latencies;
+};
+
+static void *car(void *arg) {
+  struct entrance *e = arg;
+  struct Entrance *d = e->devices;
+  for (size_t i = 0; i < round_trips; i++) {
+    uint64_t start = bench_now_ns();
+    lpr_wait_turn(&d->lpr, lpr_send(&d->lpr, "ABC123"));
+    int level;
+    sign_wait(&d->sign, &level);
+    gate_wait(&d->gate, "O", NULL);
+    e->latencies[i] = bench_now_ns() - start;
+    // through, let the manager reset the entrance
+    gate_set(&d->gate, 'L');
+  }
+  return NULL;
+}
+
+static void *manager(void *arg) {
+  struct Entrance *d = ((struct entrance *)arg)->devices;
+  for (size_t i = 0; i < round_trips; i++) {
+    char plate[6];
+    uint32_t seq;
+    lpr_wait(&d->lpr, plate, &seq, NULL);
+    sign_set(&d->sign, '1', 1);
+    gate_set(&d->gate, 'O');
+
+    gate_wait(&d->gate, "L", NULL);
+    sign_set(&d->sign, '\0', 0);
+    gate_set(&d->gate, 'C');
+    lpr_ack(&d->lpr, seq);
+  }
+  return NULL;
+}
+
+static void *level_car(void *arg) {
+  struct LPR *lpr = arg;
+  for (size_t i = 0; i < round_trips; i++) {
+    lpr_send(lpr, "ABC123");
+  }
+  return NULL;
+}
+
+static void *level_manager(void *arg) {
+  struct LPR *lpr = arg;
+  for (size_t i = 0; i < LEVEL_CARS * round_trips; i++) {
+    char plate[6];
+    uint32_t seq;
+    lpr_wait(lpr, plate, &seq, NULL);
+    lpr_ack(lpr, seq);
+  }
+  return NULL;
+}
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+  struct ShmTopology topology = SHM_DEFAULT_TOPOLOGY;
+  if (argc > 1) {
+    round_trips = strtoull(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    topology.num_entrances = atoi(argv[2]);
+  }
+  bench_heading("Shared Memory Signalling Benchmark");
+  struct SharedMemory *shm = create_shm(BENCH_SHM_NAME, &topology, 0);
+  size_t num_entrances = shm->num_entrances;
+
+  struct entrance *entrances = calloc(num_entrances, sizeof(struct entrance));
+  uint64_t *latencies = malloc(num_entrances * round_trips * sizeof(uint64_t));
+  pthread_t *threads = malloc(num_entrances * 2 * sizeof(pthread_t));
+  for (size_t i = 0; i < num_entrances; i++) {
+    entrances[i].devices = &shm->entrances[i];
+    entrances[i].latencies = latencies + i * round_trips;
+  }
+  uint64_t start = bench_now_ns();
+  for (size_t i = 0; i < num_entrances; i++) {
+    pthread_create(&threads[2 * i], NULL, manager, &entrances[i]);
+    pthread_create(&threads[2 * i + 1], NULL, car, &entrances[i]);
+  }
+  for (size_t i = 0; i < num_entrances * 2; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  uint64_t ns = bench_now_ns() - start;
+
+  size_t n = num_entrances * round_trips;
+  uint64_t total = 0;
+  for (size_t i = 0; i < n; i++) {
+    total += latencies[i];
+  }
+  qsort(latencies, n, sizeof(uint64_t), compare_u64);
+  printf("%s devices, %d LPR slots, %zu B segment (%zu B per entrance)\n",
+         SHM_FUTEX ? "futex" : "pthread", LPR_RING_SLOTS ? LPR_RING_SLOTS : 1,
+         shm->map_size, sizeof(struct Entrance));
+  printf("%zu entrances | %8.0f cars/s | mean %7.2f us | p50 %7.2f us | "
+         "p99 %8.2f us\n",
+         num_entrances, n * 1e9 / ns, (double)total / n / 1000,
+         (double)latencies[n / 2] / 1000,
+         (double)latencies[n * 99 / 100] / 1000);
+
+  pthread_t level_threads[LEVEL_CARS + 1];
+  start = bench_now_ns();
+  pthread_create(&level_threads[LEVEL_CARS], NULL, level_manager,
+                 &shm->levels[0].lpr);
+  for (int i = 0; i < LEVEL_CARS; i++) {
+    pthread_create(&level_threads[i], NULL, level_car, &shm->levels[0].lpr);
+  }
+  for (int i = 0; i <= LEVEL_CARS; i++) {
+    pthread_join(level_threads[i], NULL);
+  }
+  ns = bench_now_ns() - start;
+  printf("level, %d cars | %8.0f plates/s\n", LEVEL_CARS,
+         LEVEL_CARS * round_trips * 1e9 / ns);
+
+  free(threads);
+  free(latencies);
+  free(entrances);
+  destroy_shm(shm);
+  return 0;
+}
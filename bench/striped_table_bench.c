@@ -0,0 +1,107 @@
+/*
+Contention benchmark for the manager's cars table: one global mutex around a
+plate table (how cars_mutex used to work) against the lock-striped table.
+
+  ./build/bench/striped_table_bench [max_threads] [ops_per_thread]
+
+Every thread does what an LPR handler does per car: read a random plate's
+levels, then read-modify-write them. Thread count doubles from 1 up to
+max_threads (default 32).
+*/
+#include "bench.h"
+#include "plate_table.h"
+#include "striped_table.h"
+#include <pthread.h>
+
+#define NUM_PLATES 100000
+#define STRIPES 64
+
+struct car_levels {
+  int8_t current;
+  int8_t assigned;
+};
+
+// the two tables under test
+static pthread_mutex_t global_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ptab_t *global_table;
+static sptab_t *striped_table;
+static plate_t plates[NUM_PLATES];
+static size_t ops_per_thread = 200000;
+
+static void set_current(void *value, void *arg) {
+  ((struct car_levels *)value)->current = *(int8_t *)arg;
+}
+
+static void *global_worker(void *arg) {
+  unsigned int seed = (unsigned int)(size_t)arg;
+  for (size_t i = 0; i < ops_per_thread; i++) {
+    plate_t plate = plates[rand_r(&seed) % NUM_PLATES];
+    struct car_levels value;
+    pthread_mutex_lock(&global_mutex);
+    value = *(struct car_levels *)ptab_get(global_table, plate);
+    pthread_mutex_unlock(&global_mutex);
+    value.current = (int8_t)(i & 3);
+    pthread_mutex_lock(&global_mutex);
+    ptab_set(global_table, plate, &value);
+    pthread_mutex_unlock(&global_mutex);
+  }
+  return NULL;
+}
+
+static void *striped_worker(void *arg) {
+  unsigned int seed = (unsigned int)(size_t)arg;
+  for (size_t i = 0; i < ops_per_thread; i++) {
+    plate_t plate = plates[rand_r(&seed) % NUM_PLATES];
+    struct car_levels value;
+    sptab_get(striped_table, plate, &value);
+    int8_t level = (int8_t)(i & 3);
+    sptab_update(striped_table, plate, set_current, &level, NULL);
+  }
+  return NULL;
+}
+
+// run n threads of worker, return millions of cars per second
+static double run(void *(*worker)(void *), int n) {
+  pthread_t threads[n];
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < n; i++) {
+    pthread_create(&threads[i], NULL, worker, (void *)(size_t)(i + 1));
+  }
+  for (int i = 0; i < n; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  uint64_t elapsed = bench_now_ns() - start;
+  return (double)(n * ops_per_thread) / elapsed * 1000.0;
+}
+
+int main(int argc, char *argv[]) {
+  int max_threads = argc > 1 ? atoi(argv[1]) : 32;
+  if (argc > 2) {
+    ops_per_thread = strtoull(argv[2], NULL, 10);
+  }
+
+  struct car_levels unassigned = {-1, -1};
+  global_table = ptab_create(NUM_PLATES, sizeof(struct car_levels));
+  striped_table = sptab_create(NUM_PLATES, sizeof(struct car_levels), STRIPES);
+  char platestr[7];
+  for (size_t i = 0; i < NUM_PLATES; i++) {
+    bench_nth_plate(i, platestr);
+    plates[i] = plate_encode(platestr);
+    ptab_set(global_table, plates[i], &unassigned);
+    sptab_set(striped_table, plates[i], &unassigned);
+  }
+
+  bench_heading("Cars Table Contention Benchmark");
+  printf("%d plates, %zu cars per thread, %d stripes\n", NUM_PLATES,
+         ops_per_thread, STRIPES);
+  printf("threads | global mutex (M cars/s) | striped (M cars/s)\n");
+  for (int n = 1; n <= max_threads; n *= 2) {
+    double global = run(global_worker, n);
+    double striped = run(striped_worker, n);
+    printf("%7d | %23.2f | %18.2f\n", n, global, striped);
+  }
+
+  ptab_destroy(global_table);
+  sptab_destroy(striped_table);
+  return 0;
+}
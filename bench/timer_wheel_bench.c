@@ -0,0 +1,56 @@
+/*
+Arming and cancelling timers on the timer wheel (libs/delay.h) with more and
+more other timers already armed
+
+  ./build/bench/timer_wheel_bench [max_timers] [ops]
+
+For 100, 10k and then max_timers (default 1M) timers spread over the next
+minute, ops (default 1M) times: arm a timer somewhere in the next minute
+(wheel_arm) and cancel it again (wheel_cancel). With a slot per ms in the
+first wheel and 64x coarser slots in each one after, neither depends on how
+many timers there are, so ns/op should stay flat as they grow.
+*/
+#include "bench.h"
+#include "delay.h"
+
+#define DEFAULT_MAX_TIMERS 1000000
+#define DEFAULT_OPS 1000000
+#define SPREAD_MS 60000 // timers are armed up to a minute off
+
+static void never(void *arg) { (void)arg; }
+
+static void bench_timers(size_t num_timers, size_t ops) {
+  timer_wheel_t *w = wheel_start();
+  wheel_timer_t *timers = calloc(num_timers + 1, sizeof(wheel_timer_t));
+  if (w == NULL || timers == NULL) {
+    perror("timer wheel");
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < num_timers; i++) {
+    wheel_arm(w, &timers[i], 1000 + (int)((i * 7919) % SPREAD_MS), never,
+              NULL);
+  }
+  wheel_timer_t *t = &timers[num_timers];
+  uint64_t start = bench_now_ns();
+  for (size_t i = 0; i < ops; i++) {
+    wheel_arm(w, t, 1000 + (int)((i * 104729) % SPREAD_MS), never, NULL);
+    wheel_cancel(w, t);
+  }
+  uint64_t elapsed = bench_now_ns() - start;
+  printf("%10zu timers  %8.1f ns/arm+cancel\n", num_timers,
+         (double)elapsed / ops);
+  wheel_stop(w);
+  free(timers);
+}
+
+int main(int argc, char *argv[]) {
+  size_t max_timers = argc > 1 ? strtoull(argv[1], NULL, 10)
+                               : DEFAULT_MAX_TIMERS;
+  size_t ops = argc > 2 ? strtoull(argv[2], NULL, 10) : DEFAULT_OPS;
+  bench_heading("Timer wheel arm and cancel");
+  size_t sizes[] = {100, 10000, max_timers};
+  for (int i = 0; i < 3; i++) {
+    bench_timers(sizes[i], ops);
+  }
+  return 0;
+}
@@ -0,0 +1,119 @@
+/*
+Manager startup time with whitelists of 100k, 1M and 10M plates, comparing:
+  parse    reading plates.txt line by line into the striped cars table (how
+           the manager used to start)
+  compile  wl_compile, plates.txt into a whitelist image (done once, ahead of
+           time, by whitelist_compile)
+  open     wl_open on the compiled image (how the manager starts now)
+and then the time per lookup in each, once every plate has been looked up.
+
+  ./build/bench/whitelist_bench [max_plates]
+
+The files are written to /tmp and removed afterwards.
+*/
+#include "bench.h"
+#include "striped_table.h"
+#include "whitelist.h"
+
+#define TEXT_PATH "/tmp/whitelist_bench.txt"
+#define IMAGE_PATH "/tmp/whitelist_bench.wl"
+
+// value stored per plate, same as the manager's struct car_levels
+struct car_levels {
+  int8_t current;
+  int8_t assigned;
+};
+
+// same as the manager's CARS_TABLE_STRIPES
+#define STRIPES 64
+
+// look plates up in a different order to the file, like cars arriving at the
+// LPRs (7919 is coprime with every n we use)
+#define LOOKUP(i, n) (((i) * 7919) % (n))
+
+// parse the text file the way ht_from_file did
+static sptab_t *parse(void) {
+  FILE *fp = fopen(TEXT_PATH, "r");
+  if (fp == NULL) {
+    perror("fopen plates");
+    exit(EXIT_FAILURE);
+  }
+  sptab_t *t = sptab_create(10, sizeof(struct car_levels), STRIPES);
+  char *line = NULL;
+  size_t linecap = 0;
+  struct car_levels unassigned = {-1, -1};
+  while (getline(&line, &linecap, fp) >= PLATE_LEN) {
+    sptab_set(t, plate_encode(line), &unassigned);
+  }
+  free(line);
+  fclose(fp);
+  return t;
+}
+
+static void bench(size_t n) {
+  // write the whitelist
+  FILE *fp = fopen(TEXT_PATH, "w");
+  plate_t *plates = malloc(n * sizeof(plate_t));
+  if (fp == NULL || plates == NULL) {
+    perror("writing plates");
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < n; i++) {
+    char plate[7];
+    bench_nth_plate(i, plate);
+    plates[i] = plate_encode(plate);
+    fprintf(fp, "%s\n", plate);
+  }
+  fclose(fp);
+
+  uint64_t start = bench_now_ns();
+  sptab_t *t = parse();
+  uint64_t parse_ns = bench_now_ns() - start;
+  struct car_levels value;
+  size_t found = 0;
+  start = bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    found += sptab_get(t, plates[LOOKUP(i, n)], &value);
+  }
+  uint64_t parse_lookup_ns = bench_now_ns() - start;
+  sptab_destroy(t);
+
+  start = bench_now_ns();
+  wl_compile(TEXT_PATH, IMAGE_PATH, WL_FILTER_BITS);
+  uint64_t compile_ns = bench_now_ns() - start;
+
+  start = bench_now_ns();
+  wl_t *wl = wl_open(IMAGE_PATH);
+  uint64_t open_ns = bench_now_ns() - start;
+  start = bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    found += wl_contains(wl, plates[LOOKUP(i, n)]);
+  }
+  uint64_t open_lookup_ns = bench_now_ns() - start;
+  wl_close(wl);
+
+  if (found != 2 * n) {
+    printf("found %zu/%zu plates\n", found, 2 * n);
+  }
+  printf("%9zu plates | parse %9.3f ms, %6.1f ns/lookup | compile %9.3f ms "
+         "| open %7.3f ms, %6.1f ns/lookup\n",
+         n, parse_ns / 1e6, (double)parse_lookup_ns / n, compile_ns / 1e6,
+         open_ns / 1e6, (double)open_lookup_ns / n);
+  free(plates);
+  remove(TEXT_PATH);
+  remove(IMAGE_PATH);
+}
+
+int main(int argc, char *argv[]) {
+  size_t sizes[] = {100000, 1000000, 10000000};
+  size_t max_plates = argc > 1 ? strtoull(argv[1], NULL, 10) : sizes[2];
+
+  bench_heading("Whitelist Startup Benchmark");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    if (sizes[s] > max_plates) {
+      break;
+    }
+    bench(sizes[s]);
+  }
+  return 0;
+}
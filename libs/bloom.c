@@ -0,0 +1,48 @@
+#include "bloom.h"
+
+size_t bloom_words(size_t n, size_t bits_per_plate) {
+  if (bits_per_plate == 0) {
+    return 0;
+  }
+  size_t words = BLOOM_MIN_WORDS;
+  while (words * 64 < n * bits_per_plate) {
+    words <<= 1;
+  }
+  return words;
+}
+
+// Every bit for a plate is in the same word, picked by plate_hash, so a check
+// is one load and one compare. The BLOOM_K bits in the word come from 6 bit
+// slices of a second, independent hash
+static uint64_t bloom_mask(plate_t plate) {
+  uint64_t h = plate;
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  uint64_t mask = 0;
+  for (int i = 0; i < BLOOM_K; i++, h >>= 6) {
+    mask |= 1ULL << (h & 63);
+  }
+  return mask;
+}
+
+static size_t bloom_word(size_t words, plate_t plate) {
+  return plate_hash(plate) >> 16 & (words - 1);
+}
+
+void bloom_add(uint64_t *bits, size_t words, plate_t plate) {
+  if (words == 0) {
+    return;
+  }
+  bits[bloom_word(words, plate)] |= bloom_mask(plate);
+}
+
+bool bloom_maybe_contains(const uint64_t *bits, size_t words, plate_t plate) {
+  if (words == 0) {
+    return true;
+  }
+  uint64_t mask = bloom_mask(plate);
+  return (bits[bloom_word(words, plate)] & mask) == mask;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "plate.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A register-blocked Bloom filter of number plates over a caller-owned array
+// of words (so it can live in malloc'd memory or a read-only mapping alike)
+// Every plate sets BLOOM_K bits all within one 64-bit word, so a check is a
+// single load and compare. A plate that was added is always reported as maybe
+// there. One that wasn't is reported as maybe there about 1.6% of the time at
+// 10 bits per plate (WL_FILTER_BITS, as measured by plate_filter_bench with
+// 100k plates), less when rounding the filter up to a power of 2 words gives
+// it more bits per plate.
+//
+// Checking never writes, so any number of threads can check at once without
+// locking as long as nothing is being added
+#define BLOOM_K 6
+// smallest filter, in words
+#define BLOOM_MIN_WORDS 8
+
+// Number of words for a filter of n plates at bits_per_plate bits each,
+// always a power of 2 (0 if bits_per_plate is 0)
+size_t bloom_words(size_t n, size_t bits_per_plate);
+
+// Add plate to a filter of words words (bits start zeroed)
+void bloom_add(uint64_t *bits, size_t words, plate_t plate);
+
+// Whether plate might have been added, false means it definitely wasn't
+// An empty filter (0 words) says every plate might be there
+bool bloom_maybe_contains(const uint64_t *bits, size_t words, plate_t plate);
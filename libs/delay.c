@@ -1,6 +1,7 @@
 #include "delay.h"
 #include "config.h"
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
 void rand_delay_ms(int min, int max, pthread_mutex_t *mutex) {
@@ -14,4 +15,237 @@ void rand_delay_ms(int min, int max, pthread_mutex_t *mutex) {
   usleep((delay * 1000) * TIME_FACTOR);
 }
 
-void delay_ms(int delay) { usleep((delay * 1000) * TIME_FACTOR); }
\ No newline at end of file
+void delay_ms(int delay) { usleep((delay * 1000) * TIME_FACTOR); }
+
+// bits of the tick each wheel covers, 64 slots a wheel
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+// furthest off a timer can be (ticks, ~4.6 hours), later ones run then
+#define WHEEL_MAX_TICKS ((1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+#define NS_PER_TICK 1000000ULL // a tick is a ms
+
+struct timer_wheel {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond; // signalled for a timer due before the service wakes
+  uint64_t start_ns;   // tick 0
+  uint64_t tick;       // next tick to run
+  uint64_t sleep_until; // tick the service thread is asleep until
+  int armed;            // timers in slots
+  // circular lists of timers, the heads are never armed themselves
+  wheel_timer_t slots[WHEEL_LEVELS][WHEEL_SLOTS];
+  wheel_timer_t running; // taken out of their slot to run this tick
+  pthread_t thread;
+  bool stop;
+};
+
+static uint64_t wheel_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void list_init(wheel_timer_t *head) {
+  head->next = head;
+  head->prev = head;
+}
+
+static void list_add(wheel_timer_t *head, wheel_timer_t *t) {
+  t->prev = head->prev;
+  t->next = head;
+  head->prev->next = t;
+  head->prev = t;
+}
+
+static void list_del(wheel_timer_t *t) {
+  t->prev->next = t->next;
+  t->next->prev = t->prev;
+  t->next = NULL;
+  t->prev = NULL;
+}
+
+// Move every timer in from to the empty list to
+static void list_splice(wheel_timer_t *from, wheel_timer_t *to) {
+  if (from->next == from) {
+    return;
+  }
+  to->next = from->next;
+  to->prev = from->prev;
+  to->next->prev = to;
+  to->prev->next = to;
+  list_init(from);
+}
+
+// Put t in the slot for t->expires, in the nearest wheel it fits in
+static void slot_add(timer_wheel_t *w, wheel_timer_t *t) {
+  if (t->expires < w->tick) {
+    t->expires = w->tick;
+  }
+  uint64_t ticks = t->expires - w->tick;
+  if (ticks > WHEEL_MAX_TICKS) {
+    ticks = WHEEL_MAX_TICKS;
+    t->expires = w->tick + ticks;
+  }
+  int level = 0;
+  while (level < WHEEL_LEVELS - 1 &&
+         ticks >= 1ULL << (WHEEL_BITS * (level + 1))) {
+    level++;
+  }
+  int slot = (t->expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  list_add(&w->slots[level][slot], t);
+}
+
+// Drop the timers in a slot of a farther wheel into the nearer ones
+// return the slot
+static int cascade(timer_wheel_t *w, int level) {
+  int slot = (w->tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  wheel_timer_t moving;
+  list_init(&moving);
+  list_splice(&w->slots[level][slot], &moving);
+  while (moving.next != &moving) {
+    wheel_timer_t *t = moving.next;
+    list_del(t);
+    slot_add(w, t);
+  }
+  return slot;
+}
+
+// Run the timers for w->tick and move on to the next one, with w locked
+static void run_tick(timer_wheel_t *w) {
+  int slot = w->tick & WHEEL_MASK;
+  // each wheel comes around once the one before it has
+  for (int level = 1; level < WHEEL_LEVELS && slot == 0; level++) {
+    slot = cascade(w, level);
+  }
+  list_splice(&w->slots[0][w->tick & WHEEL_MASK], &w->running);
+  // anything armed from here on, even for now, is a later tick
+  w->tick++;
+  while (w->running.next != &w->running) {
+    wheel_timer_t *t = w->running.next;
+    list_del(t);
+    w->armed--;
+    timer_fn fn = t->fn;
+    void *arg = t->arg;
+    // t can be armed again (or freed) once it's off the list
+    pthread_mutex_unlock(&w->mutex);
+    fn(arg);
+    pthread_mutex_lock(&w->mutex);
+  }
+}
+
+// Tick the service thread next has something to do on, the first timer in
+// the first wheel or the next wheel coming around, UINT64_MAX for nothing
+static uint64_t next_tick(timer_wheel_t *w) {
+  if (w->armed == 0) {
+    return UINT64_MAX;
+  }
+  uint64_t tick = w->tick;
+  do {
+    wheel_timer_t *head = &w->slots[0][tick & WHEEL_MASK];
+    if (head->next != head) {
+      return tick;
+    }
+    tick++;
+  } while (tick & WHEEL_MASK);
+  return tick;
+}
+
+static void *wheel_service(void *arg) {
+  timer_wheel_t *w = arg;
+  pthread_mutex_lock(&w->mutex);
+  while (!w->stop) {
+    uint64_t now = (wheel_now_ns() - w->start_ns) / NS_PER_TICK;
+    while (w->tick <= now && !w->stop) {
+      run_tick(w);
+    }
+    // may have been stopped while a callback had it unlocked
+    if (w->stop) {
+      break;
+    }
+    w->sleep_until = next_tick(w);
+    if (w->sleep_until == UINT64_MAX) {
+      pthread_cond_wait(&w->cond, &w->mutex);
+    } else if (w->sleep_until > now) {
+      uint64_t wake = w->start_ns + w->sleep_until * NS_PER_TICK;
+      struct timespec ts = {.tv_sec = wake / 1000000000ULL,
+                            .tv_nsec = wake % 1000000000ULL};
+      pthread_cond_timedwait(&w->cond, &w->mutex, &ts);
+    }
+  }
+  pthread_mutex_unlock(&w->mutex);
+  return NULL;
+}
+
+timer_wheel_t *wheel_start(void) {
+  timer_wheel_t *w = calloc(1, sizeof(timer_wheel_t));
+  if (w == NULL) {
+    return NULL;
+  }
+  pthread_mutex_init(&w->mutex, NULL);
+  // sleeps are to a tick on the monotonic clock, like the ticks themselves
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&w->cond, &attr);
+  pthread_condattr_destroy(&attr);
+  for (int level = 0; level < WHEEL_LEVELS; level++) {
+    for (int slot = 0; slot < WHEEL_SLOTS; slot++) {
+      list_init(&w->slots[level][slot]);
+    }
+  }
+  list_init(&w->running);
+  w->start_ns = wheel_now_ns();
+  w->sleep_until = UINT64_MAX;
+  if (pthread_create(&w->thread, NULL, wheel_service, w) != 0) {
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->mutex);
+    free(w);
+    return NULL;
+  }
+  return w;
+}
+
+void wheel_arm(timer_wheel_t *w, wheel_timer_t *t, int ms, timer_fn fn,
+               void *arg) {
+  uint64_t delay = (uint64_t)ms * TIME_FACTOR * NS_PER_TICK;
+  // rounded up, a timer is never run early
+  uint64_t expires =
+      (wheel_now_ns() - w->start_ns + delay + NS_PER_TICK - 1) / NS_PER_TICK;
+  pthread_mutex_lock(&w->mutex);
+  if (t->next != NULL) {
+    list_del(t);
+  } else {
+    w->armed++;
+  }
+  t->fn = fn;
+  t->arg = arg;
+  t->expires = expires;
+  slot_add(w, t);
+  if (t->expires < w->sleep_until) {
+    pthread_cond_signal(&w->cond);
+  }
+  pthread_mutex_unlock(&w->mutex);
+}
+
+bool wheel_cancel(timer_wheel_t *w, wheel_timer_t *t) {
+  pthread_mutex_lock(&w->mutex);
+  bool armed = t->next != NULL;
+  if (armed) {
+    list_del(t);
+    w->armed--;
+  }
+  pthread_mutex_unlock(&w->mutex);
+  return armed;
+}
+
+void wheel_stop(timer_wheel_t *w) {
+  pthread_mutex_lock(&w->mutex);
+  w->stop = true;
+  pthread_cond_signal(&w->cond);
+  pthread_mutex_unlock(&w->mutex);
+  pthread_join(w->thread, NULL);
+  pthread_cond_destroy(&w->cond);
+  pthread_mutex_destroy(&w->mutex);
+  free(w);
+}
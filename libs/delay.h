@@ -1,5 +1,7 @@
 #pragma once
 #include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 /* delay for a random amount of time between min and max,
  measured in ms. mutex is a mutex protecting the random number generator */
@@ -7,4 +9,43 @@ void rand_delay_ms(int min, int max, pthread_mutex_t *mutex);
 
 /* delay for the given number of miliseconds. Uses the time factor to keep
  * consistent with other timings*/
-void delay_ms(int delay);
\ No newline at end of file
+void delay_ms(int delay);
+
+// TIMER WHEEL
+// ----------------------------------------------------
+// Runs callbacks some ms from now on one service thread, instead of a thread
+// sleeping through each wait. A timer goes in a slot of one of WHEEL_LEVELS
+// wheels by how far off it is (1ms slots in the first, 64ms in the next and
+// so on), so arming and cancelling are O(1), and as a farther wheel's slot
+// comes around its timers drop down into the nearer wheels.
+typedef struct timer_wheel timer_wheel_t;
+
+// Called on the wheel's service thread, without the wheel locked (so it can
+// arm timers, itself included)
+typedef void (*timer_fn)(void *arg);
+
+// A timer, kept by whoever arms it so arming one doesn't allocate.
+// Zero it before it's first armed
+typedef struct wheel_timer {
+  struct wheel_timer *next, *prev; // in its slot, NULL while it isn't armed
+  uint64_t expires;                // tick it runs on
+  timer_fn fn;
+  void *arg;
+} wheel_timer_t;
+
+// Start a wheel and its service thread
+// return NULL if it couldn't be started
+timer_wheel_t *wheel_start(void);
+
+// Run fn(arg) after ms (scaled by TIME_FACTOR like delay_ms), never before.
+// If the timer is already armed it's moved instead
+void wheel_arm(timer_wheel_t *w, wheel_timer_t *t, int ms, timer_fn fn,
+               void *arg);
+
+// Disarm the timer
+// return true if it was armed, false if it already ran (or is running)
+bool wheel_cancel(timer_wheel_t *w, wheel_timer_t *t);
+
+// Stop the service thread and free the wheel, timers that haven't run are
+// dropped
+void wheel_stop(timer_wheel_t *w);
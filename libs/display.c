@@ -1,5 +1,6 @@
 #include "display.h"
 #include "config.h"
+#include "plate.h"
 #include "queue.h"
 #include "shm_parking.h"
 #include "simulator.h"
@@ -24,9 +25,13 @@
 // ANSI_CTRL_POS moves the cursor to the specified position
 #define ANSI_CTRL_POS(row, col) printf("\x1B[%d;%dH", row, col)
 
+// most cars printed per queue, the rest are counted
+#define QUEUE_PRINT_MAX 32
+
 // function prototypes
 void car_item_print(ct_data *car_data);
-void entry_queue_print(Queue *q);
+void entry_queue_print(IQueue *q);
+void entry_stats_print(IQueue *q);
 
 // used by manager
 void *man_display_handler(void *arg) {
@@ -49,7 +54,7 @@ void *man_display_handler(void *arg) {
     printf("  LPR|\n");
     printf(" BOOM|\n");
     printf(" SIGN|\n");
-    for (int i = 0; i < NUM_ENTRANCES; i++) {
+    for (int i = 0; i < shm->num_entrances; i++) {
       int col = i * 6 + i + 7;
       ANSI_CTRL_POS(hrow, col + 2);
       printf("\x1B[34m");
@@ -57,21 +62,16 @@ void *man_display_handler(void *arg) {
       printf("\x1B[0m");
       ANSI_CTRL_POS(hrow + 1, col);
 
-      pthread_mutex_lock(&shm->entrances[i].lpr.mutex);
-      char *plate = shm->entrances[i].lpr.plate;
+      char plate[PLATE_LEN];
+      lpr_read(&shm->entrances[i].lpr, plate);
       printf("%.6s|\n", plate[0] ? plate : "      ");
-      pthread_mutex_unlock(&shm->entrances[i].lpr.mutex);
 
       ANSI_CTRL_POS(hrow + 2, col);
-      pthread_mutex_lock(&shm->entrances[i].gate.mutex);
-      char status = shm->entrances[i].gate.status;
-      pthread_mutex_unlock(&shm->entrances[i].gate.mutex);
+      char status = gate_get(&shm->entrances[i].gate);
       printf("  %c   |\n", status ? status : ' ');
 
       ANSI_CTRL_POS(hrow + 3, col);
-      pthread_mutex_lock(&shm->entrances[i].sign.mutex);
-      char display = shm->entrances[i].sign.display;
-      pthread_mutex_unlock(&shm->entrances[i].sign.mutex);
+      char display = sign_get(&shm->entrances[i].sign, NULL);
       printf("  %c   |\n", display ? display : ' ');
     }
     ANSI_CTRL_POS(hrow + 4, 0);
@@ -82,7 +82,7 @@ void *man_display_handler(void *arg) {
     printf("  CAP|\n");
     printf(" CURR|\n");
     hrow = 9;
-    for (int i = 0; i < NUM_LEVELS; i++) {
+    for (int i = 0; i < shm->num_levels; i++) {
       int col = i * 6 + i + 7;
       ANSI_CTRL_POS(hrow, col + 2);
       printf("\x1B[34m");
@@ -90,10 +90,9 @@ void *man_display_handler(void *arg) {
       printf("\x1B[0m");
 
       ANSI_CTRL_POS(hrow + 1, col);
-      pthread_mutex_lock(&shm->levels[i].lpr.mutex);
-      char *plate = shm->levels[i].lpr.plate;
+      char plate[PLATE_LEN];
+      lpr_read(&shm->levels[i].lpr, plate);
       printf("%.6s|\n", plate[0] ? plate : "      ");
-      pthread_mutex_unlock(&shm->levels[i].lpr.mutex);
 
       ANSI_CTRL_POS(hrow + 2, col);
       int16_t temp = shm->levels[i].temp;
@@ -102,12 +101,9 @@ void *man_display_handler(void *arg) {
       int8_t alarm = shm->levels[i].alarm;
       printf(" %s  |\n", alarm ? " ON" : "OFF");
       ANSI_CTRL_POS(hrow + 4, col);
-      printf("  %02d  |\n", LEVEL_CAPACITY);
+      printf("  %02d  |\n", shm->level_capacity);
       ANSI_CTRL_POS(hrow + 5, col);
-      char levelstr[2] = {'0' + i, '\0'};
-      pthread_mutex_lock(data->ht_mutex);
-      printf("  %02d  |\n", *(int *)htab_get(data->ht, levelstr));
-      pthread_mutex_unlock(data->ht_mutex);
+      printf("  %02d  |\n", occ_cars(data->occupancy, i));
     }
 
     ANSI_CTRL_POS(hrow + 6, 0);
@@ -115,7 +111,7 @@ void *man_display_handler(void *arg) {
     printf("  LPR|\n");
     printf(" GATE|\n");
     hrow = 16;
-    for (int i = 0; i < NUM_EXITS; i++) {
+    for (int i = 0; i < shm->num_exits; i++) {
       int col = i * 6 + i + 7;
       ANSI_CTRL_POS(hrow, col + 2);
       printf("\x1B[34m");
@@ -123,15 +119,12 @@ void *man_display_handler(void *arg) {
       printf("\x1B[0m");
 
       ANSI_CTRL_POS(hrow + 1, col);
-      pthread_mutex_lock(&shm->exits[i].lpr.mutex);
-      char *plate = shm->exits[i].lpr.plate;
+      char plate[PLATE_LEN];
+      lpr_read(&shm->exits[i].lpr, plate);
       printf("%.6s|\n", plate[0] ? plate : "      ");
-      pthread_mutex_unlock(&shm->exits[i].lpr.mutex);
 
       ANSI_CTRL_POS(hrow + 2, col);
-      pthread_mutex_lock(&shm->exits[i].gate.mutex);
-      char status = shm->exits[i].gate.status;
-      pthread_mutex_unlock(&shm->exits[i].gate.mutex);
+      char status = gate_get(&shm->exits[i].gate);
       printf("  %c   |\n", status ? status : ' ');
     }
     usleep(50000);
@@ -159,11 +152,16 @@ void *sim_display_handler(void *arg) {
     printf("Number of unused allowed plates: %zu\n", *data->available_plates);
     // print each entry queue
     printf("\033[5;1H");
-    for (int i = 0; i < NUM_ENTRANCES; i++) {
+    for (int i = 0; i < data->num_entrances; i++) {
       printf("EntryQ %d : ", i);
       entry_queue_print(data->entry_queues[i]);
       printf("\n");
     }
+    // how long cars have waited and how deep each queue has got
+    printf("\n");
+    for (int i = 0; i < data->num_entrances; i++) {
+      entry_stats_print(data->entry_queues[i]);
+    }
     // print in the top right corner but leave space for 16 characters
     if (*data->running) {
       printf("\033[1;40H");
@@ -186,40 +184,55 @@ void *sim_display_handler(void *arg) {
   return NULL;
 }
 
-// print entrance item
-static void entrance_item_print(char *plate) { printf("'%6s' ", plate); }
-
 // print entrance queue
-void entry_queue_print(Queue *q) {
-
-  pthread_mutex_lock(&q->mutex);
-  QItem *node = q->head;
+void entry_queue_print(IQueue *q) {
+  // copy the cars out so the queue isn't held up while printing
+  ct_data cars[QUEUE_PRINT_MAX];
+  size_t n = IQUEUE_SNAPSHOT(q, cars, QUEUE_PRINT_MAX, ct_data, node);
+  size_t length = q->length;
 
-  if (!node)
+  if (n == 0)
     printf("empty");
 
-  while (node) {
-    entrance_item_print(node->value);
-    node = node->next;
+  for (size_t i = 0; i < n; i++) {
+    car_item_print(&cars[i]);
   }
-  pthread_mutex_unlock(&q->mutex);
+  if (length > n)
+    printf("+%zu more", length - n);
+}
+
+// print an entrance queue's wait times and depth (if it has stats)
+void entry_stats_print(IQueue *q) {
+  if (q->stats == NULL)
+    return;
+  // doesn't lock the queue, the stats can be read while it's in use
+  QueueStats stats;
+  qstats_read(q->stats, &stats);
+  printf("EntryQ %d : %lu cars, p50 < %lu us, p99 < %lu us, max depth %lu\n",
+         q->id, (unsigned long)stats.popped,
+         (unsigned long)qstats_wait_percentile_us(&stats, 0.5),
+         (unsigned long)qstats_wait_percentile_us(&stats, 0.99),
+         (unsigned long)stats.max_depth);
 }
 
 // print car item
-void car_item_print(ct_data *car_data) { printf("'%6s' ", car_data->plate); }
+void car_item_print(ct_data *car_data) {
+  char platestr[PLATE_LEN + 1];
+  printf("'%6s' ", plate_decode(car_data->plate, platestr));
+}
 
 // print car object queue
 void car_queue_print(Queue *q) {
+  ct_data cars[QUEUE_PRINT_MAX];
+  size_t n = queue_snapshot(q, cars, sizeof(ct_data), QUEUE_PRINT_MAX);
+  size_t length = q->length;
 
-  pthread_mutex_lock(&q->mutex);
-  QItem *node = q->head;
-
-  if (!node)
+  if (n == 0)
     printf("empty");
 
-  while (node) {
-    car_item_print(node->value);
-    node = node->next;
+  for (size_t i = 0; i < n; i++) {
+    car_item_print(&cars[i]);
   }
-  pthread_mutex_unlock(&q->mutex);
+  if (length > n)
+    printf("+%zu more", length - n);
 }
@@ -1,18 +1,18 @@
 #pragma once
 #include "config.h"
-#include "hashtable.h"
+#include "occupancy.h"
 #include "queue.h"
 
 typedef struct ManDisplayData {
   struct SharedMemory *shm;  // pointer to the shared memory
-  ht_t *ht;                  // hashtable of car positions
-  pthread_mutex_t *ht_mutex; // mutex for the hashtable
+  occupancy_t *occupancy;    // cars on each level
   float *billing_total;      // Billing total
   volatile int *run;         // pointer to the run variable
 } ManDisplayData;
 
 typedef struct SimDisplayData {
-  Queue **entry_queues;
+  IQueue **entry_queues;
+  int num_entrances;
   int *num_cars;
   volatile int *running;
   size_t *available_plates;
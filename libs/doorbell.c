@@ -0,0 +1,36 @@
+#include "doorbell.h"
+
+void doorbell_ring(Doorbell *d, int bell) {
+  __atomic_fetch_or(&d->bits[bell / 64], 1ULL << (bell % 64),
+                    __ATOMIC_SEQ_CST);
+  fword_kick(&d->rung);
+}
+
+int doorbell_take(Doorbell *d, int bells, int from) {
+  int words = (bells + 63) / 64;
+  if (from >= bells || from < 0) {
+    from = 0;
+  }
+  // the first word is looked at twice, from bell from on and then the bits
+  // before it after wrapping around
+  for (int i = 0; i <= words; i++) {
+    int word = (from / 64 + i) % words;
+    uint64_t mask = ~0ULL;
+    if (i == 0) {
+      mask <<= from % 64;
+    }
+    uint64_t rung = __atomic_load_n(&d->bits[word], __ATOMIC_ACQUIRE) & mask;
+    while (rung != 0) {
+      uint64_t bit = rung & -rung;
+      // someone else may take it first
+      if (__atomic_fetch_and(&d->bits[word], ~bit, __ATOMIC_ACQ_REL) & bit) {
+        int bell = word * 64 + __builtin_ctzll(bit);
+        if (bell < bells) {
+          return bell;
+        }
+      }
+      rung &= ~bit;
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "futex.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// One bit per device saying it wants attention, in memory shared between
+// processes. Whoever has work for a device rings its bell; whoever serves the
+// devices takes rung bells one at a time (each ring is taken once, rings
+// before it's taken count as one) and sleeps on rung when there are none.
+// Lets a few threads serve any number of devices instead of one each.
+typedef struct Doorbell {
+  FutexWord rung; // kicked after every ring
+  uint64_t bits[];
+} Doorbell;
+
+// bytes of memory a doorbell for bells devices needs
+#define DOORBELL_SIZE(bells)                                                 \
+  (sizeof(Doorbell) + ((size_t)(bells) + 63) / 64 * sizeof(uint64_t))
+
+// Ring bell, waking anything asleep on the doorbell
+void doorbell_ring(Doorbell *d, int bell);
+
+// Take a rung bell out of the first bells, looking from bell from on (and
+// wrapping around), so that threads starting at different places share the
+// work out
+// return the bell, or -1 if none are rung
+int doorbell_take(Doorbell *d, int bells, int from);
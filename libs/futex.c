@@ -0,0 +1,73 @@
+#include "futex.h"
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// what fword_kick adds to the word, the bottom bit of the kick count
+#define FWORD_KICK (FWORD_VALUE_MASK + 1)
+
+// Not FUTEX_PRIVATE_FLAG, the word may be in memory shared between processes
+static void futex_wait(uint32_t *word, uint32_t expected,
+                       const struct timespec *timeout) {
+  syscall(SYS_futex, word, FUTEX_WAIT, expected, timeout, NULL, 0);
+}
+
+static void futex_wake_all(uint32_t *word) {
+  syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// Wake the sleepers after the word has changed
+// Both this and fword_wait are sequentially consistent, so either the waker
+// sees the waiter's count, or the waiter's FUTEX_WAIT sees the new word and
+// doesn't sleep
+static void wake_waiters(FutexWord *w) {
+  if (__atomic_load_n(&w->waiters, __ATOMIC_SEQ_CST) > 0) {
+    futex_wake_all(&w->word);
+  }
+}
+
+uint32_t fword_load(FutexWord *w) {
+  return __atomic_load_n(&w->word, __ATOMIC_ACQUIRE);
+}
+
+void fword_store(FutexWord *w, uint32_t value) {
+  // only the value is replaced. Putting the kick count back to what it was
+  // could hand a waiter back the word it loaded before a kick, and it would
+  // sleep through the kick
+  uint32_t word = __atomic_load_n(&w->word, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(
+      &w->word, &word, (word & ~FWORD_VALUE_MASK) | (value & FWORD_VALUE_MASK),
+      true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+  }
+  wake_waiters(w);
+}
+
+bool fword_cas(FutexWord *w, uint32_t word, uint32_t value) {
+  // keeps the kick count, like fword_store
+  return __atomic_compare_exchange_n(
+      &w->word, &word, (word & ~FWORD_VALUE_MASK) | (value & FWORD_VALUE_MASK),
+      false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+void fword_wait(FutexWord *w, uint32_t word) {
+  __atomic_add_fetch(&w->waiters, 1, __ATOMIC_SEQ_CST);
+  futex_wait(&w->word, word, NULL);
+  __atomic_sub_fetch(&w->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+void fword_timedwait(FutexWord *w, uint32_t word, uint64_t timeout_ns) {
+  // FUTEX_WAIT's timeout is relative
+  struct timespec timeout = {(time_t)(timeout_ns / 1000000000ULL),
+                             (long)(timeout_ns % 1000000000ULL)};
+  __atomic_add_fetch(&w->waiters, 1, __ATOMIC_SEQ_CST);
+  futex_wait(&w->word, word, &timeout);
+  __atomic_sub_fetch(&w->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+void fword_kick(FutexWord *w) {
+  // the count wraps around in the top bits, the value is left alone
+  __atomic_add_fetch(&w->word, FWORD_KICK, __ATOMIC_SEQ_CST);
+  wake_waiters(w);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// A 32-bit word that threads (or processes, if it's in shared memory) can
+// sleep on until it changes, with Linux futexes.
+// The low 24 bits are the value. The top 8 bits are bumped by fword_kick, so
+// sleepers can be woken without changing the value
+// The count of sleepers means a store nobody is waiting for costs no system
+// call
+typedef struct FutexWord {
+  uint32_t word;
+  uint32_t waiters; // threads asleep on word, or about to be
+} FutexWord;
+
+#define FWORD_VALUE_MASK 0xFFFFFFu
+// the value of a whole word from fword_load
+#define FWORD_VALUE(word) ((word) & FWORD_VALUE_MASK)
+
+// Read the whole word (value and kick count), to pass to fword_wait or
+// fword_cas. Anything written before the store of that value is visible
+uint32_t fword_load(FutexWord *w);
+
+// Set the value (must fit in FWORD_VALUE_MASK), keeping the kick count, and
+// wake everything sleeping on the word
+void fword_store(FutexWord *w, uint32_t value);
+
+// Set the value if the whole word is still word (from fword_load), keeping
+// the kick count
+// Doesn't wake anything, for moving between states nobody is waiting for
+// return false if the word had changed
+bool fword_cas(FutexWord *w, uint32_t word, uint32_t value);
+
+// Sleep until the whole word isn't word (from fword_load) anymore
+// Can return early, so check the value again after
+void fword_wait(FutexWord *w, uint32_t word);
+
+// fword_wait, but give up after timeout_ns
+void fword_timedwait(FutexWord *w, uint32_t word, uint64_t timeout_ns);
+
+// Wake everything sleeping on the word without changing its value, e.g. so
+// they see a stop flag
+void fword_kick(FutexWord *w);
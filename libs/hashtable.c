@@ -1,14 +1,21 @@
 #include "hashtable.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 // Maximum load before resizing
 #define LOAD_FACTOR 0.75
+// Number of (non-empty) buckets an operation moves while incrementally resizing
+#define HT_MIGRATE_BUCKETS 4
+// Number of keys htab_find_batch has in flight at once
+#define HT_BATCH 16
 
 typedef struct item {
-  char *key;
+  char *key; // stored straight after the item, in the same allocation
+  size_t hash; // full hash of the key, compared before the key itself
   void *value; // allow any type of value
+  size_t value_size; // bytes allocated for value
   item_t *next;
 } item_t;
 
@@ -17,39 +24,110 @@ typedef struct ht {
   item_t **buckets;
   // Current number of items
   size_t size;
-  // allocated capacity
+  // allocated capacity, always a power of 2 so we can mask instead of mod
   size_t capacity;
+  // hash function for keys (see htab_set_hash)
+  htab_hash_fn hash;
+  // whether to resize a few buckets at a time (see htab_set_incremental)
+  bool incremental;
+  // buckets still being moved into buckets, NULL if not resizing
+  item_t **old_buckets;
+  size_t old_capacity;
+  // old buckets before this index have already been moved
+  size_t migrated;
+  // items and values come from here if not NULL (see htab_create_pooled)
+  pool_t *pool;
 } ht_t;
 
+// Round n up to a power of 2
+static size_t htab_round_capacity(size_t n) {
+  size_t capacity = 1;
+  while (capacity < n) {
+    capacity <<= 1;
+  }
+  return capacity;
+}
+
 ht_t *htab_create(ht_t *h, size_t n) {
   // Allocate memory for the table
   h = (ht_t *)calloc(1, sizeof(ht_t));
-  // Allocate memory for n item pointers
-  h->buckets = calloc(n, sizeof(item_t *));
+  if (!h) {
+    return NULL;
+  }
+  // Allocate memory for at least n item pointers
+  size_t capacity = htab_round_capacity(n);
+  h->buckets = calloc(capacity, sizeof(item_t *));
   if (!h->buckets) {
+    free(h);
     return NULL;
   }
-  h->capacity = n; // allocated for this many buckets
+  h->capacity = capacity; // allocated for this many buckets
   h->size = 0;     // no items yet
+  h->incremental = false;
+  h->old_buckets = NULL;
+  h->pool = NULL;
+  h->hash = htab_hash;
   return h;
 }
 
-void htab_destroy(ht_t *h) {
-  // Free the memory allocated for each item
-  for (size_t i = 0; i < h->capacity; i++) {
-    item_t *current = h->buckets[i];
+ht_t *htab_create_pooled(ht_t *h, size_t n) {
+  h = htab_create(h, n);
+  if (!h) {
+    return NULL;
+  }
+  h->pool = pool_create();
+  if (!h->pool) {
+    htab_destroy(h);
+    return NULL;
+  }
+  return h;
+}
+
+// allocate zeroed memory for an item or value, from the pool if there is one
+static void *htab_alloc(ht_t *h, size_t size) {
+  return h->pool ? pool_calloc(h->pool, size) : calloc(1, size);
+}
+
+// free memory from htab_alloc, size is what it was allocated with
+static void htab_free(ht_t *h, void *ptr, size_t size) {
+  if (h->pool) {
+    pool_free(h->pool, ptr, size);
+  } else {
+    free(ptr);
+  }
+}
+
+// free an item, its key and its value
+static void htab_free_item(ht_t *h, item_t *item) {
+  htab_free(h, item->value, item->value_size);
+  htab_free(h, item, sizeof(item_t) + strlen(item->key) + 1);
+}
+
+// free every item in a list of buckets
+static void htab_free_buckets(ht_t *h, item_t **buckets, size_t capacity) {
+  // pooled items all go at once with the pool
+  for (size_t i = 0; !h->pool && i < capacity; i++) {
+    item_t *current = buckets[i];
     while (current) {
       item_t *next = current->next;
-      // key is a pointer so must free the memory allocated for it
-      free(current->key);
-      // value is a pointer so must free the memory allocated for it
-      free(current->value);
-      free(current);
+      htab_free_item(h, current);
       current = next;
     }
   }
   // Free the memory allocated for the buckets
-  free(h->buckets);
+  free(buckets);
+}
+
+void htab_destroy(ht_t *h) {
+  // Free the memory allocated for each item, including any still waiting to
+  // be moved by a resize
+  htab_free_buckets(h, h->buckets, h->capacity);
+  if (h->old_buckets) {
+    htab_free_buckets(h, h->old_buckets, h->old_capacity);
+  }
+  if (h->pool) {
+    pool_destroy(h->pool);
+  }
   free(h);
 }
 
@@ -63,19 +141,99 @@ size_t djb_hash(char *s) {
   return hash;
 }
 
-size_t htab_index(ht_t *h, char *key) { return djb_hash(key) % h->capacity; }
+// Final mix of a 64-bit hash so every bit of the input affects the low bits
+// we mask with (from MurmurHash3)
+static uint64_t htab_mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+size_t htab_hash(char *s) {
+  uint64_t hash = 0;
+  uint64_t word = 0;
+  size_t len = 0;
+  // pack the key 8 chars at a time and only mix once per word instead of a
+  // multiply per char (a whole number plate fits in one word)
+  for (; s[len] != '\0'; len++) {
+    word |= (uint64_t)(unsigned char)s[len] << (len % 8 * 8);
+    if (len % 8 == 7) {
+      hash = (hash ^ htab_mix(word)) * 0x9E3779B97F4A7C15ULL;
+      word = 0;
+    }
+  }
+  return htab_mix(hash ^ word ^ len * 0x9E3779B97F4A7C15ULL);
+}
+
+bool htab_set_hash(ht_t *h, htab_hash_fn hash) {
+  // every item would be in the wrong bucket
+  if (h->size > 0 || h->old_buckets) {
+    return false;
+  }
+  h->hash = hash;
+  return true;
+}
+
+size_t htab_index(ht_t *h, char *key) {
+  return h->hash(key) & (h->capacity - 1);
+}
 
 item_t *htab_bucket(ht_t *h, char *key) {
   size_t index = htab_index(h, key);
   return h->buckets[index];
 }
 
-item_t *htab_find(ht_t *h, char *key) {
-  // get the bucket for the key
-  item_t *item = htab_bucket(h, key);
-  // go through each item in the bucket
+// Move up to n non-empty old buckets into the new buckets, finishing the
+// resize once every old bucket has been moved
+static void htab_migrate(ht_t *h, size_t n) {
+  // don't spend forever skipping over empty buckets either
+  size_t empty_visits = n * 10;
+  while (n > 0 && h->migrated < h->old_capacity) {
+    item_t *item = h->old_buckets[h->migrated];
+    if (item == NULL) {
+      h->migrated++;
+      if (--empty_visits == 0) {
+        break;
+      }
+      continue;
+    }
+    // go through each item in the old bucket
+    while (item != NULL) {
+      item_t *next = item->next; // save the next item
+      // get the new bucket for the item (no need to rehash the key)
+      size_t new_bucket = item->hash & (h->capacity - 1);
+      // Insert at head of linked list
+      item->next = h->buckets[new_bucket];
+      h->buckets[new_bucket] = item;
+      item = next;
+    }
+    h->old_buckets[h->migrated++] = NULL;
+    n--;
+  }
+  if (h->migrated == h->old_capacity) {
+    // every item has been moved
+    free(h->old_buckets);
+    h->old_buckets = NULL;
+    h->old_capacity = 0;
+  }
+}
+
+// Do a bit of any resize in progress, called at the start of every operation
+static void htab_step(ht_t *h) {
+  if (h->old_buckets) {
+    htab_migrate(h, HT_MIGRATE_BUCKETS);
+  }
+}
+
+// Find key in a single chain
+static item_t *htab_chain_find(item_t *item, size_t hash, char *key) {
+  // go through each item in the bucket, only comparing the strings when the
+  // hashes match
   while (item != NULL) {
-    if (strcmp(item->key, key) == 0) {
+    if (item->hash == hash && strcmp(item->key, key) == 0) {
       return item;
     }
     item = item->next;
@@ -83,47 +241,126 @@ item_t *htab_find(ht_t *h, char *key) {
   return NULL;
 }
 
-bool htab_set(ht_t *h, char *key, void *value, size_t size) {
+// If an incremental resize hasn't moved key's old bucket yet, find it there
+static item_t *htab_find_old(ht_t *h, size_t hash, char *key) {
+  if (h->old_buckets) {
+    size_t old_bucket = hash & (h->old_capacity - 1);
+    if (old_bucket >= h->migrated) {
+      return htab_chain_find(h->old_buckets[old_bucket], hash, key);
+    }
+  }
+  return NULL;
+}
+
+// Find the item for key given its hash (saves hashing twice when inserting)
+static item_t *htab_find_hash(ht_t *h, size_t hash, char *key) {
+  htab_step(h);
+  // get the bucket for the key
+  item_t *item =
+      htab_chain_find(h->buckets[hash & (h->capacity - 1)], hash, key);
+  // if it hasn't been moved yet it's still in the old buckets
+  if (item == NULL) {
+    item = htab_find_old(h, hash, key);
+  }
+  return item;
+}
+
+item_t *htab_find(ht_t *h, char *key) {
+  return htab_find_hash(h, h->hash(key), key);
+}
+
+size_t htab_find_batch(ht_t *h, char **keys, size_t n, item_t **items) {
+  htab_step(h);
+  size_t found = 0;
+  size_t mask = h->capacity - 1;
+  size_t hashes[HT_BATCH];
+  item_t *heads[HT_BATCH];
+  for (size_t start = 0; start < n; start += HT_BATCH) {
+    size_t batch = n - start < HT_BATCH ? n - start : HT_BATCH;
+    // hash every key and start loading its bucket
+    for (size_t i = 0; i < batch; i++) {
+      hashes[i] = h->hash(keys[start + i]);
+      __builtin_prefetch(&h->buckets[hashes[i] & mask]);
+    }
+    // then start loading the first item in each bucket (its key is stored
+    // right after it)
+    for (size_t i = 0; i < batch; i++) {
+      heads[i] = h->buckets[hashes[i] & mask];
+      if (heads[i]) {
+        __builtin_prefetch(heads[i]);
+      }
+    }
+    // by now most of it should be in cache, walk the chains
+    for (size_t i = 0; i < batch; i++) {
+      char *key = keys[start + i];
+      item_t *item = htab_chain_find(heads[i], hashes[i], key);
+      if (item == NULL) {
+        item = htab_find_old(h, hashes[i], key);
+      }
+      items[start + i] = item;
+      found += item != NULL;
+    }
+  }
+  return found;
+}
+
+void *htab_upsert(ht_t *h, char *key, size_t size, bool *inserted) {
+  if (inserted) {
+    *inserted = false;
+  }
   // check if already there
+  size_t hash = h->hash(key);
   item_t *existing_item;
-  if ((existing_item = htab_find(h, key)) != NULL) {
-    // free existing value
-    free(existing_item->value);
-    // allocate memory for new value
-    existing_item->value = malloc(size);
-    // copy new value
-    memcpy(existing_item->value, value, size);
-    return existing_item->value != NULL;
+  if ((existing_item = htab_find_hash(h, hash, key)) != NULL) {
+    // only reallocate if the value changed size, otherwise it's reused as is
+    if (existing_item->value_size != size) {
+      void *value = htab_alloc(h, size);
+      if (value == NULL) {
+        return NULL;
+      }
+      memcpy(value, existing_item->value,
+             size < existing_item->value_size ? size
+                                              : existing_item->value_size);
+      htab_free(h, existing_item->value, existing_item->value_size);
+      existing_item->value = value;
+      existing_item->value_size = size;
+    }
+    return existing_item->value;
   }
 
   // ADDING NEW ITEM
   // check that adding the item (assuming into a new bucket) doesn't overfill
   // the table
   if ((h->size + 1.0) / h->capacity >= LOAD_FACTOR) {
-    // resize the table, if it fails, return false
+    // resize the table, if it fails, return NULL
     if (!htab_resize(h)) {
-      return false;
+      return NULL;
     }
   }
 
-  // allocate memory for the new item
-  item_t *new_item = (item_t *)calloc(1, sizeof(item_t));
+  // allocate memory for the new item and its key (+ 1 for the null
+  // terminator) together
+  size_t key_len = strlen(key) + 1;
+  item_t *new_item = (item_t *)htab_alloc(h, sizeof(item_t) + key_len);
 
-  // if the memory allocation failed, return false
+  // if the memory allocation failed, return NULL
   if (new_item == NULL) {
-    free(new_item);
-    return false;
+    return NULL;
+  }
+  new_item->key = (char *)(new_item + 1);
+  // allocate memory for the value, zeroed for the caller to fill in
+  new_item->value = htab_alloc(h, size);
+  if (new_item->value == NULL) {
+    htab_free(h, new_item, sizeof(item_t) + key_len);
+    return NULL;
   }
-  // allocate memory for the key (+ 1 for the null terminator)
-  new_item->key = (char *)calloc(strlen(key) + 1, sizeof(char));
   // set the key
-  strncpy(new_item->key, key, strlen(key) + 1);
-  // allocate memory for the value
-  new_item->value = malloc(size);
-  // copy the value
-  memcpy(new_item->value, value, size);
+  memcpy(new_item->key, key, key_len);
+  new_item->hash = hash;
+  new_item->value_size = size;
 
-  size_t bucket = htab_index(h, key);
+  // new items always go in the new buckets
+  size_t bucket = new_item->hash & (h->capacity - 1);
   // set the next item in the bucket to the new item
   new_item->next = h->buckets[bucket];
   // set the bucket to the new item
@@ -131,48 +368,77 @@ bool htab_set(ht_t *h, char *key, void *value, size_t size) {
   // increment size of table
   h->size++;
 
+  if (inserted) {
+    *inserted = true;
+  }
+  return new_item->value;
+}
+
+bool htab_set(ht_t *h, char *key, void *value, size_t size) {
+  // find or make room for the value, then copy it in
+  void *slot = htab_upsert(h, key, size, NULL);
+  if (slot == NULL) {
+    return false;
+  }
+  memcpy(slot, value, size);
   return true;
 }
 
-// remove an item from the hash table
-// free the memory allocated for the item
-bool htab_remove(ht_t *h, char *key) {
-  // get the bucket for the key
-  item_t *item = htab_bucket(h, key);
-  item_t *curr = item;
+// Unlink and free key from the chain starting at *bucket
+static bool htab_chain_remove(ht_t *h, item_t **bucket, size_t hash,
+                              char *key) {
+  item_t *curr = *bucket;
   item_t *prev = NULL;
   // loop through each item in the bucket
   while (curr != NULL) {
     // if item is not the current item
-    if (strcmp(curr->key, key) == 0) {
+    if (curr->hash == hash && strcmp(curr->key, key) == 0) {
       if (prev == NULL) { // if the item is the first item in the bucket
         // set the bucket pointer to the next item
-        h->buckets[htab_index(h, key)] = curr->next;
+        *bucket = curr->next;
       } else { // not the first item, need to point the previous to the next
                // (jump over the deleted item)
         // set the previous item's next pointer to the current item's next
         // pointer
         prev->next = curr->next;
       }
-      free(curr->key);
-      free(curr->value);
-      free(curr);
-      break;
+      htab_free_item(h, curr);
+      return true;
     }
     // update loop vars
     prev = curr;
     curr = curr->next;
   }
-  return true;
+  return false;
 }
 
-// resize the table
-bool htab_resize(ht_t *h) {
-  size_t new_capacity = h->capacity * 2 + 1;
+// remove an item from the hash table
+// free the memory allocated for the item
+bool htab_remove(ht_t *h, char *key) {
+  htab_step(h);
+  // get the bucket for the key
+  size_t hash = h->hash(key);
+  bool removed =
+      htab_chain_remove(h, &h->buckets[hash & (h->capacity - 1)], hash, key);
+  // it might not have been moved out of the old buckets yet
+  if (!removed && h->old_buckets) {
+    size_t old_bucket = hash & (h->old_capacity - 1);
+    if (old_bucket >= h->migrated) {
+      removed = htab_chain_remove(h, &h->old_buckets[old_bucket], hash, key);
+    }
+  }
+  if (removed) {
+    h->size--;
+  }
+  return true;
+}
 
-  // NOTE: check for possible overflow error
-  if (new_capacity < h->capacity) {
-    return false;
+// Swap in new_capacity empty buckets and start moving the items across,
+// all at once unless the table is incremental
+static bool htab_grow(ht_t *h, size_t new_capacity) {
+  // only one resize at a time, finish off the last one
+  if (h->old_buckets) {
+    htab_migrate(h, h->old_capacity);
   }
 
   // allocate memory for new size
@@ -182,40 +448,46 @@ bool htab_resize(ht_t *h) {
     return false;
   }
 
-  // number of items
-  size_t item_count = 0;
+  // the current buckets become the old buckets to move items out of
+  h->old_buckets = h->buckets;
+  h->old_capacity = h->capacity;
+  h->migrated = 0;
+  h->buckets = new_buckets;
+  h->capacity = new_capacity;
 
-  // go through each existing bucket
-  for (size_t i = 0; i < h->capacity; i++) {
-    // the current item
-    item_t *item = h->buckets[i];
-    // go through each item in the bucket
-    while (item != NULL) {
-      item_count++;
-      item_t *next = item->next; // save the next item
+  if (!h->incremental) {
+    // move every item now
+    htab_migrate(h, h->old_capacity);
+  }
+  return true;
+}
 
-      // get the new bucket for the item
-      size_t new_bucket = djb_hash(item->key) % new_capacity;
+// resize the table
+bool htab_resize(ht_t *h) {
+  size_t new_capacity = h->capacity * 2;
 
-      // Insert at head of linked list
-      // point the next item to the current head
-      item->next = new_buckets[new_bucket];
-      // set the bucket to point to the new item
-      new_buckets[new_bucket] = item;
+  // NOTE: check for possible overflow error
+  if (new_capacity < h->capacity) {
+    return false;
+  }
+  return htab_grow(h, new_capacity);
+}
 
-      // go to next item in existing bucket
-      item = next;
-    }
+bool htab_reserve(ht_t *h, size_t n) {
+  // enough buckets that n items stay under the load factor
+  size_t new_capacity = htab_round_capacity((size_t)(n / LOAD_FACTOR) + 1);
+  if (new_capacity <= h->capacity) {
+    return true;
   }
-  // free the old buckets
-  free(h->buckets);
-  // set the new members
-  h->capacity = new_capacity;
-  h->size = item_count;
-  h->buckets = new_buckets;
-  return true;
+  return htab_grow(h, new_capacity);
 }
 
+void htab_set_incremental(ht_t *h, bool incremental) {
+  h->incremental = incremental;
+}
+
+bool htab_resizing(ht_t *h) { return h->old_buckets != NULL; }
+
 // getters
 void *htab_get(ht_t *h, char *key) {
   item_t *item = htab_find(h, key);
@@ -227,6 +499,8 @@ void *htab_get(ht_t *h, char *key) {
 
 void *item_get(item_t *item) { return item->value; }
 
+pool_t *htab_pool(ht_t *h) { return h->pool; }
+
 size_t htab_capacity(ht_t *h) { return h->capacity; }
 
 size_t htab_size(ht_t *h) { return h->size; }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "pool.h"
 #include <stdbool.h>
 #include <stddef.h>
 
@@ -11,37 +12,85 @@ typedef struct item item_t;
 // A hash table of items
 typedef struct ht ht_t;
 
-// Initialise a new hash table with n buckets
+// Hashes a null-terminated key
+typedef size_t (*htab_hash_fn)(char *key);
+
+// Initialise a new hash table with n buckets (rounded up to a power of 2)
 ht_t *htab_create(ht_t *h, size_t n);
 
+// Initialise a new hash table with n buckets whose items, keys and values are
+// allocated from a slab pool (see pool.h) instead of one malloc each. Removed
+// items are recycled by the pool and htab_destroy frees them all at once
+ht_t *htab_create_pooled(ht_t *h, size_t n);
+
 // Destroy and free mamory allocated for hash table
 void htab_destroy(ht_t *h);
 
 // The Bernstein hash function
+// (only the low bits end up in the index, which djb spreads badly, so the
+// table uses htab_hash unless told otherwise)
 size_t djb_hash(char *s);
 
+// The default hash function, hashes 8 bytes at a time and mixes the result so
+// the low bits used for the index are well distributed
+size_t htab_hash(char *s);
+
+// Use a different hash function for the table, e.g. djb_hash
+// return false if the table isn't empty (items would be in the wrong buckets)
+bool htab_set_hash(ht_t *h, htab_hash_fn hash);
+
 // Calculathe offset for the bucket for any key in the hash table
 size_t htab_index(ht_t *h, char *key);
 
 // Find the pointer to the head of list for key in hash table
+// (while incrementally resizing, the key may still be in an old bucket)
 item_t *htab_bucket(ht_t *h, char *key);
 
 // Find the item for key in hash table
 // return the item or NULL if the item does not exist
 item_t *htab_find(ht_t *h, char *key);
 
+// Find the items for n keys at once, items[i] is set to the item for keys[i]
+// (or NULL). Faster than calling htab_find n times as the keys' buckets are
+// prefetched in groups so the cache misses overlap instead of happening one
+// after another
+// return the number of keys found
+size_t htab_find_batch(ht_t *h, char **keys, size_t n, item_t **items);
+
 // Add an item to the hash table
-// OR update value if exists
+// OR update value if exists (in place if it is the same size as before)
 // allocate memory for the item and add it to the hash table
 bool htab_set(ht_t *h, char *key, void *value, size_t size);
 
+// Get a pointer to the value for key, adding the key with a zeroed value of
+// size bytes if it doesn't exist yet. The value is read and written through
+// the pointer, so a read-modify-write is one lookup and no allocations
+// The pointer stays valid (even across resizes) until the key is removed or
+// set with a different size
+// inserted (if not NULL) is set to whether the key was added
+// return NULL if memory couldn't be allocated
+void *htab_upsert(ht_t *h, char *key, size_t size, bool *inserted);
+
 // Remove an item from the hash table
 // free the memory allocated for the item
 bool htab_remove(ht_t *h, char *key);
 
-// Increase the size of the hash table to 2n+1
+// Double the size of the hash table
+// If the table is incremental this only swaps in the new buckets, the items
+// are moved over by the following htab_find/htab_set/htab_remove calls
 bool htab_resize(ht_t *h);
 
+// Pre-size the table so that n items fit without it resizing
+bool htab_reserve(ht_t *h, size_t n);
+
+// Turn incremental resizing on or off (off by default)
+// When on, no single call rehashes the whole table: every operation moves a
+// few buckets until the resize is done
+void htab_set_incremental(ht_t *h, bool incremental);
+
+// Whether an incremental resize is still moving items
+bool htab_resizing(ht_t *h);
+
 // get the value of a particular key
 void *htab_get(ht_t *h, char *key);
 
@@ -49,6 +98,9 @@ void *htab_get(ht_t *h, char *key);
 void *item_get(item_t *item);
 
 // hashtable metadata
+// the table's pool, NULL if it wasn't created with htab_create_pooled
+pool_t *htab_pool(ht_t *h);
+
 // total capacity
 size_t htab_capacity(ht_t *h);
 
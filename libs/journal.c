@@ -0,0 +1,227 @@
+#include "journal.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Identifies a journal (and the version of its layout)
+#define JOURNAL_MAGIC "PARKJNL1"
+
+// Start of the segment, followed by the records
+struct journal_header {
+  char magic[8];
+  // number of records, always a power of 2 so we can mask instead of mod
+  uint64_t capacity;
+  uint64_t record_size;
+  char pad[40];
+  // position of the next record to be written, on its own cache line as
+  // every writer in every process bumps it
+  uint64_t head;
+  char pad2[56];
+};
+
+typedef struct journal {
+  struct journal_header *header;
+  struct JournalRecord *records;
+  uint64_t mask;
+  // the whole mapped segment
+  void *map;
+  size_t map_size;
+  char *name;
+} journal_t;
+
+_Static_assert(sizeof(struct JournalRecord) == 32, "records are 32 bytes");
+_Static_assert(sizeof(struct journal_header) == 128,
+               "the header is two cache lines");
+
+// Map size bytes of the shared memory in fd
+static journal_t *journal_map(const char *name, int fd, size_t size) {
+  void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+  journal_t *j = calloc(1, sizeof(journal_t));
+  if (j == NULL || (j->name = strdup(name)) == NULL) {
+    free(j);
+    munmap(map, size);
+    return NULL;
+  }
+  j->map = map;
+  j->map_size = size;
+  j->header = map;
+  j->records = (struct JournalRecord *)(j->header + 1);
+  return j;
+}
+
+journal_t *journal_create(const char *name, size_t records) {
+  if (records == 0 || (records & (records - 1)) != 0) {
+    return NULL;
+  }
+  // remove if exists
+  shm_unlink(name);
+  int fd = shm_open(name, O_RDWR | O_CREAT, 0666);
+  if (fd == -1) {
+    return NULL;
+  }
+  size_t size =
+      sizeof(struct journal_header) + records * sizeof(struct JournalRecord);
+  if (ftruncate(fd, size) == -1) {
+    close(fd);
+    return NULL;
+  }
+  journal_t *j = journal_map(name, fd, size);
+  if (j == NULL) {
+    return NULL;
+  }
+  // the segment starts zeroed, so every record is unwritten
+  j->header->capacity = records;
+  j->header->record_size = sizeof(struct JournalRecord);
+  j->mask = records - 1;
+  memcpy(j->header->magic, JOURNAL_MAGIC, sizeof(j->header->magic));
+  return j;
+}
+
+journal_t *journal_open(const char *name) {
+  int fd = shm_open(name, O_RDWR, 0666);
+  if (fd == -1) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 ||
+      (size_t)st.st_size < sizeof(struct journal_header)) {
+    close(fd);
+    return NULL;
+  }
+  journal_t *j = journal_map(name, fd, st.st_size);
+  if (j == NULL) {
+    return NULL;
+  }
+  // make sure it's a journal, with records like ours, and all of it is there
+  uint64_t capacity = j->header->capacity;
+  if (memcmp(j->header->magic, JOURNAL_MAGIC, 8) != 0 ||
+      j->header->record_size != sizeof(struct JournalRecord) ||
+      capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+      sizeof(struct journal_header) + capacity * sizeof(struct JournalRecord) !=
+          j->map_size) {
+    journal_close(j, false);
+    return NULL;
+  }
+  j->mask = capacity - 1;
+  return j;
+}
+
+void journal_close(journal_t *j, bool unlink) {
+  if (j == NULL) {
+    return;
+  }
+  munmap(j->map, j->map_size);
+  if (unlink) {
+    shm_unlink(j->name);
+  }
+  free(j->name);
+  free(j);
+}
+
+void journal_log(journal_t *j, enum JournalType type,
+                 enum JournalDevice device, int index, plate_t plate,
+                 char value, int arg) {
+  if (j == NULL) {
+    return;
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  // claim the next record, writers never wait on each other
+  uint64_t pos = __atomic_fetch_add(&j->header->head, 1, __ATOMIC_RELAXED);
+  struct JournalRecord *r = &j->records[pos & j->mask];
+  // mark it as being written before touching the rest, so a reader doesn't
+  // take a half-written record for the one that was there before
+  __atomic_store_n(&r->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  r->time_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+  r->plate = plate;
+  r->type = type;
+  r->device = device;
+  r->index = index;
+  r->value = value;
+  r->padding = 0;
+  r->arg = arg;
+  __atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+uint64_t journal_head(journal_t *j) {
+  return __atomic_load_n(&j->header->head, __ATOMIC_ACQUIRE);
+}
+
+uint64_t journal_tail(journal_t *j) {
+  uint64_t head = journal_head(j);
+  return head > j->mask ? head - j->mask - 1 : 0;
+}
+
+enum JournalResult journal_read(journal_t *j, uint64_t *pos,
+                                struct JournalRecord *record) {
+  if (*pos >= journal_head(j)) {
+    return JOURNAL_EMPTY;
+  }
+  if (*pos < journal_tail(j)) {
+    *pos = journal_tail(j);
+    return JOURNAL_LOST;
+  }
+  struct JournalRecord *r = &j->records[*pos & j->mask];
+  uint64_t seq = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+  if (seq != *pos + 1) {
+    if (seq > *pos + 1) {
+      // written over already
+      *pos = journal_tail(j);
+      return JOURNAL_LOST;
+    }
+    // claimed but not finished yet
+    return JOURNAL_PENDING;
+  }
+  memcpy(record, r, sizeof(struct JournalRecord));
+  // if it was written over while we copied it, it'll have a new seq
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (__atomic_load_n(&r->seq, __ATOMIC_RELAXED) != seq) {
+    *pos = journal_tail(j);
+    return JOURNAL_LOST;
+  }
+  (*pos)++;
+  return JOURNAL_OK;
+}
+
+const char *journal_type_name(uint8_t type) {
+  switch (type) {
+  case JOURNAL_LPR_ARRIVED:
+    return "lpr-arrived";
+  case JOURNAL_LPR_READ:
+    return "lpr-read";
+  case JOURNAL_SIGN_SET:
+    return "sign-set";
+  case JOURNAL_SIGN_SEEN:
+    return "sign-seen";
+  case JOURNAL_GATE_SET:
+    return "gate-set";
+  case JOURNAL_GATE_MOVED:
+    return "gate-moved";
+  case JOURNAL_ALARM:
+    return "alarm";
+  default:
+    return "?";
+  }
+}
+
+const char *journal_device_name(uint8_t device) {
+  switch (device) {
+  case JOURNAL_ENTRANCE:
+    return "entrance";
+  case JOURNAL_EXIT:
+    return "exit";
+  case JOURNAL_LEVEL:
+    return "level";
+  default:
+    return "-";
+  }
+}
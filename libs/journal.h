@@ -0,0 +1,92 @@
+#pragma once
+
+#include "plate.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A journal of what happens to the car park's devices, shared by every process
+// in its own shared memory segment. Any thread of any process can write to it
+// without locks. It's a ring of fixed-size records, so once it's full the
+// oldest are written over. Readers (journal_read) keep their own position and
+// find out when they've fallen behind.
+//
+// Whoever changes a device journals it before the change, and whoever sees
+// the change journals it after, so a record is always after what caused it.
+typedef struct journal journal_t;
+
+// What happened
+enum JournalType {
+  JOURNAL_LPR_ARRIVED = 1, // simulator: a car with plate got to an LPR (and
+                           // waits there for room to put it on)
+  JOURNAL_LPR_READ,        // manager: read plate from an LPR
+  JOURNAL_SIGN_SET,        // manager/fire alarm: set a sign to value (and arg)
+  JOURNAL_SIGN_SEEN,       // simulator: the car with plate read a sign
+  JOURNAL_GATE_SET,        // manager/fire alarm: told a gate to do value
+  JOURNAL_GATE_MOVED,      // simulator: a gate finished moving to value
+  JOURNAL_ALARM,           // fire alarm: the alarm went on (value 1) or off (0)
+};
+
+// Which device it happened to
+enum JournalDevice {
+  JOURNAL_NONE,
+  JOURNAL_ENTRANCE,
+  JOURNAL_EXIT,
+  JOURNAL_LEVEL,
+};
+
+// One thing that happened, 32 bytes
+struct JournalRecord {
+  // position in the journal + 1 once it's been written, 0 while it's being
+  // written
+  uint64_t seq;
+  uint64_t time_ns; // CLOCK_MONOTONIC, the same clock in every process
+  plate_t plate;    // 0 if there isn't one
+  uint8_t type;     // JournalType
+  uint8_t device;   // JournalDevice
+  uint16_t index;   // which entrance, exit or level
+  char value;       // sign display or gate status, depending on type
+  uint8_t padding;
+  int16_t arg; // sign level
+};
+
+// What journal_read found
+enum JournalResult {
+  JOURNAL_OK,      // read the next record
+  JOURNAL_EMPTY,   // nothing new has been written yet
+  JOURNAL_PENDING, // the next record is still being written (ones after it
+                   // may not be), try again
+  JOURNAL_LOST,    // records were written over before they were read, the
+                   // position has been moved on to the oldest left
+};
+
+// Create a journal of (a power of two) records as shared memory called name,
+// replacing any old one
+// return NULL if it couldn't be created
+journal_t *journal_create(const char *name, size_t records);
+
+// Open the journal another process created
+// return NULL if there isn't one (so nothing is journalled)
+journal_t *journal_open(const char *name);
+
+// Unmap the journal, and unlink it too if unlink is true
+void journal_close(journal_t *j, bool unlink);
+
+// Add a record to the journal (nothing if j is NULL)
+void journal_log(journal_t *j, enum JournalType type,
+                 enum JournalDevice device, int index, plate_t plate,
+                 char value, int arg);
+
+// Position just past the newest record, start there to only see new ones
+uint64_t journal_head(journal_t *j);
+
+// Position of the oldest record still in the journal
+uint64_t journal_tail(journal_t *j);
+
+// Read the record at *pos into record and move *pos past it
+enum JournalResult journal_read(journal_t *j, uint64_t *pos,
+                                struct JournalRecord *record);
+
+// Names for printing
+const char *journal_type_name(uint8_t type);
+const char *journal_device_name(uint8_t device);
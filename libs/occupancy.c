@@ -0,0 +1,280 @@
+#include "occupancy.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define OCC_CACHE_LINE 64
+// entrances with an occ_spread counter to themselves, more share them
+#define OCC_SPREAD_COUNTERS 64
+
+// A node of the least loaded tree is a key, the cars on a level and then the
+// level (so the smallest key is the emptiest level, lowest numbered first),
+// above a version that changes every time the node is set
+#define TREE_VERSION_BITS 24
+#define TREE_VERSION_MASK ((1ULL << TREE_VERSION_BITS) - 1)
+#define TREE_LEVEL_BITS 16
+#define TREE_LEVEL_MASK ((1ULL << TREE_LEVEL_BITS) - 1)
+#define TREE_MAX_CARS ((1ULL << 24) - 1) // as far as it's concerned
+#define TREE_KEY(node) ((node) >> TREE_VERSION_BITS)
+
+// one to a cache line so levels being updated at once don't share one
+struct level_count {
+  int cars;
+} __attribute__((aligned(OCC_CACHE_LINE)));
+
+// whose turn it is, for occ_round_robin and occ_spread
+struct turn {
+  unsigned next;
+} __attribute__((aligned(OCC_CACHE_LINE)));
+
+struct occupancy {
+  int num_levels;
+  int capacity;
+  int num_words;
+  uint64_t *free;             // bit set for each level that isn't full
+  struct level_count *levels; // cars on each level
+  // tournament tree of keys for occ_least_loaded, 1 is the root, the
+  // children of i are 2i and 2i + 1 and level l is leaf leaves + l
+  int leaves; // num_levels rounded up to a power of two
+  uint64_t *tree;
+  struct turn round_robin;
+  struct turn spread[OCC_SPREAD_COUNTERS];
+};
+
+// The key for level with cars on it
+static uint64_t tree_key(uint64_t cars, int level) {
+  if (cars > TREE_MAX_CARS) {
+    cars = TREE_MAX_CARS;
+  }
+  return cars << TREE_LEVEL_BITS | (uint64_t)level;
+}
+
+// Set tree node i from what's under it (the count, for a leaf), if it wasn't
+// set by someone else in the meantime
+static void tree_refresh(occupancy_t *o, int i) {
+  uint64_t old = __atomic_load_n(&o->tree[i], __ATOMIC_ACQUIRE);
+  uint64_t key;
+  if (i >= o->leaves) {
+    int level = i - o->leaves;
+    key = tree_key(__atomic_load_n(&o->levels[level].cars, __ATOMIC_ACQUIRE),
+                   level);
+  } else {
+    uint64_t left =
+        TREE_KEY(__atomic_load_n(&o->tree[2 * i], __ATOMIC_ACQUIRE));
+    uint64_t right =
+        TREE_KEY(__atomic_load_n(&o->tree[2 * i + 1], __ATOMIC_ACQUIRE));
+    key = left < right ? left : right;
+  }
+  uint64_t node = key << TREE_VERSION_BITS | ((old + 1) & TREE_VERSION_MASK);
+  __atomic_compare_exchange_n(&o->tree[i], &old, node, false, __ATOMIC_ACQ_REL,
+                              __ATOMIC_RELAXED);
+}
+
+// Bring the tree into line with level's count, from its leaf up. Each node is
+// refreshed twice: if both fail, someone else set it in between, after what
+// we changed below it was already there (Jayanti's f-array)
+static void tree_update(occupancy_t *o, int level) {
+  for (int i = o->leaves + level; i >= 1; i /= 2) {
+    tree_refresh(o, i);
+    tree_refresh(o, i);
+  }
+}
+
+// The first level with room at or after from (wrapping around), or -1
+static int next_free(occupancy_t *o, int from) {
+  // the first word is looked at twice, from from on and then the bits before
+  // it after wrapping around
+  for (int i = 0; i <= o->num_words; i++) {
+    int word = (from / 64 + i) % o->num_words;
+    uint64_t bits = __atomic_load_n(&o->free[word], __ATOMIC_ACQUIRE);
+    if (i == 0) {
+      bits &= ~0ULL << (from % 64);
+    }
+    if (bits != 0) {
+      return word * 64 + __builtin_ctzll(bits);
+    }
+  }
+  return -1;
+}
+
+occupancy_t *occ_create(int levels, int capacity) {
+  if (levels < 1 || levels > OCC_MAX_LEVELS) {
+    return NULL;
+  }
+  // its turn counters are on their own cache lines
+  occupancy_t *o = aligned_alloc(OCC_CACHE_LINE, sizeof(occupancy_t));
+  if (o == NULL) {
+    return NULL;
+  }
+  memset(o, 0, sizeof(occupancy_t));
+  o->num_levels = levels;
+  o->capacity = capacity;
+  o->num_words = (levels + 63) / 64;
+  // rounded up to whole cache lines, so the bitmap doesn't share a line with
+  // anything else either
+  size_t free_size =
+      ((size_t)o->num_words * sizeof(uint64_t) + OCC_CACHE_LINE - 1) /
+      OCC_CACHE_LINE * OCC_CACHE_LINE;
+  o->free = aligned_alloc(OCC_CACHE_LINE, free_size);
+  o->levels =
+      aligned_alloc(OCC_CACHE_LINE, levels * sizeof(struct level_count));
+  o->leaves = 1;
+  while (o->leaves < levels) {
+    o->leaves *= 2;
+  }
+  o->tree = calloc(2 * o->leaves, sizeof(uint64_t));
+  if (o->free == NULL || o->levels == NULL || o->tree == NULL) {
+    occ_destroy(o);
+    return NULL;
+  }
+  memset(o->free, 0, free_size);
+  memset(o->levels, 0, levels * sizeof(struct level_count));
+  if (capacity > 0) {
+    for (int i = 0; i < levels; i++) {
+      o->free[i / 64] |= 1ULL << (i % 64);
+    }
+  }
+  // leaves past the last level are never the least loaded
+  for (int i = 0; i < o->leaves; i++) {
+    o->tree[o->leaves + i] = tree_key(i < levels ? 0 : TREE_MAX_CARS, i)
+                             << TREE_VERSION_BITS;
+  }
+  for (int i = o->leaves - 1; i >= 1; i--) {
+    uint64_t left = TREE_KEY(o->tree[2 * i]);
+    uint64_t right = TREE_KEY(o->tree[2 * i + 1]);
+    o->tree[i] = (left < right ? left : right) << TREE_VERSION_BITS;
+  }
+  return o;
+}
+
+void occ_destroy(occupancy_t *o) {
+  free(o->free);
+  free(o->levels);
+  free(o->tree);
+  free(o);
+}
+
+int occ_cars(occupancy_t *o, int level) {
+  if (level < 0 || level >= o->num_levels) {
+    return 0;
+  }
+  return __atomic_load_n(&o->levels[level].cars, __ATOMIC_ACQUIRE);
+}
+
+// Bring level's bit and tree leaf into line with its count, just changed to
+// updated
+static void level_changed(occupancy_t *o, int level, int updated) {
+  // another add can change the count between reading it and setting the bit,
+  // so whoever sets the bit last checks the count didn't move under them, and
+  // tries again if it did
+  int *count = &o->levels[level].cars;
+  uint64_t *word = &o->free[level / 64];
+  uint64_t bit = 1ULL << (level % 64);
+  int seen = updated;
+  for (;;) {
+    if (seen < o->capacity) {
+      __atomic_fetch_or(word, bit, __ATOMIC_SEQ_CST);
+    } else {
+      __atomic_fetch_and(word, ~bit, __ATOMIC_SEQ_CST);
+    }
+    int now = __atomic_load_n(count, __ATOMIC_SEQ_CST);
+    if (now == seen) {
+      break;
+    }
+    seen = now;
+  }
+  tree_update(o, level);
+}
+
+int occ_add(occupancy_t *o, int level, int num_cars) {
+  if (level < 0 || level >= o->num_levels) {
+    return 0;
+  }
+  int *count = &o->levels[level].cars;
+  int cars = __atomic_load_n(count, __ATOMIC_RELAXED);
+  int updated;
+  do {
+    updated = cars + num_cars > 0 ? cars + num_cars : 0;
+  } while (!__atomic_compare_exchange_n(count, &cars, updated, true,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+  level_changed(o, level, updated);
+  return updated;
+}
+
+bool occ_try_add(occupancy_t *o, int level) {
+  if (level < 0 || level >= o->num_levels) {
+    return false;
+  }
+  int *count = &o->levels[level].cars;
+  int cars = __atomic_load_n(count, __ATOMIC_RELAXED);
+  do {
+    if (cars >= o->capacity) {
+      return false;
+    }
+  } while (!__atomic_compare_exchange_n(count, &cars, cars + 1, true,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+  level_changed(o, level, cars + 1);
+  return true;
+}
+
+int occ_num_free(occupancy_t *o) {
+  int num_free = 0;
+  for (int i = 0; i < o->num_words; i++) {
+    num_free += __builtin_popcountll(__atomic_load_n(&o->free[i],
+                                                     __ATOMIC_ACQUIRE));
+  }
+  return num_free;
+}
+
+int occ_pick(occupancy_t *o, unsigned n) {
+  for (;;) {
+    int num_free = occ_num_free(o);
+    if (num_free == 0) {
+      return -1;
+    }
+    unsigned left = n % (unsigned)num_free;
+    for (int i = 0; i < o->num_words; i++) {
+      uint64_t bits = __atomic_load_n(&o->free[i], __ATOMIC_ACQUIRE);
+      unsigned count = __builtin_popcountll(bits);
+      if (left >= count) {
+        left -= count;
+        continue;
+      }
+      // drop the lowest left set bits, the next one is the level
+      for (unsigned j = 0; j < left; j++) {
+        bits &= bits - 1;
+      }
+      return i * 64 + __builtin_ctzll(bits);
+    }
+    // levels filled up between counting and looking, count them again
+  }
+}
+
+int occ_random(occupancy_t *o, int entrance, unsigned n) {
+  (void)entrance;
+  return occ_pick(o, n);
+}
+
+int occ_least_loaded(occupancy_t *o, int entrance, unsigned n) {
+  (void)entrance;
+  (void)n;
+  uint64_t key = TREE_KEY(__atomic_load_n(&o->tree[1], __ATOMIC_ACQUIRE));
+  if ((key >> TREE_LEVEL_BITS) >= (uint64_t)o->capacity) {
+    return -1; // even the emptiest is full
+  }
+  return (int)(key & TREE_LEVEL_MASK);
+}
+
+int occ_round_robin(occupancy_t *o, int entrance, unsigned n) {
+  (void)entrance;
+  (void)n;
+  unsigned turn =
+      __atomic_fetch_add(&o->round_robin.next, 1, __ATOMIC_RELAXED);
+  return next_free(o, turn % (unsigned)o->num_levels);
+}
+
+int occ_spread(occupancy_t *o, int entrance, unsigned n) {
+  (void)n;
+  struct turn *t = &o->spread[(unsigned)entrance % OCC_SPREAD_COUNTERS];
+  unsigned turn = __atomic_fetch_add(&t->next, 1, __ATOMIC_RELAXED);
+  return next_free(o, ((unsigned)entrance + turn) % (unsigned)o->num_levels);
+}
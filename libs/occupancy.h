@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define OCC_MAX_LEVELS 65535
+
+// How many cars are on each level of the car park, and which levels have
+// room. Each level's count is an atomic on its own cache line, and a bitmap
+// of the levels that aren't full is kept alongside, so picking a level for a
+// car is a bit scan rather than a look at every level.
+//
+// Thread-safe and lock-free
+typedef struct occupancy occupancy_t;
+
+// Create the counts for levels levels (all empty, at most OCC_MAX_LEVELS) of
+// capacity cars each
+// Returns NULL if the memory couldn't be allocated
+occupancy_t *occ_create(int levels, int capacity);
+
+// Free the counts
+void occ_destroy(occupancy_t *o);
+
+// Cars on level, 0 if there's no such level
+int occ_cars(occupancy_t *o, int level);
+
+// Add num_cars (can be negative) to level, never going below 0 (cars are
+// cleared off levels in a fire without being counted out)
+// return the cars on level now, 0 if there's no such level
+int occ_add(occupancy_t *o, int level, int num_cars);
+
+// Count one more car on level if it isn't full, in one step, so cars let in
+// at once can't take the same last spot
+// return false if the level is full (or there's no such level)
+bool occ_try_add(occupancy_t *o, int level);
+
+// Number of levels that aren't full
+int occ_num_free(occupancy_t *o);
+
+// The nth level that isn't full (n wraps around how many there are), so a
+// random n picks a random level with room
+// return the level, or -1 if they're all full
+int occ_pick(occupancy_t *o, unsigned n);
+
+// LEVEL POLICIES
+// ----------------------------------------------------
+// How the manager picks a level for a car at an entrance, set with
+// LEVEL_POLICY in config.h. Each picks a level that isn't full, or returns -1
+// if they all are. n is a random number, for the policies that want one
+
+typedef int (*occ_policy_fn)(occupancy_t *o, int entrance, unsigned n);
+
+// Any level with room, uniformly at random (occ_pick)
+int occ_random(occupancy_t *o, int entrance, unsigned n);
+
+// The level with the fewest cars on it (the lowest numbered of those tied),
+// read off the top of a tournament tree of the counts that occ_add keeps up
+// to date, O(log levels) to update and O(1) to read
+int occ_least_loaded(occupancy_t *o, int entrance, unsigned n);
+
+// Each level in turn, from one counter shared by every entrance, skipping
+// full ones
+int occ_round_robin(occupancy_t *o, int entrance, unsigned n);
+
+// Each level in turn like occ_round_robin, but from a counter for each
+// entrance starting at a different level, so entrances busy at once send
+// their cars to different levels (and don't share a counter)
+int occ_spread(occupancy_t *o, int entrance, unsigned n);
@@ -0,0 +1,43 @@
+#include "plate.h"
+
+plate_t plate_encode(const char *str) {
+  plate_t plate = PLATE_NONE;
+  int i = 0;
+  // pack each character until the end of the string
+  for (; i < PLATE_LEN && str[i] != '\0'; i++) {
+    plate = (plate << 8) | (unsigned char)str[i];
+  }
+  // shift short plates up so they still compare like strings
+  for (; i < PLATE_LEN; i++) {
+    plate <<= 8;
+  }
+  return plate;
+}
+
+void plate_to_chars(plate_t plate, char *chars) {
+  for (int i = PLATE_LEN - 1; i >= 0; i--) {
+    chars[i] = (char)(plate & 0xFF);
+    plate >>= 8;
+  }
+}
+
+char *plate_decode(plate_t plate, char *str) {
+  plate_to_chars(plate, str);
+  str[PLATE_LEN] = '\0';
+  return str;
+}
+
+bool plate_valid(plate_t plate) {
+  // nothing may be packed above the 6 characters
+  if (plate >> (PLATE_LEN * 8)) {
+    return false;
+  }
+  for (int i = 0; i < PLATE_LEN; i++) {
+    char c = (char)(plate & 0xFF);
+    if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))) {
+      return false;
+    }
+    plate >>= 8;
+  }
+  return true;
+}
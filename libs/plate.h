@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of characters on a number plate (no null-terminator)
+#define PLATE_LEN 6
+
+// A number plate packed into an integer, one character per byte with the
+// first character in the most significant used byte. Comparing two plates as
+// integers orders them the same as comparing the strings.
+typedef uint64_t plate_t;
+
+// The empty plate, what an LPR reads when no car is there
+#define PLATE_NONE ((plate_t)0)
+
+// Pack up to PLATE_LEN characters into a plate, stopping early at a '\0'.
+// Works on both null-terminated strings and the 6 chars of an LPR
+plate_t plate_encode(const char *str);
+
+// Unpack a plate into exactly PLATE_LEN characters (no null-terminator),
+// e.g. to write it to an LPR
+void plate_to_chars(plate_t plate, char *chars);
+
+// Unpack a plate into a null-terminated string, str must hold PLATE_LEN + 1
+char *plate_decode(plate_t plate, char *str);
+
+// Whether the plate is PLATE_LEN upper case letters and digits
+bool plate_valid(plate_t plate);
+
+// Hash of a plate, well mixed in the low bits so tables can mask with it
+static inline size_t plate_hash(plate_t plate) {
+  uint64_t hash = plate * 0x9E3779B97F4A7C15ULL;
+  // fold the well-mixed high bits into the low bits
+  return (size_t)(hash ^ (hash >> 32));
+}
+
+// Whether two plates are the same
+static inline bool plate_eq(plate_t a, plate_t b) { return a == b; }
+
+// Compare two plates like strcmp, <0 if a < b, 0 if equal, >0 if a > b
+static inline int plate_cmp(plate_t a, plate_t b) { return (a > b) - (a < b); }
@@ -0,0 +1,231 @@
+#include "plate_table.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Maximum load before growing (linear probing falls over past this)
+#define PT_LOAD_FACTOR 0.75
+// smallest number of slots a table will have
+#define PT_MIN_CAPACITY 8
+
+// Every slot starts with this header and the value follows it inline
+// (8 bytes, so values are aligned for anything up to a long long)
+// A key of PLATE_NONE marks an empty slot
+struct pt_slot {
+  plate_t key;
+};
+
+typedef struct ptab {
+  // slots, capacity * stride bytes
+  char *slots;
+  // bytes per slot (header + value rounded up to 8 bytes)
+  size_t stride;
+  // bytes in each value
+  size_t value_size;
+  // number of slots, always a power of 2 so we can mask instead of mod
+  size_t capacity;
+  // Current number of plates
+  size_t size;
+  // whether racing readers are allowed (see ptab_create_shared)
+  bool shared;
+  // old slot arrays kept around for racing readers, freed on destroy
+  char **retired;
+  size_t num_retired;
+} ptab_t;
+
+static struct pt_slot *pt_slot_at(char *slots, size_t stride, size_t i) {
+  return (struct pt_slot *)(slots + i * stride);
+}
+
+static void *pt_value(struct pt_slot *slot) {
+  return (char *)slot + sizeof(struct pt_slot);
+}
+
+// Round n up to a power of 2 (at least PT_MIN_CAPACITY)
+static size_t pt_round_capacity(size_t n) {
+  size_t capacity = PT_MIN_CAPACITY;
+  while (capacity < n) {
+    capacity <<= 1;
+  }
+  return capacity;
+}
+
+// find the slot holding plate, or the empty slot it would go in
+static struct pt_slot *pt_probe(char *slots, size_t stride, size_t capacity,
+                                plate_t plate) {
+  size_t mask = capacity - 1;
+  size_t i = plate_hash(plate) & mask;
+  while (1) {
+    struct pt_slot *slot = pt_slot_at(slots, stride, i);
+    if (slot->key == PLATE_NONE || plate_eq(slot->key, plate)) {
+      return slot;
+    }
+    i = (i + 1) & mask;
+  }
+}
+
+ptab_t *ptab_create(size_t n, size_t value_size) {
+  ptab_t *t = calloc(1, sizeof(ptab_t));
+  if (!t) {
+    return NULL;
+  }
+  t->value_size = value_size;
+  t->stride = sizeof(struct pt_slot) + ((value_size + 7) & ~(size_t)7);
+  // leave enough room that n plates stay under the load factor
+  t->capacity = pt_round_capacity((size_t)(n / PT_LOAD_FACTOR) + 1);
+  t->slots = calloc(t->capacity, t->stride);
+  if (!t->slots) {
+    free(t);
+    return NULL;
+  }
+  t->size = 0;
+  return t;
+}
+
+ptab_t *ptab_create_shared(size_t n, size_t value_size) {
+  ptab_t *t = ptab_create(n, value_size);
+  if (t) {
+    t->shared = true;
+  }
+  return t;
+}
+
+void ptab_destroy(ptab_t *t) {
+  for (size_t i = 0; i < t->num_retired; i++) {
+    free(t->retired[i]);
+  }
+  free(t->retired);
+  free(t->slots);
+  free(t);
+}
+
+void *ptab_get(ptab_t *t, plate_t plate) {
+  if (plate == PLATE_NONE) {
+    return NULL;
+  }
+  struct pt_slot *slot = pt_probe(t->slots, t->stride, t->capacity, plate);
+  return slot->key != PLATE_NONE ? pt_value(slot) : NULL;
+}
+
+bool ptab_read_racy(ptab_t *t, plate_t plate, void *value) {
+  if (plate == PLATE_NONE) {
+    return false;
+  }
+  // a resize publishes the new slots before the new capacity, so reading them
+  // in the opposite order never pairs a small array with a big capacity (old
+  // arrays are never freed while the table exists)
+  size_t capacity = __atomic_load_n(&t->capacity, __ATOMIC_ACQUIRE);
+  char *slots = __atomic_load_n(&t->slots, __ATOMIC_ACQUIRE);
+  size_t mask = capacity - 1;
+  size_t i = plate_hash(plate) & mask;
+  // slots may be shifted under us, so never probe more than the whole table
+  for (size_t probes = 0; probes < capacity; probes++) {
+    struct pt_slot *slot = pt_slot_at(slots, t->stride, i);
+    plate_t key = __atomic_load_n(&slot->key, __ATOMIC_RELAXED);
+    if (key == PLATE_NONE) {
+      return false;
+    }
+    if (plate_eq(key, plate)) {
+      memcpy(value, pt_value(slot), t->value_size);
+      return true;
+    }
+    i = (i + 1) & mask;
+  }
+  return false;
+}
+
+bool ptab_resize(ptab_t *t, size_t n) {
+  size_t new_capacity = pt_round_capacity(n);
+  if (new_capacity <= t->capacity) {
+    return true; // already big enough
+  }
+  char *new_slots = calloc(new_capacity, t->stride);
+  if (!new_slots) {
+    // not enough memory
+    return false;
+  }
+  if (t->shared) {
+    // make room to keep the old array for any racing readers
+    char **retired =
+        realloc(t->retired, (t->num_retired + 1) * sizeof(char *));
+    if (!retired) {
+      free(new_slots);
+      return false;
+    }
+    t->retired = retired;
+  }
+  // move every plate into its slot in the new array
+  for (size_t i = 0; i < t->capacity; i++) {
+    struct pt_slot *slot = pt_slot_at(t->slots, t->stride, i);
+    if (slot->key != PLATE_NONE) {
+      memcpy(pt_probe(new_slots, t->stride, new_capacity, slot->key), slot,
+             t->stride);
+    }
+  }
+  if (t->shared) {
+    t->retired[t->num_retired++] = t->slots;
+    // racing readers load capacity then slots, see ptab_read_racy
+    __atomic_store_n(&t->slots, new_slots, __ATOMIC_RELEASE);
+    __atomic_store_n(&t->capacity, new_capacity, __ATOMIC_RELEASE);
+    return true;
+  }
+  free(t->slots);
+  t->slots = new_slots;
+  t->capacity = new_capacity;
+  return true;
+}
+
+bool ptab_set(ptab_t *t, plate_t plate, const void *value) {
+  if (plate == PLATE_NONE) {
+    return false;
+  }
+  struct pt_slot *slot = pt_probe(t->slots, t->stride, t->capacity, plate);
+  if (slot->key == PLATE_NONE) {
+    // ADDING NEW PLATE, grow first if it would overfill the table
+    if ((t->size + 1.0) / t->capacity >= PT_LOAD_FACTOR) {
+      if (!ptab_resize(t, t->capacity * 2)) {
+        return false;
+      }
+      slot = pt_probe(t->slots, t->stride, t->capacity, plate);
+    }
+    slot->key = plate;
+    t->size++;
+  }
+  memcpy(pt_value(slot), value, t->value_size);
+  return true;
+}
+
+// Remove by shifting later entries of the probe run back into the hole
+// so we never need tombstones
+bool ptab_remove(ptab_t *t, plate_t plate) {
+  if (plate == PLATE_NONE) {
+    return false;
+  }
+  size_t mask = t->capacity - 1;
+  struct pt_slot *slot = pt_probe(t->slots, t->stride, t->capacity, plate);
+  if (slot->key == PLATE_NONE) {
+    return false;
+  }
+  size_t hole = (size_t)((char *)slot - t->slots) / t->stride;
+  size_t i = hole;
+  while (1) {
+    i = (i + 1) & mask;
+    struct pt_slot *next = pt_slot_at(t->slots, t->stride, i);
+    if (next->key == PLATE_NONE) {
+      break;
+    }
+    // only move the entry back if its home slot is not between the hole and i
+    size_t home = plate_hash(next->key) & mask;
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      memcpy(pt_slot_at(t->slots, t->stride, hole), next, t->stride);
+      hole = i;
+    }
+  }
+  memset(pt_slot_at(t->slots, t->stride, hole), 0, t->stride);
+  t->size--;
+  return true;
+}
+
+size_t ptab_capacity(ptab_t *t) { return t->capacity; }
+
+size_t ptab_size(ptab_t *t) { return t->size; }
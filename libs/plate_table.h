@@ -0,0 +1,57 @@
+#pragma once
+
+#include "plate.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// An open-addressing hash table keyed by number plates
+// Keys and values are stored inline in one flat array of slots, so a lookup
+// only touches the slot(s) it probes and never allocates. Every value in the
+// table is the same size, given when the table is created.
+//
+// NOT thread-safe, the caller is responsible for locking
+typedef struct ptab ptab_t;
+
+// Create a table with room for at least n plates with values of value_size
+// bytes each. Returns NULL if the memory couldn't be allocated
+ptab_t *ptab_create(size_t n, size_t value_size);
+
+// Create a table like ptab_create that ptab_read_racy may be called on while
+// another thread is writing to it. Slot arrays replaced when the table grows
+// are kept until ptab_destroy instead of being freed, so a racing reader
+// never touches freed memory
+ptab_t *ptab_create_shared(size_t n, size_t value_size);
+
+// Destroy and free memory allocated for the table
+void ptab_destroy(ptab_t *t);
+
+// Get a pointer to the value stored for plate
+// return NULL if the plate is not in the table
+// the pointer is only valid until the next ptab_set or ptab_remove
+void *ptab_get(ptab_t *t, plate_t plate);
+
+// Copy the value for plate into value without any locking
+// ONLY for tables made with ptab_create_shared. If a writer is active at the
+// same time the copy (or the return value) may be torn, so the caller must
+// check that no write happened during the read, e.g. with a seqlock
+// return false if the plate was not found
+bool ptab_read_racy(ptab_t *t, plate_t plate, void *value);
+
+// Add a plate to the table OR update its value if it already exists
+// value is copied into the table (value_size bytes)
+// return false if the plate is PLATE_NONE or the table couldn't grow
+bool ptab_set(ptab_t *t, plate_t plate, const void *value);
+
+// Remove a plate from the table
+// return false if the plate was not in the table
+bool ptab_remove(ptab_t *t, plate_t plate);
+
+// Grow the table so it has at least n slots
+bool ptab_resize(ptab_t *t, size_t n);
+
+// table metadata
+// total number of slots
+size_t ptab_capacity(ptab_t *t);
+
+// number of plates
+size_t ptab_size(ptab_t *t);
@@ -0,0 +1,157 @@
+#include "pool.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Size classes are multiples of this (also the alignment of every block)
+#define POOL_ALIGN 16
+// Number of size classes, 16 to 256 bytes
+#define POOL_NUM_CLASSES 16
+// largest allocation that comes from a slab
+#define POOL_MAX_SIZE (POOL_ALIGN * POOL_NUM_CLASSES)
+// bytes per slab (including its header)
+#define POOL_SLAB_SIZE (64 * 1024)
+
+// A free block, the free list is threaded through the blocks themselves
+struct pool_block {
+  struct pool_block *next;
+};
+
+// Header at the start of every slab, padded so blocks stay aligned
+struct pool_slab {
+  struct pool_slab *next;
+} __attribute__((aligned(POOL_ALIGN)));
+
+// Header in front of allocations too big for a slab, so they can all be found
+// again by pool_destroy
+struct pool_big {
+  struct pool_big *prev;
+  struct pool_big *next;
+} __attribute__((aligned(POOL_ALIGN)));
+
+struct pool_class {
+  // blocks that have been freed, reused first
+  struct pool_block *free;
+  // unused space at the end of this class's newest slab
+  char *bump;
+  char *bump_end;
+};
+
+typedef struct pool {
+  struct pool_class classes[POOL_NUM_CLASSES];
+  // every slab, freed together on destroy
+  struct pool_slab *slabs;
+  // every live big allocation
+  struct pool_big *big;
+  struct pool_stats stats;
+} pool_t;
+
+// size class for an allocation of size bytes (size <= POOL_MAX_SIZE)
+static size_t pool_class_of(size_t size) {
+  return size == 0 ? 0 : (size - 1) / POOL_ALIGN;
+}
+
+pool_t *pool_create(void) { return calloc(1, sizeof(pool_t)); }
+
+void pool_destroy(pool_t *p) {
+  struct pool_slab *slab = p->slabs;
+  while (slab) {
+    struct pool_slab *next = slab->next;
+    free(slab);
+    slab = next;
+  }
+  struct pool_big *big = p->big;
+  while (big) {
+    struct pool_big *next = big->next;
+    free(big);
+    big = next;
+  }
+  free(p);
+}
+
+// Give a class a fresh slab to carve blocks from
+static bool pool_add_slab(pool_t *p, struct pool_class *c) {
+  struct pool_slab *slab = malloc(POOL_SLAB_SIZE);
+  if (!slab) {
+    return false;
+  }
+  p->stats.system_allocs++;
+  p->stats.slabs++;
+  slab->next = p->slabs;
+  p->slabs = slab;
+  // whatever was left of the last slab is too small for a block, drop it
+  c->bump = (char *)slab + sizeof(struct pool_slab);
+  c->bump_end = (char *)slab + POOL_SLAB_SIZE;
+  return true;
+}
+
+void *pool_alloc(pool_t *p, size_t size) {
+  p->stats.allocs++;
+  if (size > POOL_MAX_SIZE) {
+    // too big for a slab, link it in so destroy can free it
+    struct pool_big *big = malloc(sizeof(struct pool_big) + size);
+    if (!big) {
+      return NULL;
+    }
+    p->stats.system_allocs++;
+    big->prev = NULL;
+    big->next = p->big;
+    if (p->big) {
+      p->big->prev = big;
+    }
+    p->big = big;
+    return big + 1;
+  }
+  struct pool_class *c = &p->classes[pool_class_of(size)];
+  // reuse a freed block if there is one
+  if (c->free) {
+    struct pool_block *block = c->free;
+    c->free = block->next;
+    return block;
+  }
+  size_t block_size = (pool_class_of(size) + 1) * POOL_ALIGN;
+  if (c->bump_end - c->bump < (ptrdiff_t)block_size) {
+    if (!pool_add_slab(p, c)) {
+      return NULL;
+    }
+  }
+  void *block = c->bump;
+  c->bump += block_size;
+  return block;
+}
+
+void *pool_calloc(pool_t *p, size_t size) {
+  void *ptr = pool_alloc(p, size);
+  if (ptr) {
+    memset(ptr, 0, size);
+  }
+  return ptr;
+}
+
+void pool_free(pool_t *p, void *ptr, size_t size) {
+  if (ptr == NULL) {
+    return;
+  }
+  p->stats.frees++;
+  if (size > POOL_MAX_SIZE) {
+    // unlink and give it straight back
+    struct pool_big *big = (struct pool_big *)ptr - 1;
+    if (big->prev) {
+      big->prev->next = big->next;
+    } else {
+      p->big = big->next;
+    }
+    if (big->next) {
+      big->next->prev = big->prev;
+    }
+    free(big);
+    return;
+  }
+  // push it on the free list for its class
+  struct pool_class *c = &p->classes[pool_class_of(size)];
+  struct pool_block *block = (struct pool_block *)ptr;
+  block->next = c->free;
+  c->free = block;
+}
+
+void pool_get_stats(pool_t *p, struct pool_stats *stats) { *stats = p->stats; }
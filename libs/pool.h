@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A size-classed slab allocator for lots of small objects
+// Small allocations are carved out of big slabs and freed blocks go on a free
+// list for their size class, so they're reused without going back to malloc.
+// Anything bigger than the largest class falls back to malloc. Every
+// allocation is released at once by pool_destroy.
+//
+// NOT thread-safe, the caller is responsible for locking
+typedef struct pool pool_t;
+
+// Allocation counts for a pool
+struct pool_stats {
+  size_t allocs;        // pool_alloc/pool_calloc calls
+  size_t frees;         // pool_free calls
+  size_t system_allocs; // calls to malloc (slabs and big allocations)
+  size_t slabs;         // slabs currently held
+};
+
+// Create an empty pool (no slabs are allocated until they're needed)
+// Returns NULL if the memory couldn't be allocated
+pool_t *pool_create(void);
+
+// Free every slab and every allocation still held by the pool
+void pool_destroy(pool_t *p);
+
+// Allocate size bytes (16-byte aligned) from the pool
+// return NULL if memory couldn't be allocated
+void *pool_alloc(pool_t *p, size_t size);
+
+// pool_alloc but zeroed
+void *pool_calloc(pool_t *p, size_t size);
+
+// Give an allocation back to the pool
+// size must be the size it was allocated with
+void pool_free(pool_t *p, void *ptr, size_t size);
+
+// Copy the pool's allocation counts into stats
+void pool_get_stats(pool_t *p, struct pool_stats *stats);
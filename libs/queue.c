@@ -1,10 +1,116 @@
 // A thread-safe queue implementation.
 #include "queue.h"
 #include <pthread.h>
+#include <sched.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+static uint64_t qstats_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Only the queue holding its mutex writes, so a plain read then an atomic
+// store is enough for readers never to see half a write
+#define QSTATS_SET(field, value)                                             \
+  __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+
+QueueStats *qstats_create(uint64_t sample_interval_ms) {
+  QueueStats *s = calloc(1, sizeof(QueueStats));
+  if (s == NULL) {
+    return NULL;
+  }
+  s->start_ns = qstats_now_ns();
+  s->sample_interval_ns = sample_interval_ms * 1000000ULL;
+  s->next_sample_ns = s->start_ns;
+  return s;
+}
+
+void qstats_destroy(QueueStats *s) { free(s); }
+
+// Record the depth if it's time for another sample
+static void qstats_sample(QueueStats *s, size_t depth, uint64_t now) {
+  if (now < s->next_sample_ns) {
+    return;
+  }
+  uint64_t ms = (now - s->start_ns) / 1000000ULL;
+  if (depth >= (1ULL << QSTATS_DEPTH_BITS)) {
+    depth = (1ULL << QSTATS_DEPTH_BITS) - 1;
+  }
+  QSTATS_SET(s->series[s->num_samples % QSTATS_SERIES],
+             ms << QSTATS_DEPTH_BITS | depth);
+  // publish the sample after writing it
+  __atomic_store_n(&s->num_samples, s->num_samples + 1, __ATOMIC_RELEASE);
+  QSTATS_SET(s->next_sample_ns, now + s->sample_interval_ns);
+}
+
+// Record an item pushed, depth is the length after the push
+static void qstats_pushed(QueueStats *s, size_t depth, uint64_t now) {
+  QSTATS_SET(s->pushed, s->pushed + 1);
+  if (depth > s->max_depth) {
+    QSTATS_SET(s->max_depth, depth);
+  }
+  qstats_sample(s, depth, now);
+}
+
+// Record an item popped after waiting since enqueued_ns, depth is the length
+// after the pop
+static void qstats_popped(QueueStats *s, size_t depth, uint64_t enqueued_ns,
+                          uint64_t now) {
+  uint64_t wait_us = now > enqueued_ns ? (now - enqueued_ns) / 1000 : 0;
+  // bucket i holds waits under 2^i us
+  size_t bucket = wait_us ? 64 - __builtin_clzll(wait_us) : 0;
+  if (bucket >= QSTATS_BUCKETS) {
+    bucket = QSTATS_BUCKETS - 1;
+  }
+  QSTATS_SET(s->wait_hist[bucket], s->wait_hist[bucket] + 1);
+  QSTATS_SET(s->wait_us_total, s->wait_us_total + wait_us);
+  QSTATS_SET(s->popped, s->popped + 1);
+  qstats_sample(s, depth, now);
+}
+
+void qstats_read(QueueStats *s, QueueStats *out) {
+  out->num_samples = __atomic_load_n(&s->num_samples, __ATOMIC_ACQUIRE);
+  out->pushed = __atomic_load_n(&s->pushed, __ATOMIC_RELAXED);
+  out->popped = __atomic_load_n(&s->popped, __ATOMIC_RELAXED);
+  out->wait_us_total = __atomic_load_n(&s->wait_us_total, __ATOMIC_RELAXED);
+  for (size_t i = 0; i < QSTATS_BUCKETS; i++) {
+    out->wait_hist[i] = __atomic_load_n(&s->wait_hist[i], __ATOMIC_RELAXED);
+  }
+  out->max_depth = __atomic_load_n(&s->max_depth, __ATOMIC_RELAXED);
+  out->start_ns = s->start_ns;
+  out->sample_interval_ns = s->sample_interval_ns;
+  out->next_sample_ns = __atomic_load_n(&s->next_sample_ns, __ATOMIC_RELAXED);
+  for (size_t i = 0; i < QSTATS_SERIES; i++) {
+    out->series[i] = __atomic_load_n(&s->series[i], __ATOMIC_RELAXED);
+  }
+}
+
+uint64_t qstats_wait_percentile_us(const QueueStats *s, double p) {
+  uint64_t total = 0;
+  for (size_t i = 0; i < QSTATS_BUCKETS; i++) {
+    total += s->wait_hist[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t target = (uint64_t)(p * total + 0.999999);
+  if (target == 0) {
+    target = 1;
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < QSTATS_BUCKETS; i++) {
+    seen += s->wait_hist[i];
+    if (seen >= target) {
+      return 1ULL << i;
+    }
+  }
+  return 1ULL << (QSTATS_BUCKETS - 1);
+}
 
 Queue *queue_create(int id) {
   Queue *q = malloc(sizeof(Queue));
@@ -12,6 +118,7 @@ Queue *queue_create(int id) {
   q->head = NULL;
   q->tail = NULL;
   q->length = 0;
+  q->stats = NULL;
   int mutex = pthread_mutex_init(&q->mutex, NULL);
   if (mutex) {
     perror("Error creating mutex");
@@ -39,10 +146,16 @@ bool queue_push(Queue *q, void *value, size_t size) {
   pthread_mutex_lock(&q->mutex);
   QItem *new_item = calloc(1, sizeof(QItem));
   if (new_item == NULL) {
+    pthread_mutex_unlock(&q->mutex);
     return false;
   }
   // allocate memory for the value
   new_item->value = calloc(1, size);
+  if (new_item->value == NULL) {
+    pthread_mutex_unlock(&q->mutex);
+    free(new_item);
+    return false;
+  }
   // copy the value into the new item
   memcpy(new_item->value, value, size);
   // end of queue so no next
@@ -55,35 +168,147 @@ bool queue_push(Queue *q, void *value, size_t size) {
     q->tail->next = new_item;
     q->tail = new_item;
   }
+  q->length++;
+  if (q->stats) {
+    new_item->enqueued_ns = qstats_now_ns();
+    qstats_pushed(q->stats, q->length, new_item->enqueued_ns);
+  }
   // signal the condition variable
   pthread_cond_broadcast(&q->condition);
   pthread_mutex_unlock(&q->mutex);
-  q->length++;
   return true;
 }
 
 // Pop an item from the front of the queue.
 void queue_pop(Queue *q) {
-  if (!q || !q->head) {
+  if (!q) {
     return;
   }
   // ensure only one thread can access the queue at a time
   pthread_mutex_lock(&q->mutex);
-  QItem *item = q->head;
-  q->head = q->head->next;
-  // if the queue is now empty, set the tail to NULL
-  if (q->head == NULL) {
-    q->tail = NULL;
-  }
+  QItem *item = unsafe_queue_pop_return(q);
   // broadcast the condition variable
   pthread_cond_broadcast(&q->condition);
   pthread_mutex_unlock(&q->mutex);
-  free(item->value);
-  free(item);
-  q->length--;
+  if (item) {
+    free(item->value);
+    free(item);
+  }
   return;
 }
 
+bool queue_push_n(Queue *q, const void *values, size_t size, size_t n) {
+  if (q == NULL) {
+    return false;
+  }
+  if (n == 0) {
+    return true;
+  }
+  // build the chain before locking, nothing else can see it yet
+  QItem *head = NULL;
+  QItem *tail = NULL;
+  for (size_t i = 0; i < n; i++) {
+    QItem *new_item = calloc(1, sizeof(QItem));
+    if (new_item) {
+      new_item->value = malloc(size);
+    }
+    if (new_item == NULL || new_item->value == NULL) {
+      free(new_item);
+      while (head) {
+        QItem *next = head->next;
+        free(head->value);
+        free(head);
+        head = next;
+      }
+      return false;
+    }
+    memcpy(new_item->value, (const char *)values + i * size, size);
+    if (head == NULL) {
+      head = new_item;
+    } else {
+      tail->next = new_item;
+    }
+    tail = new_item;
+  }
+
+  pthread_mutex_lock(&q->mutex);
+  if (q->head == NULL) {
+    q->head = head;
+  } else {
+    q->tail->next = head;
+  }
+  q->tail = tail;
+  if (q->stats) {
+    uint64_t now = qstats_now_ns();
+    for (QItem *item = head; item; item = item->next) {
+      item->enqueued_ns = now;
+      qstats_pushed(q->stats, ++q->length, now);
+    }
+  } else {
+    q->length += n;
+  }
+  pthread_cond_broadcast(&q->condition);
+  pthread_mutex_unlock(&q->mutex);
+  return true;
+}
+
+size_t queue_drain(Queue *q, void *values, size_t size, size_t max) {
+  if (!q || max == 0) {
+    return 0;
+  }
+  // unlink the first max items in one go, copy and free them after unlocking
+  pthread_mutex_lock(&q->mutex);
+  QItem *head = q->head;
+  QItem *last = NULL;
+  size_t n = 0;
+  for (QItem *item = head; item && n < max; item = item->next) {
+    last = item;
+    n++;
+  }
+  if (n > 0) {
+    q->head = last->next;
+    if (q->head == NULL) {
+      q->tail = NULL;
+    }
+    last->next = NULL;
+    if (q->stats) {
+      uint64_t now = qstats_now_ns();
+      for (QItem *item = head; item; item = item->next) {
+        qstats_popped(q->stats, --q->length, item->enqueued_ns, now);
+      }
+    } else {
+      q->length -= n;
+    }
+    pthread_cond_broadcast(&q->condition);
+  }
+  pthread_mutex_unlock(&q->mutex);
+
+  char *out = values;
+  while (head) {
+    QItem *next = head->next;
+    memcpy(out, head->value, size);
+    out += size;
+    free(head->value);
+    free(head);
+    head = next;
+  }
+  return n;
+}
+
+size_t queue_snapshot(Queue *q, void *values, size_t size, size_t max) {
+  if (!q) {
+    return 0;
+  }
+  char *out = values;
+  size_t n = 0;
+  pthread_mutex_lock(&q->mutex);
+  for (QItem *item = q->head; item && n < max; item = item->next, n++) {
+    memcpy(out + n * size, item->value, size);
+  }
+  pthread_mutex_unlock(&q->mutex);
+  return n;
+}
+
 QItem *unsafe_queue_pop_return(Queue *q) {
   if (!q || !q->head) {
     return NULL;
@@ -95,6 +320,9 @@ QItem *unsafe_queue_pop_return(Queue *q) {
     q->tail = NULL;
   }
   q->length--;
+  if (q->stats) {
+    qstats_popped(q->stats, q->length, item->enqueued_ns, qstats_now_ns());
+  }
   return item;
 }
 
@@ -122,3 +350,320 @@ bool destroy_queue(Queue *q) {
   free(q);
   return 1;
 }
+
+void queue_set_stats(Queue *q, QueueStats *stats) {
+  pthread_mutex_lock(&q->mutex);
+  // items already queued have no push time, count them as pushed now
+  uint64_t now = qstats_now_ns();
+  for (QItem *item = q->head; item; item = item->next) {
+    item->enqueued_ns = now;
+  }
+  q->stats = stats;
+  pthread_mutex_unlock(&q->mutex);
+}
+
+IQueue *iqueue_create(int id) {
+  IQueue *q = malloc(sizeof(IQueue));
+  if (q == NULL) {
+    perror("Error allocating queue");
+    exit(EXIT_FAILURE);
+  }
+  q->id = id;
+  q->head = NULL;
+  q->tail = NULL;
+  q->length = 0;
+  q->stats = NULL;
+  if (pthread_mutex_init(&q->mutex, NULL)) {
+    perror("Error creating mutex");
+    exit(EXIT_FAILURE);
+  }
+  return q;
+}
+
+QNode *iqueue_peek(IQueue *q) { return q->head; }
+
+void iqueue_push(IQueue *q, QNode *node) {
+  node->next = NULL;
+  node->wake = NULL;
+  pthread_mutex_lock(&q->mutex);
+  if (q->head == NULL) {
+    q->head = node;
+  } else {
+    q->tail->next = node;
+  }
+  q->tail = node;
+  q->length++;
+  if (q->stats) {
+    node->enqueued_ns = qstats_now_ns();
+    qstats_pushed(q->stats, q->length, node->enqueued_ns);
+  }
+  pthread_mutex_unlock(&q->mutex);
+}
+
+void iqueue_wait_front(IQueue *q, QNode *node) {
+  pthread_mutex_lock(&q->mutex);
+  if (q->head != node) {
+    // sleep on our own condition so no one else is woken for us
+    pthread_cond_t wake;
+    pthread_cond_init(&wake, NULL);
+    node->wake = &wake;
+    while (q->head != node) {
+      pthread_cond_wait(&wake, &q->mutex);
+    }
+    node->wake = NULL;
+    pthread_cond_destroy(&wake);
+  }
+  pthread_mutex_unlock(&q->mutex);
+}
+
+QNode *iqueue_pop(IQueue *q) {
+  pthread_mutex_lock(&q->mutex);
+  QNode *node = unsafe_iqueue_pop_return(q);
+  pthread_mutex_unlock(&q->mutex);
+  return node;
+}
+
+size_t iqueue_snapshot(IQueue *q, void *out, size_t size, size_t offset,
+                       size_t max) {
+  char *dest = out;
+  size_t n = 0;
+  pthread_mutex_lock(&q->mutex);
+  for (QNode *node = q->head; node && n < max; node = node->next, n++) {
+    memcpy(dest + n * size, (char *)node - offset, size);
+  }
+  pthread_mutex_unlock(&q->mutex);
+  return n;
+}
+
+QNode *unsafe_iqueue_pop_return(IQueue *q) {
+  QNode *node = q->head;
+  if (node == NULL) {
+    return NULL;
+  }
+  q->head = node->next;
+  // if the queue is now empty, set the tail to NULL
+  if (q->head == NULL) {
+    q->tail = NULL;
+  }
+  node->next = NULL;
+  q->length--;
+  if (q->stats) {
+    qstats_popped(q->stats, q->length, node->enqueued_ns, qstats_now_ns());
+  }
+  // only the new head has anything to wake up for
+  if (q->head && q->head->wake) {
+    pthread_cond_signal(q->head->wake);
+  }
+  return node;
+}
+
+bool destroy_iqueue(IQueue *q) {
+  if (q == NULL) {
+    return false;
+  }
+  // the nodes belong to whoever pushed them, nothing to free
+  if (pthread_mutex_destroy(&q->mutex)) {
+    perror("Error destroying mutex");
+    exit(EXIT_FAILURE);
+  }
+  free(q);
+  return true;
+}
+
+void iqueue_set_stats(IQueue *q, QueueStats *stats) {
+  pthread_mutex_lock(&q->mutex);
+  uint64_t now = qstats_now_ns();
+  for (QNode *node = q->head; node; node = node->next) {
+    node->enqueued_ns = now;
+  }
+  q->stats = stats;
+  pthread_mutex_unlock(&q->mutex);
+}
+
+// Every slot starts with its sequence number and the item follows it inline
+// seq == position: empty, ready for the push at that position
+// seq == position + 1: full, ready for the pop at that position
+struct ring_slot {
+  size_t seq;
+};
+
+static struct ring_slot *ring_slot_at(Ring *r, size_t pos) {
+  return (struct ring_slot *)(r->slots + (pos & (r->capacity - 1)) * r->stride);
+}
+
+Ring *ring_create(size_t capacity, size_t item_size) {
+  Ring *r;
+  if (posix_memalign((void **)&r, 64, sizeof(Ring)) != 0) {
+    return NULL;
+  }
+  memset(r, 0, sizeof(Ring));
+  r->item_size = item_size;
+  r->stride = sizeof(struct ring_slot) + ((item_size + 7) & ~(size_t)7);
+  r->capacity = 2;
+  while (r->capacity < capacity) {
+    r->capacity <<= 1;
+  }
+  r->slots = malloc(r->capacity * r->stride);
+  if (!r->slots || sem_init(&r->items, 0, 0) != 0) {
+    free(r->slots);
+    free(r);
+    return NULL;
+  }
+  for (size_t i = 0; i < r->capacity; i++) {
+    ring_slot_at(r, i)->seq = i;
+  }
+  return r;
+}
+
+bool ring_push(Ring *r, const void *item) {
+  if (__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  size_t pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+  struct ring_slot *slot;
+  while (1) {
+    slot = ring_slot_at(r, pos);
+    long diff = (long)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+    if (diff == 0) {
+      // slot is free, try to claim it (pos is updated if another producer
+      // got there first)
+      if (__atomic_compare_exchange_n(&r->tail, &pos, pos + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // the consumer a lap behind hasn't emptied it yet, the ring is full
+      return false;
+    } else {
+      // another producer took this slot, try the next
+      pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    }
+  }
+  memcpy(slot + 1, item, r->item_size);
+  // publish the item, then wake one consumer for it
+  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+  sem_post(&r->items);
+  return true;
+}
+
+size_t ring_push_n(Ring *r, const void *items, size_t n) {
+  if (n == 0 || __atomic_load_n(&r->closed, __ATOMIC_ACQUIRE)) {
+    return 0;
+  }
+  size_t pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+  size_t count;
+  while (1) {
+    // count the free slots in a row from pos, only the producer that moves
+    // tail past them can fill them, so they stay free until we claim them
+    count = 0;
+    while (count < n && count < r->capacity) {
+      struct ring_slot *slot = ring_slot_at(r, pos + count);
+      if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + count) {
+        break;
+      }
+      count++;
+    }
+    if (count == 0) {
+      long diff = (long)(__atomic_load_n(&ring_slot_at(r, pos)->seq,
+                                         __ATOMIC_ACQUIRE) -
+                         pos);
+      if (diff < 0) {
+        // full
+        return 0;
+      }
+      // another producer took it, try again from the new tail
+      pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+      continue;
+    }
+    if (__atomic_compare_exchange_n(&r->tail, &pos, pos + count, true,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+  for (size_t i = 0; i < count; i++) {
+    struct ring_slot *slot = ring_slot_at(r, pos + i);
+    memcpy(slot + 1, (const char *)items + i * r->item_size, r->item_size);
+    __atomic_store_n(&slot->seq, pos + i + 1, __ATOMIC_RELEASE);
+  }
+  // every item needs its own count, consumers sleep on the semaphore
+  for (size_t i = 0; i < count; i++) {
+    sem_post(&r->items);
+  }
+  return count;
+}
+
+// Take the next item if there is one
+static bool ring_take(Ring *r, void *item) {
+  size_t pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+  struct ring_slot *slot;
+  while (1) {
+    slot = ring_slot_at(r, pos);
+    long diff =
+        (long)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (pos + 1));
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&r->head, &pos, pos + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // not pushed yet, empty (or a producer is part way through a push)
+      return false;
+    } else {
+      pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    }
+  }
+  memcpy(item, slot + 1, r->item_size);
+  // hand the slot back to the producer a lap ahead
+  __atomic_store_n(&slot->seq, pos + r->capacity, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool ring_pop(Ring *r, void *item) {
+  while (sem_wait(&r->items) != 0) {
+    // interrupted by a signal, keep waiting
+  }
+  if (__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE)) {
+    // pass the wakeup on so the next waiting consumer sees it's closed too
+    sem_post(&r->items);
+    return false;
+  }
+  // there's an item for us, but slots are taken in order so it may be behind
+  // a push that hasn't finished yet
+  while (!ring_take(r, item)) {
+    sched_yield();
+  }
+  return true;
+}
+
+bool ring_try_pop(Ring *r, void *item) {
+  if (sem_trywait(&r->items) != 0) {
+    return false;
+  }
+  if (__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE)) {
+    // might have been the close wakeup, leave it for the waiting consumers
+    sem_post(&r->items);
+    return false;
+  }
+  while (!ring_take(r, item)) {
+    sched_yield();
+  }
+  return true;
+}
+
+void ring_close(Ring *r) {
+  __atomic_store_n(&r->closed, true, __ATOMIC_RELEASE);
+  // wake one consumer, each one wakes the next on its way out
+  sem_post(&r->items);
+}
+
+size_t ring_length(Ring *r) {
+  size_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+  size_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+  return tail > head ? tail - head : 0;
+}
+
+void ring_destroy(Ring *r) {
+  sem_destroy(&r->items);
+  free(r->slots);
+  free(r);
+}
@@ -1,14 +1,70 @@
 #pragma once
 
 #include <pthread.h>
+#include <semaphore.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 // Header file for a thread-safe queue of strings
 
+// Optional instrumentation for a Queue or IQueue: how long items wait in it
+// and how deep it gets. Attach one with queue_set_stats/iqueue_set_stats.
+// Only the queue updates it (holding the queue's mutex), every field is
+// written atomically so it can be read at any time without the mutex.
+// Fields read separately may be from either side of a push or pop.
+
+// wait histogram buckets, bucket i counts waits under 2^i microseconds (and
+// at least 2^(i-1)), the last one counts everything longer
+#define QSTATS_BUCKETS 32
+// depth samples kept, the oldest are overwritten
+#define QSTATS_SERIES 256
+
+typedef struct QueueStats {
+  uint64_t pushed;
+  uint64_t popped;
+  // total microseconds popped items spent in the queue
+  uint64_t wait_us_total;
+  uint64_t wait_hist[QSTATS_BUCKETS];
+  // deepest the queue has been
+  uint64_t max_depth;
+  // when the stats were created
+  uint64_t start_ns;
+  // a depth sample is taken on the first push or pop at least this long after
+  // the last one
+  uint64_t sample_interval_ns;
+  uint64_t next_sample_ns;
+  // number of samples ever taken, sample i is in series[i % QSTATS_SERIES]
+  uint64_t num_samples;
+  // ms since start_ns << QSTATS_DEPTH_BITS | depth, one word so it can't tear
+  uint64_t series[QSTATS_SERIES];
+} QueueStats;
+
+#define QSTATS_DEPTH_BITS 24
+// time (ms since the stats were created) and depth of a series sample
+#define QSTATS_SAMPLE_MS(sample) ((sample) >> QSTATS_DEPTH_BITS)
+#define QSTATS_SAMPLE_DEPTH(sample)                                          \
+  ((sample) & ((1ULL << QSTATS_DEPTH_BITS) - 1))
+
+// Create stats that sample the depth at most every sample_interval_ms
+// Returns NULL if the memory couldn't be allocated
+QueueStats *qstats_create(uint64_t sample_interval_ms);
+
+// Free stats, detach them from their queue first
+void qstats_destroy(QueueStats *s);
+
+// Copy the stats into out, without locking anything
+void qstats_read(QueueStats *s, QueueStats *out);
+
+// The wait (us) that fraction p (0 - 1) of popped items waited at most,
+// rounded up to a histogram bucket
+uint64_t qstats_wait_percentile_us(const QueueStats *s, double p);
+
 typedef struct QItem {
   void *value; // value can be any type
   struct QItem *next;
+  // when it was pushed (ns), only set if the queue has stats
+  uint64_t enqueued_ns;
 } QItem;
 
 typedef struct Queue {
@@ -18,6 +74,8 @@ typedef struct Queue {
   pthread_mutex_t mutex;
   pthread_cond_t condition;
   size_t length;
+  // NULL unless instrumented
+  QueueStats *stats;
 } Queue;
 
 // Create a new queue. Allocate memory for the queue and initialise the
@@ -33,6 +91,22 @@ bool queue_push(Queue *q, void *value, size_t size);
 // Remove the item at the head of the queue
 void queue_pop(Queue *q);
 
+// Add n items (n * size bytes from values) to the tail of the queue, all at
+// once: the items are allocated before the mutex is taken and linked in with
+// one lock and one wakeup. Either all of them are added or none are.
+bool queue_push_n(Queue *q, const void *values, size_t size, size_t n);
+
+// Remove up to max items from the head of the queue with one lock and one
+// wakeup, copying their values (size bytes each) into values
+// return the number of items removed
+size_t queue_drain(Queue *q, void *values, size_t size, size_t max);
+
+// Copy the values (size bytes each) of up to max items from the head of the
+// queue into values without removing them, so they can be looked at after the
+// mutex is released
+// return the number of items copied
+size_t queue_snapshot(Queue *q, void *values, size_t size, size_t max);
+
 // Pop an item from the front of the queue and return it.
 // unsafe, assumes:
 // - the caller has locked the mutex
@@ -41,3 +115,134 @@ QItem *unsafe_queue_pop_return(Queue *q);
 
 // Destroy a queue, freeing memory for remaining items.
 bool destroy_queue(Queue *q);
+
+// Start (or with NULL, stop) recording into stats, the caller keeps ownership
+void queue_set_stats(Queue *q, QueueStats *stats);
+
+// An intrusive thread-safe queue: instead of the queue allocating an item and
+// copying the value in, the caller embeds a QNode in its own struct and pushes
+// that. Pushing and popping just relink pointers, nothing is allocated, copied
+// or freed. A node must stay alive (and not be pushed anywhere else) until it
+// is popped.
+//
+// It's also a FIFO lock for whoever pushed the nodes: iqueue_wait_front
+// sleeps until a node reaches the front. Every waiter sleeps on its own
+// condition variable, and a pop only wakes the new head, so a pop costs the
+// same however many are waiting behind it.
+
+// Link to embed in a struct that goes in an IQueue
+typedef struct QNode {
+  struct QNode *next;
+  // signalled when this node gets to the front, NULL if no one is waiting
+  pthread_cond_t *wake;
+  // when it was pushed (ns), only set if the queue has stats
+  uint64_t enqueued_ns;
+} QNode;
+
+// Get the struct of the given type that node is the member field of
+#define QNODE_ENTRY(node, type, member)                                      \
+  ((type *)((char *)(node) - offsetof(type, member)))
+
+typedef struct IQueue {
+  int id;
+  QNode *head;
+  QNode *tail;
+  pthread_mutex_t mutex;
+  size_t length;
+  // NULL unless instrumented
+  QueueStats *stats;
+} IQueue;
+
+// Create a new intrusive queue and initialise the mutex.
+IQueue *iqueue_create(int id);
+
+// Get the node at the head of the queue (NULL if empty) without removing it.
+// Lock the mutex for an answer that doesn't change under you.
+QNode *iqueue_peek(IQueue *q);
+
+// Link a node onto the tail of the queue
+void iqueue_push(IQueue *q, QNode *node);
+
+// Wait until node (already pushed) is at the front of the queue
+void iqueue_wait_front(IQueue *q, QNode *node);
+
+// Unlink the node at the head of the queue and wake the new head if it is
+// waiting in iqueue_wait_front
+// return the node, or NULL if the queue was empty
+QNode *iqueue_pop(IQueue *q);
+
+// Copy up to max of the structs the queue's nodes are embedded in (size bytes
+// each, starting offset bytes before the node) into out, in queue order,
+// holding the mutex only while copying. Use IQUEUE_SNAPSHOT
+// return the number of structs copied
+size_t iqueue_snapshot(IQueue *q, void *out, size_t size, size_t offset,
+                       size_t max);
+
+// Snapshot up to max of the type structs (holding the QNode in member) queued
+// in q into the type array out
+#define IQUEUE_SNAPSHOT(q, out, max, type, member)                           \
+  iqueue_snapshot((q), (out), sizeof(type), offsetof(type, member), (max))
+
+// Unlink the node at the head of the queue and return it (NULL if empty),
+// waking the new head like iqueue_pop
+// unsafe, assumes the caller has locked the mutex
+QNode *unsafe_iqueue_pop_return(IQueue *q);
+
+// Destroy an intrusive queue. Any nodes still in it are left alone, they
+// belong to the caller
+bool destroy_iqueue(IQueue *q);
+
+// Start (or with NULL, stop) recording into stats, the caller keeps ownership
+void iqueue_set_stats(IQueue *q, QueueStats *stats);
+
+// A bounded multi-producer/multi-consumer ring buffer of fixed-size items
+// Items are copied into slots allocated up front, so pushing and popping never
+// allocate. Pushing and popping take no lock, each slot has a sequence number
+// saying whether it is ready to be written or read. A push wakes exactly one
+// waiting consumer (not every one, like a broadcast would).
+typedef struct Ring {
+  // slots, capacity * stride bytes
+  char *slots;
+  // bytes per slot (sequence number + item, rounded up to 8 bytes)
+  size_t stride;
+  size_t item_size;
+  // number of slots, a power of 2
+  size_t capacity;
+  // kept on their own cache lines so producers and consumers don't fight
+  size_t head __attribute__((aligned(64))); // next slot to pop
+  size_t tail __attribute__((aligned(64))); // next slot to push
+  // counts items pushed but not yet popped, consumers sleep on it
+  sem_t items __attribute__((aligned(64)));
+  bool closed;
+} Ring;
+
+// Create a ring that holds at least capacity items of item_size bytes
+// Returns NULL if the memory couldn't be allocated
+Ring *ring_create(size_t capacity, size_t item_size);
+
+// Copy item (item_size bytes) into the ring and wake one waiting consumer
+// return false if the ring is full or closed
+bool ring_push(Ring *r, const void *item);
+
+// Copy up to n items (n * item_size bytes) into the ring, claiming a run of
+// slots for all of them at once, and wake a consumer for each
+// return the number pushed, fewer than n if the ring filled up (0 if closed)
+size_t ring_push_n(Ring *r, const void *items, size_t n);
+
+// Wait for an item and copy it out into item
+// return false (without waiting any longer) once the ring is closed
+bool ring_pop(Ring *r, void *item);
+
+// Copy the next item into item if there is one, without waiting
+// return false if the ring is empty or closed
+bool ring_try_pop(Ring *r, void *item);
+
+// Close the ring, every consumer waiting in ring_pop returns false and any
+// items left in it are dropped
+void ring_close(Ring *r);
+
+// number of items in the ring (a snapshot)
+size_t ring_length(Ring *r);
+
+// Destroy a ring, it must have no waiting consumers (close and join them)
+void ring_destroy(Ring *r);
@@ -0,0 +1,161 @@
+#include "reactor.h"
+#include "config.h"
+#include "delay.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+// longest a worker sleeps without looking at the doorbell (ns), so even a
+// wake up that's missed can't hold a device up for long
+#define REACTOR_IDLE_NS 100000000ULL
+
+struct device {
+  pthread_mutex_t mutex;
+  reactor_t *r;
+  int id;
+  uint64_t due; // when its timer comes (ns)
+  // false once the timer's been handled, so the wheel running a timer just
+  // before it was replaced doesn't count
+  bool armed;
+  wheel_timer_t timer;
+};
+
+struct worker {
+  reactor_t *r;
+  pthread_t thread;
+  int id;
+};
+
+struct reactor {
+  Doorbell *doorbell;
+  struct device *devices;
+  int num_devices;
+  reactor_fn on_ring;
+  reactor_fn on_timer;
+  void *arg;
+  timer_wheel_t *wheel;
+  Doorbell *timers; // rung by the wheel for devices whose timer came
+  struct worker *workers;
+  int num_workers;
+  int stop;
+};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// On the wheel's thread, hand the timer to a worker
+static void timer_came(void *arg) {
+  struct device *d = arg;
+  doorbell_ring(d->r->timers, d->id);
+  fword_kick(&d->r->doorbell->rung);
+}
+
+static void *work(void *arg) {
+  struct worker *w = arg;
+  reactor_t *r = w->r;
+  // start looking at the doorbell somewhere different to the other workers
+  int from = (int)((long)w->id * r->num_devices / r->num_workers);
+  while (!__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE)) {
+    // before looking for work, so a ring after this wakes us
+    uint32_t word = fword_load(&r->doorbell->rung);
+    int device = doorbell_take(r->timers, r->num_devices, from);
+    if (device != -1) {
+      struct device *d = &r->devices[device];
+      pthread_mutex_lock(&d->mutex);
+      if (d->armed && now_ns() >= d->due) {
+        d->armed = false;
+        r->on_timer(r, device, r->arg);
+      }
+      pthread_mutex_unlock(&d->mutex);
+      continue;
+    }
+    device = doorbell_take(r->doorbell, r->num_devices, from);
+    if (device != -1) {
+      from = device + 1;
+      struct device *d = &r->devices[device];
+      pthread_mutex_lock(&d->mutex);
+      r->on_ring(r, device, r->arg);
+      pthread_mutex_unlock(&d->mutex);
+      continue;
+    }
+    fword_timedwait(&r->doorbell->rung, word, REACTOR_IDLE_NS);
+  }
+  return NULL;
+}
+
+reactor_t *reactor_start(Doorbell *doorbell, int devices, int workers,
+                         reactor_fn on_ring, reactor_fn on_timer, void *arg) {
+  if (devices < 1 || workers < 1) {
+    return NULL;
+  }
+  reactor_t *r = calloc(1, sizeof(reactor_t));
+  if (r == NULL) {
+    return NULL;
+  }
+  r->devices = calloc(devices, sizeof(struct device));
+  r->timers = calloc(1, DOORBELL_SIZE(devices));
+  r->workers = calloc(workers, sizeof(struct worker));
+  r->wheel = wheel_start();
+  if (r->devices == NULL || r->timers == NULL || r->workers == NULL ||
+      r->wheel == NULL) {
+    if (r->wheel != NULL) {
+      wheel_stop(r->wheel);
+    }
+    free(r->devices);
+    free(r->timers);
+    free(r->workers);
+    free(r);
+    return NULL;
+  }
+  r->doorbell = doorbell;
+  r->num_devices = devices;
+  r->on_ring = on_ring;
+  r->on_timer = on_timer;
+  r->arg = arg;
+  for (int i = 0; i < devices; i++) {
+    pthread_mutex_init(&r->devices[i].mutex, NULL);
+    r->devices[i].r = r;
+    r->devices[i].id = i;
+  }
+  r->num_workers = workers;
+  for (int i = 0; i < workers; i++) {
+    r->workers[i].r = r;
+    r->workers[i].id = i;
+    if (pthread_create(&r->workers[i].thread, NULL, work, &r->workers[i]) !=
+        0) {
+      // stop the ones that did start
+      r->num_workers = i;
+      reactor_stop(r);
+      return NULL;
+    }
+  }
+  return r;
+}
+
+void reactor_defer(reactor_t *r, int device, int ms) {
+  struct device *d = &r->devices[device];
+  // before the wheel works out when to run it, so it's never early for this
+  d->due = now_ns() + (uint64_t)ms * 1000000ULL * TIME_FACTOR;
+  d->armed = true;
+  wheel_arm(r->wheel, &d->timer, ms, timer_came, d);
+}
+
+void reactor_stop(reactor_t *r) {
+  __atomic_store_n(&r->stop, 1, __ATOMIC_RELEASE);
+  fword_kick(&r->doorbell->rung);
+  for (int i = 0; i < r->num_workers; i++) {
+    pthread_join(r->workers[i].thread, NULL);
+  }
+  // after the workers, they arm its timers
+  wheel_stop(r->wheel);
+  for (int i = 0; i < r->num_devices; i++) {
+    pthread_mutex_destroy(&r->devices[i].mutex);
+  }
+  free(r->workers);
+  free(r->timers);
+  free(r->devices);
+  free(r);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "doorbell.h"
+
+// A fixed pool of worker threads serving every device on a doorbell.
+// A worker calls on_ring for a device whose bell was rung, and on_timer for a
+// device once the time it asked for with reactor_defer comes (kept on a timer
+// wheel, see delay.h), so a device waiting on something (e.g. a gate closing)
+// doesn't hold up a thread.
+// A device is only ever in one callback at a time, its lock is held while
+// it's called.
+typedef struct reactor reactor_t;
+
+// Called on a worker with device locked, arg is the one given to
+// reactor_start
+typedef void (*reactor_fn)(reactor_t *r, int device, void *arg);
+
+// Start workers threads serving the first devices bells of the doorbell
+// return NULL if they couldn't be started
+reactor_t *reactor_start(Doorbell *doorbell, int devices, int workers,
+                         reactor_fn on_ring, reactor_fn on_timer, void *arg);
+
+// Call on_timer for device after ms (scaled by TIME_FACTOR like delay_ms).
+// A device has one timer, deferring again replaces it
+// ONLY call it from a callback for that device (with it locked)
+void reactor_defer(reactor_t *r, int device, int ms);
+
+// Stop the workers, wait for them to finish what they're doing and free the
+// reactor. Timers that haven't come yet are dropped
+void reactor_stop(reactor_t *r);
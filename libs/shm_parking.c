@@ -5,13 +5,141 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
-struct SharedMemory *create_shm(char *name) {
+// Identifies a car park's shared memory (and the version of its layout)
+#define SHM_MAGIC "PARKSHM2"
+
+// where the doorbell starts, the first cache line after the devices
+static size_t shm_doorbell_offset(const struct ShmTopology *t) {
+  size_t devices = t->num_entrances * sizeof(struct Entrance) +
+                   t->num_exits * sizeof(struct Exit) +
+                   t->num_levels * sizeof(struct Level);
+  return (devices + SHM_CACHE_LINE - 1) / SHM_CACHE_LINE * SHM_CACHE_LINE;
+}
+
+// bytes of shared memory a car park of the given dimensions needs
+static size_t shm_size(const struct ShmTopology *t) {
+  int bells = t->num_entrances + t->num_levels + t->num_exits;
+  return shm_doorbell_offset(t) + DOORBELL_SIZE(bells) +
+         sizeof(struct ShmTrailer);
+}
+
+// Map size bytes of the shared memory in fd at a huge page boundary, so every
+// whole huge page of it can be backed by one
+static void *shm_map_aligned(int fd, size_t size) {
+  // reserve enough address space to find a boundary in, then map over it
+  size_t reserved = size + SHM_HUGE_PAGE;
+  char *reserve = mmap(NULL, reserved, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (reserve == MAP_FAILED) {
+    return MAP_FAILED;
+  }
+  uintptr_t boundary = ((uintptr_t)reserve + SHM_HUGE_PAGE - 1) &
+                       ~(uintptr_t)(SHM_HUGE_PAGE - 1);
+  char *aligned = (char *)boundary;
+  void *map = mmap(aligned, size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_FIXED, fd, 0);
+  if (map == MAP_FAILED) {
+    munmap(reserve, reserved);
+    return MAP_FAILED;
+  }
+  // give back the reservation either side
+  size_t page = sysconf(_SC_PAGESIZE);
+  char *end = aligned + ((size + page - 1) & ~(page - 1));
+  if (aligned > reserve) {
+    munmap(reserve, aligned - reserve);
+  }
+  if (reserve + reserved > end) {
+    munmap(end, reserve + reserved - end);
+  }
+  return map;
+}
+
+// Fault in every page of the mapping for writing, without changing anything
+static void shm_prefault(void *map, size_t size) {
+#ifdef MADV_POPULATE_WRITE
+  if (madvise(map, size, MADV_POPULATE_WRITE) == 0) {
+    return;
+  }
+#endif
+  // older kernels, touch each page ourselves. Adding 0 atomically doesn't
+  // disturb a process already using the segment
+  size_t page = sysconf(_SC_PAGESIZE);
+  for (size_t offset = 0; offset < size; offset += page) {
+    __atomic_fetch_add((char *)map + offset, 0, __ATOMIC_RELAXED);
+  }
+}
+
+// Map size bytes of the shared memory in fd as map_flags asks
+// exits if it can't be mapped
+static void *shm_map(int fd, size_t size, int map_flags) {
+  bool huge = (map_flags & SHM_MAP_HUGE) && size >= SHM_HUGE_PAGE;
+  void *map = huge ? shm_map_aligned(fd, size)
+                   : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                          0);
+  if (map == MAP_FAILED) {
+    perror("mmap");
+    exit(1);
+  }
+  // the rest are only hints, the segment works the same without them
+  if (huge) {
+    madvise(map, size, MADV_HUGEPAGE);
+  }
+  if (map_flags & SHM_MAP_PREFAULT) {
+    shm_prefault(map, size);
+  }
+  if ((map_flags & SHM_MAP_LOCK) && mlock(map, size) == -1) {
+    perror("mlock (carrying on unlocked)");
+  }
+  return map;
+}
+
+// Fill in a process's view of a mapped segment
+static struct SharedMemory *shm_view(const char *name, void *map,
+                                     size_t map_size,
+                                     const struct ShmTopology *t) {
+  struct SharedMemory *shm = calloc(1, sizeof(struct SharedMemory));
+  if (shm != NULL) {
+    shm->name = strdup(name);
+  }
+  if (shm == NULL || shm->name == NULL) {
+    perror("calloc shm");
+    exit(1);
+  }
+  shm->map = map;
+  shm->map_size = map_size;
+  shm->num_entrances = t->num_entrances;
+  shm->num_exits = t->num_exits;
+  shm->num_levels = t->num_levels;
+  shm->level_capacity = t->level_capacity;
+  shm->entrances = map;
+  shm->exits = (struct Exit *)(shm->entrances + t->num_entrances);
+  shm->levels = (struct Level *)(shm->exits + t->num_exits);
+  shm->doorbell = (Doorbell *)((char *)map + shm_doorbell_offset(t));
+  return shm;
+}
+
+struct SharedMemory *create_shm(char *name, const struct ShmTopology *topology,
+                                int map_flags) {
+  struct ShmTopology defaults = SHM_DEFAULT_TOPOLOGY;
+  if (topology == NULL) {
+    topology = &defaults;
+  }
+  if (topology->num_entrances < 1 || topology->num_exits < 1 ||
+      topology->num_levels < 1 || topology->num_levels > SHM_MAX_LEVELS ||
+      topology->level_capacity < 1) {
+    fprintf(stderr, "Invalid car park: %d entrances, %d exits, %d levels "
+                    "(at most %d) of %d cars\n",
+            topology->num_entrances, topology->num_exits,
+            topology->num_levels, SHM_MAX_LEVELS, topology->level_capacity);
+    exit(1);
+  }
   // remove if exists
   shm_unlink(name);
   // create shared memory segment with shm_open
-  // map the memory to the size of a SharedMemory struct
+  // map the memory to the size of the car park and its trailer
   // initialize the mutex and condition variables
   // return the pointer to the shared memory
   int fd = shm_open(name, O_RDWR | O_CREAT, 0666);
@@ -19,16 +147,42 @@ struct SharedMemory *create_shm(char *name) {
     perror("shm_open");
     exit(1);
   }
-  ftruncate(fd, sizeof(struct SharedMemory));
-  struct SharedMemory *shm = mmap(NULL, sizeof(struct SharedMemory),
-                                  PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  if (shm == MAP_FAILED) {
-    perror("mmap");
+  size_t size = shm_size(topology);
+  if (ftruncate(fd, size) == -1) {
+    perror("ftruncate");
     exit(1);
   }
+  void *map = shm_map(fd, size, map_flags);
+  close(fd);
+  struct SharedMemory *shm = shm_view(name, map, size, topology);
 
-  printf("Size of shared memory: %ld\n", sizeof(struct SharedMemory));
+  // say how big everything is for the processes that open it after us
+  struct ShmTrailer *trailer =
+      (struct ShmTrailer *)((char *)map + size - sizeof(struct ShmTrailer));
+  memcpy(trailer->magic, SHM_MAGIC, sizeof(trailer->magic));
+  trailer->num_entrances = topology->num_entrances;
+  trailer->num_exits = topology->num_exits;
+  trailer->num_levels = topology->num_levels;
+  trailer->level_capacity = topology->level_capacity;
+  trailer->entrance_size = sizeof(struct Entrance);
+  trailer->exit_size = sizeof(struct Exit);
+  trailer->level_size = sizeof(struct Level);
 
+  printf("Size of shared memory: %zu (%d entrances, %d exits, %d levels)\n",
+         size, shm->num_entrances, shm->num_exits, shm->num_levels);
+
+#if SHM_FUTEX
+  // the segment starts zeroed, so every LPR is empty and every sign blank
+  for (int entrance = 0; entrance < shm->num_entrances; entrance++) {
+    gate_set(&shm->entrances[entrance].gate, 'C');
+  }
+  for (int exit = 0; exit < shm->num_exits; exit++) {
+    gate_set(&shm->exits[exit].gate, 'C');
+  }
+  for (int level = 0; level < shm->num_levels; level++) {
+    shm->levels[level].temp = 25; // room temp to start with
+  }
+#else
   // Track any mutex errors (don't want to track each individually, and if one
   // fails we need to exit anyway)
   int mutex_error = 0;
@@ -49,7 +203,7 @@ struct SharedMemory *create_shm(char *name) {
   }
 
   // initialise mutexes and condition variables for the entrances
-  for (int entrance = 0; entrance < NUM_ENTRANCES; entrance++) {
+  for (int entrance = 0; entrance < shm->num_entrances; entrance++) {
     mutex_error |=
         pthread_mutex_init(&shm->entrances[entrance].lpr.mutex, &mutex_attr);
     mutex_error |=
@@ -67,7 +221,7 @@ struct SharedMemory *create_shm(char *name) {
   }
 
   // initialise mutexes and condition variables for the exits
-  for (int exit = 0; exit < NUM_EXITS; exit++) {
+  for (int exit = 0; exit < shm->num_exits; exit++) {
     mutex_error |= pthread_mutex_init(&shm->exits[exit].lpr.mutex, &mutex_attr);
     mutex_error |=
         pthread_cond_init(&shm->exits[exit].lpr.condition, &cond_attr);
@@ -79,7 +233,7 @@ struct SharedMemory *create_shm(char *name) {
   }
 
   // initialise mutexes and condition variables for the levels
-  for (int level = 0; level < NUM_LEVELS; level++) {
+  for (int level = 0; level < shm->num_levels; level++) {
     mutex_error |=
         pthread_mutex_init(&shm->levels[level].lpr.mutex, &mutex_attr);
     mutex_error |=
@@ -92,30 +246,50 @@ struct SharedMemory *create_shm(char *name) {
     exit(EXIT_FAILURE);
   }
 
+#endif
+
   return shm;
 }
 
-struct SharedMemory *get_shm(char *name) {
+struct SharedMemory *get_shm(char *name, int map_flags) {
   // open the shared memory segment with shm_open
-  // map the memory to the size of a SharedMemory struct
-  // return the pointer to the shared memory
+  // read the dimensions from the trailer at the end of it
+  // return the process's view of the shared memory
   int fd = shm_open(name, O_RDWR, 0666);
   if (fd == -1) {
     perror("shm_open");
     exit(1);
   }
-  struct SharedMemory *shm = mmap(NULL, sizeof(struct SharedMemory),
-                                  PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  if (shm == MAP_FAILED) {
-    perror("mmap");
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct ShmTrailer)) {
+    fprintf(stderr, "%s is too small to be a car park\n", name);
     exit(1);
   }
-  return shm;
+  size_t size = st.st_size;
+  void *map = shm_map(fd, size, map_flags);
+  close(fd);
+  struct ShmTrailer *trailer =
+      (struct ShmTrailer *)((char *)map + size - sizeof(struct ShmTrailer));
+  struct ShmTopology topology = {
+      (int)trailer->num_entrances, (int)trailer->num_exits,
+      (int)trailer->num_levels, (int)trailer->level_capacity};
+  // make sure it's a car park, built with the same layout as us, and all of
+  // it is there
+  if (memcmp(trailer->magic, SHM_MAGIC, sizeof(trailer->magic)) != 0 ||
+      trailer->entrance_size != sizeof(struct Entrance) ||
+      trailer->exit_size != sizeof(struct Exit) ||
+      trailer->level_size != sizeof(struct Level) ||
+      topology.num_levels > SHM_MAX_LEVELS || shm_size(&topology) != size) {
+    fprintf(stderr, "%s isn't a car park made by a compatible build\n", name);
+    exit(1);
+  }
+  return shm_view(name, map, size, &topology);
 }
 
 bool destroy_shm(struct SharedMemory *shm) {
+#if !SHM_FUTEX
   // destroy all the mutexes and condition variables
-  for (int entrance = 0; entrance < NUM_ENTRANCES; entrance++) {
+  for (int entrance = 0; entrance < shm->num_entrances; entrance++) {
     pthread_mutex_destroy(&shm->entrances[entrance].lpr.mutex);
     pthread_mutex_destroy(&shm->entrances[entrance].gate.mutex);
     pthread_mutex_destroy(&shm->entrances[entrance].sign.mutex);
@@ -123,28 +297,353 @@ bool destroy_shm(struct SharedMemory *shm) {
     pthread_cond_destroy(&shm->entrances[entrance].gate.condition);
     pthread_cond_destroy(&shm->entrances[entrance].sign.condition);
   }
-  for (int exit = 0; exit < NUM_EXITS; exit++) {
+  for (int exit = 0; exit < shm->num_exits; exit++) {
     pthread_mutex_destroy(&shm->exits[exit].lpr.mutex);
     pthread_mutex_destroy(&shm->exits[exit].gate.mutex);
     pthread_cond_destroy(&shm->exits[exit].lpr.condition);
     pthread_cond_destroy(&shm->exits[exit].gate.condition);
   }
-  for (int level = 0; level < NUM_LEVELS; level++) {
+  for (int level = 0; level < shm->num_levels; level++) {
     pthread_mutex_destroy(&shm->levels[level].lpr.mutex);
     pthread_cond_destroy(&shm->levels[level].lpr.condition);
   }
+#endif
 
   // unmap the shared memory (for completeness - will be done automatically on
   // exit)
   // close the shared memory return 0
-  if (munmap(shm, sizeof(struct SharedMemory)) == -1) {
+  int unmapped = munmap(shm->map, shm->map_size);
+  char *name = shm->name;
+  free(shm);
+  if (unmapped == -1) {
     perror("munmap");
+    free(name);
     return (1);
   }
-  int unlink = shm_unlink(SHM_NAME);
+  int unlink = shm_unlink(name);
+  free(name);
   if (unlink == -1) {
     perror("shm_unlink");
     return (0);
   }
   return 1;
-}
\ No newline at end of file
+}
+
+// Devices
+// ----------------------------------------------------
+
+// whether a gate's status is one of the chars in statuses
+static bool status_in(char status, const char *statuses) {
+  return status != '\0' && strchr(statuses, status) != NULL;
+}
+
+// stop function for lpr_poll, gives up as soon as there's no plate
+static bool stop_now(void) { return true; }
+
+bool lpr_poll(struct LPR *lpr, char plate[6], uint32_t *seq) {
+  return lpr_wait(lpr, plate, seq, stop_now);
+}
+
+#if SHM_FUTEX
+// the sign's display char and level, packed into its state word
+#define SIGN_STATE(display, level)                                           \
+  ((uint32_t)(unsigned char)(display) | (uint32_t)(level) << 8)
+#define SIGN_DISPLAY(state) ((char)((state) & 0xFF))
+#define SIGN_LEVEL(state) ((int)(FWORD_VALUE(state) >> 8))
+
+#if LPR_RING_SLOTS
+// a sequence number, they wrap around with the futex word's value
+#define LPR_SEQ(n) ((n)&FWORD_VALUE_MASK)
+
+// whether sequence number a has got to b, allowing for wrapping around
+static bool seq_reached(uint32_t a, uint32_t b) {
+  return LPR_SEQ(a - b) < (FWORD_VALUE_MASK + 1) / 2;
+}
+
+uint32_t lpr_send(struct LPR *lpr, const char plate[6]) {
+  // claim the next sequence number once its slot has been read
+  uint32_t head;
+  for (;;) {
+    uint32_t head_word = fword_load(&lpr->head);
+    uint32_t taken_word = fword_load(&lpr->taken);
+    head = FWORD_VALUE(head_word);
+    if (LPR_SEQ(head - FWORD_VALUE(taken_word)) < LPR_RING_SLOTS) {
+      if (fword_cas(&lpr->head, head_word, LPR_SEQ(head + 1))) {
+        break;
+      }
+    } else {
+      fword_wait(&lpr->taken, taken_word);
+    }
+  }
+  struct LprSlot *slot = &lpr->slots[head % LPR_RING_SLOTS];
+  memcpy(slot->plate, plate, 6);
+  fword_store(&slot->seq, LPR_SEQ(head + 1));
+  return head;
+}
+
+void lpr_wait_turn(struct LPR *lpr, uint32_t seq) {
+  for (;;) {
+    uint32_t acked = fword_load(&lpr->acked);
+    if (seq_reached(FWORD_VALUE(acked), seq)) {
+      return;
+    }
+    fword_wait(&lpr->acked, acked);
+  }
+}
+
+bool lpr_wait(struct LPR *lpr, char plate[6], uint32_t *seq,
+              shm_stop_fn stop) {
+  // only the manager reads the LPR, so nothing else moves taken
+  uint32_t taken = FWORD_VALUE(fword_load(&lpr->taken));
+  struct LprSlot *slot = &lpr->slots[taken % LPR_RING_SLOTS];
+  for (;;) {
+    uint32_t word = fword_load(&slot->seq);
+    if (FWORD_VALUE(word) == LPR_SEQ(taken + 1)) {
+      break;
+    }
+    if (stop && stop()) {
+      return false;
+    }
+    fword_wait(&slot->seq, word);
+  }
+  memcpy(plate, slot->plate, 6);
+  memcpy(lpr->plate, slot->plate, 6);
+  *seq = taken;
+  // the slot is free for another car
+  fword_store(&lpr->taken, LPR_SEQ(taken + 1));
+  return true;
+}
+
+void lpr_ack(struct LPR *lpr, uint32_t seq) {
+  fword_store(&lpr->acked, LPR_SEQ(seq + 1));
+}
+
+void lpr_read(struct LPR *lpr, char plate[6]) { memcpy(plate, lpr->plate, 6); }
+
+void lpr_wake(struct LPR *lpr) {
+  for (int i = 0; i < LPR_RING_SLOTS; i++) {
+    fword_kick(&lpr->slots[i].seq);
+  }
+  fword_kick(&lpr->taken);
+  fword_kick(&lpr->acked);
+}
+#else
+uint32_t lpr_send(struct LPR *lpr, const char plate[6]) {
+  // claim the LPR once it's empty, so no other car writes over us
+  for (;;) {
+    uint32_t state = fword_load(&lpr->state);
+    if (FWORD_VALUE(state) == LPR_EMPTY) {
+      if (fword_cas(&lpr->state, state, LPR_WRITING)) {
+        break;
+      }
+    } else {
+      fword_wait(&lpr->state, state);
+    }
+  }
+  memcpy(lpr->plate, plate, 6);
+  fword_store(&lpr->state, LPR_FULL);
+  return 0;
+}
+
+// there was only room for this plate once the one before was acknowledged
+void lpr_wait_turn(struct LPR *lpr, uint32_t seq) {
+  (void)lpr;
+  (void)seq;
+}
+
+bool lpr_wait(struct LPR *lpr, char plate[6], uint32_t *seq,
+              shm_stop_fn stop) {
+  for (;;) {
+    uint32_t state = fword_load(&lpr->state);
+    if (FWORD_VALUE(state) == LPR_FULL) {
+      memcpy(plate, lpr->plate, 6);
+      *seq = 0;
+      return true;
+    }
+    if (stop && stop()) {
+      return false;
+    }
+    fword_wait(&lpr->state, state);
+  }
+}
+
+void lpr_ack(struct LPR *lpr, uint32_t seq) {
+  (void)seq;
+  memset(lpr->plate, '\0', 6);
+  fword_store(&lpr->state, LPR_EMPTY);
+}
+
+void lpr_read(struct LPR *lpr, char plate[6]) {
+  if (FWORD_VALUE(fword_load(&lpr->state)) == LPR_FULL) {
+    memcpy(plate, lpr->plate, 6);
+  } else {
+    memset(plate, '\0', 6);
+  }
+}
+
+void lpr_wake(struct LPR *lpr) { fword_kick(&lpr->state); }
+#endif
+
+void gate_set(struct Boomgate *gate, char status) {
+  fword_store(&gate->status, (unsigned char)status);
+}
+
+char gate_get(struct Boomgate *gate) {
+  return (char)FWORD_VALUE(fword_load(&gate->status));
+}
+
+char gate_wait(struct Boomgate *gate, const char *statuses, shm_stop_fn stop) {
+  for (;;) {
+    uint32_t word = fword_load(&gate->status);
+    char status = (char)FWORD_VALUE(word);
+    if (status_in(status, statuses)) {
+      return status;
+    }
+    if (stop && stop()) {
+      return '\0';
+    }
+    fword_wait(&gate->status, word);
+  }
+}
+
+void gate_wake(struct Boomgate *gate) { fword_kick(&gate->status); }
+
+void sign_set(struct InfoSign *sign, char display, int level) {
+  fword_store(&sign->state, SIGN_STATE(display, level));
+}
+
+char sign_get(struct InfoSign *sign, int *level) {
+  uint32_t state = fword_load(&sign->state);
+  if (level) {
+    *level = SIGN_LEVEL(state);
+  }
+  return SIGN_DISPLAY(state);
+}
+
+char sign_wait(struct InfoSign *sign, int *level) {
+  for (;;) {
+    uint32_t state = fword_load(&sign->state);
+    if (SIGN_DISPLAY(state)) {
+      if (level) {
+        *level = SIGN_LEVEL(state);
+      }
+      return SIGN_DISPLAY(state);
+    }
+    fword_wait(&sign->state, state);
+  }
+}
+#else
+uint32_t lpr_send(struct LPR *lpr, const char plate[6]) {
+  pthread_mutex_lock(&lpr->mutex);
+  // wait for the lpr to be free (cleared by manager)
+  while (lpr->plate[0] != '\0') {
+    pthread_cond_wait(&lpr->condition, &lpr->mutex);
+  }
+  memcpy(lpr->plate, plate, 6);
+  pthread_cond_broadcast(&lpr->condition);
+  pthread_mutex_unlock(&lpr->mutex);
+  return 0;
+}
+
+// there was only room for this plate once the one before was acknowledged
+void lpr_wait_turn(struct LPR *lpr, uint32_t seq) {
+  (void)lpr;
+  (void)seq;
+}
+
+bool lpr_wait(struct LPR *lpr, char plate[6], uint32_t *seq,
+              shm_stop_fn stop) {
+  pthread_mutex_lock(&lpr->mutex);
+  while (lpr->plate[0] == '\0' && !(stop && stop())) {
+    pthread_cond_wait(&lpr->condition, &lpr->mutex);
+  }
+  bool sent = lpr->plate[0] != '\0';
+  if (sent) {
+    memcpy(plate, lpr->plate, 6);
+    *seq = 0;
+  }
+  pthread_mutex_unlock(&lpr->mutex);
+  return sent;
+}
+
+void lpr_ack(struct LPR *lpr, uint32_t seq) {
+  (void)seq;
+  pthread_mutex_lock(&lpr->mutex);
+  memset(lpr->plate, '\0', 6);
+  pthread_cond_broadcast(&lpr->condition);
+  pthread_mutex_unlock(&lpr->mutex);
+}
+
+void lpr_read(struct LPR *lpr, char plate[6]) {
+  pthread_mutex_lock(&lpr->mutex);
+  memcpy(plate, lpr->plate, 6);
+  pthread_mutex_unlock(&lpr->mutex);
+}
+
+void lpr_wake(struct LPR *lpr) {
+  pthread_mutex_lock(&lpr->mutex);
+  pthread_cond_broadcast(&lpr->condition);
+  pthread_mutex_unlock(&lpr->mutex);
+}
+
+void gate_set(struct Boomgate *gate, char status) {
+  pthread_mutex_lock(&gate->mutex);
+  gate->status = status;
+  pthread_cond_broadcast(&gate->condition);
+  pthread_mutex_unlock(&gate->mutex);
+}
+
+char gate_get(struct Boomgate *gate) {
+  pthread_mutex_lock(&gate->mutex);
+  char status = gate->status;
+  pthread_mutex_unlock(&gate->mutex);
+  return status;
+}
+
+char gate_wait(struct Boomgate *gate, const char *statuses, shm_stop_fn stop) {
+  pthread_mutex_lock(&gate->mutex);
+  while (!status_in(gate->status, statuses) && !(stop && stop())) {
+    pthread_cond_wait(&gate->condition, &gate->mutex);
+  }
+  char status = status_in(gate->status, statuses) ? gate->status : '\0';
+  pthread_mutex_unlock(&gate->mutex);
+  return status;
+}
+
+void gate_wake(struct Boomgate *gate) {
+  pthread_mutex_lock(&gate->mutex);
+  pthread_cond_broadcast(&gate->condition);
+  pthread_mutex_unlock(&gate->mutex);
+}
+
+void sign_set(struct InfoSign *sign, char display, int level) {
+  pthread_mutex_lock(&sign->mutex);
+  sign->display = display;
+  sign->level = level;
+  pthread_cond_broadcast(&sign->condition);
+  pthread_mutex_unlock(&sign->mutex);
+}
+
+char sign_get(struct InfoSign *sign, int *level) {
+  pthread_mutex_lock(&sign->mutex);
+  char display = sign->display;
+  if (level) {
+    *level = sign->level;
+  }
+  pthread_mutex_unlock(&sign->mutex);
+  return display;
+}
+
+char sign_wait(struct InfoSign *sign, int *level) {
+  pthread_mutex_lock(&sign->mutex);
+  while (sign->display == '\0') {
+    pthread_cond_wait(&sign->condition, &sign->mutex);
+  }
+  char display = sign->display;
+  if (level) {
+    *level = sign->level;
+  }
+  pthread_mutex_unlock(&sign->mutex);
+  return display;
+}
+#endif
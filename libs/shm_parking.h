@@ -1,29 +1,117 @@
 #pragma once
 #include "config.h"
+#include "doorbell.h"
+#include "futex.h"
 #include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#define SHM_CACHE_LINE 64
+
+// With SHM_CACHE_ALIGNED every device starts on a cache line of its own and
+// nothing else shares its last line, so locking one device never pulls a
+// neighbouring device's line away from another thread (or process)
+#if SHM_CACHE_ALIGNED
+#define SHM_DEVICE __attribute__((aligned(SHM_CACHE_LINE)))
+#else
+#define SHM_DEVICE
+#endif
+
+#if LPR_RING_SLOTS && !SHM_FUTEX
+#error "LPR_RING_SLOTS needs SHM_FUTEX"
+#endif
+#if LPR_RING_SLOTS & (LPR_RING_SLOTS - 1)
+#error "LPR_RING_SLOTS must be a power of two"
+#endif
+
+// Whether plates queue up at the LPRs (LPR_RING_SLOTS), so the manager can
+// acknowledge one as soon as it's handled it
+#define LPR_PIPELINED (LPR_RING_SLOTS > 0)
+
+#if SHM_FUTEX
+// Each device is one futex word, only touched through the functions below
+
+#if LPR_RING_SLOTS
+// A plate in an LPR's ring
+struct LprSlot {
+  // sequence number of the plate in the slot + 1 (mod FWORD_VALUE_MASK + 1)
+  // once it's written, so the manager can tell it from the last time around
+  FutexWord seq;
+  char plate[6];
+  char padding[2];
+};
+
+// Sequence numbers count every plate sent to the LPR, they wrap around at
+// FWORD_VALUE_MASK
+struct LPR {
+  FutexWord head;  // plates claimed by cars
+  FutexWord taken; // plates read by the manager, their slots can be reused
+  FutexWord acked; // plates the manager has finished with
+  char plate[6];   // last plate the manager read, for displays
+  char padding[2];
+  struct LprSlot slots[LPR_RING_SLOTS];
+} SHM_DEVICE;
+#else
+// what an LPR's state word can be
+#define LPR_EMPTY 0
+#define LPR_WRITING 1 // a car has claimed it and is writing its plate
+#define LPR_FULL 2
+
+struct LPR {
+  FutexWord state; // LPR_EMPTY, LPR_WRITING or LPR_FULL
+  char plate[6];   // include 6 chars as per spec (no null-terminator)
+  char padding[2];
+} SHM_DEVICE;
+#endif
+
+struct Boomgate {
+  FutexWord status; // the status char
+} SHM_DEVICE;
+
+struct InfoSign {
+  FutexWord state; // display char in the low byte, level above it
+} SHM_DEVICE;
+#else
 struct LPR {
   pthread_mutex_t mutex;
   pthread_cond_t condition;
   char plate[6]; // include 6 chars as per spec (no null-terminator)
   char padding[2];
-};
+} SHM_DEVICE;
 
 struct Boomgate {
   pthread_mutex_t mutex;
   pthread_cond_t condition;
   char status;
   char padding[7];
-};
+} SHM_DEVICE;
 
 struct InfoSign {
   pthread_mutex_t mutex;
   pthread_cond_t condition;
   char display;
-  char padding[7];
-};
+  char padding;
+  // level the sign is sending a car to (1-indexed, 0 for none). The display
+  // only has room for levels 1-9, past that it shows SIGN_LEVEL_BEYOND_9
+  uint16_t level;
+  char padding2[4];
+} SHM_DEVICE;
+#endif
+
+// shown on a sign for a level it can't fit
+#define SIGN_LEVEL_BEYOND_9 '*'
+
+// What an entrance sign displays for level (0-indexed)
+static inline char sign_level_char(int level) {
+  return level < 9 ? (char)('1' + level) : SIGN_LEVEL_BEYOND_9;
+}
+
+// Whether an entrance sign's display is sending a car to a level (rather than
+// turning it away or evacuating), the level is then in sign.level
+static inline bool sign_shows_level(char display) {
+  return (display >= '1' && display <= '9') || display == SIGN_LEVEL_BEYOND_9;
+}
 
 // An entrance
 struct Entrance {
@@ -39,19 +127,185 @@ struct Exit {
 
 struct Level {
   struct LPR lpr;
-  volatile int16_t temp;
+  // written by the temperature sensor and fire alarm, not under the LPR lock
+  volatile int16_t temp SHM_DEVICE;
   volatile int8_t alarm;
   char padding[5];
+} SHM_DEVICE;
+
+// Dimensions of a car park
+struct ShmTopology {
+  int num_entrances;
+  int num_exits;
+  int num_levels;
+  int level_capacity;
+};
+
+// the car park from src/config.h
+#define SHM_DEFAULT_TOPOLOGY                                                 \
+  { NUM_ENTRANCES, NUM_EXITS, NUM_LEVELS, LEVEL_CAPACITY }
+// most levels a car park can have (the manager keeps levels in an int8_t)
+#define SHM_MAX_LEVELS 127
+
+// How a process maps the shared memory (create_shm/get_shm), or'd together
+// touch every page when it's mapped, so the first event on a device doesn't
+// take a page fault
+#define SHM_MAP_PREFAULT 0x1
+// mlock the segment so its pages stay mapped (carries on unlocked if
+// RLIMIT_MEMLOCK is too small)
+#define SHM_MAP_LOCK 0x2
+// ask for huge pages (madvise) once the segment is at least SHM_HUGE_PAGE,
+// mapped at a huge page boundary. Only takes if the kernel backs shared memory
+// with them (/sys/kernel/mm/transparent_hugepage/shmem_enabled)
+#define SHM_MAP_HUGE 0x4
+#define SHM_MAP_ALL (SHM_MAP_PREFAULT | SHM_MAP_LOCK | SHM_MAP_HUGE)
+// size of a (PMD) huge page
+#define SHM_HUGE_PAGE (2 * 1024 * 1024)
+
+// The shared memory segment is every entrance, then every exit, then every
+// level, then a doorbell for the LPRs (on a cache line of its own), then this
+// trailer saying how many of each there are. Keeping the rest after the
+// devices leaves them where the spec has them, so a car park with the
+// config.h dimensions has its devices laid out exactly like the spec's.
+struct ShmTrailer {
+  char magic[8];
+  uint32_t num_entrances;
+  uint32_t num_exits;
+  uint32_t num_levels;
+  uint32_t level_capacity;
+  // sizes of the structs the creator was built with, a process built with a
+  // different layout (e.g. SHM_CACHE_ALIGNED) can't use the segment
+  uint32_t entrance_size;
+  uint32_t exit_size;
+  uint32_t level_size;
+  uint32_t padding;
 };
 
+// Bells on the doorbell, entrances' LPRs then levels' then exits'
+#define SHM_BELL_ENTRANCE(shm, i) (i)
+#define SHM_BELL_LEVEL(shm, i) ((shm)->num_entrances + (i))
+#define SHM_BELL_EXIT(shm, i) ((shm)->num_entrances + (shm)->num_levels + (i))
+#define SHM_BELLS(shm)                                                       \
+  ((shm)->num_entrances + (shm)->num_levels + (shm)->num_exits)
+
+// A process's view of the shared memory, the arrays point into the segment
+// and are sized by the process that created it
 struct SharedMemory {
-  struct Entrance entrances[NUM_ENTRANCES];
-  struct Exit exits[NUM_EXITS];
-  struct Level levels[NUM_LEVELS];
+  struct Entrance *entrances;
+  struct Exit *exits;
+  struct Level *levels;
+  int num_entrances;
+  int num_exits;
+  int num_levels;
+  int level_capacity;
+  // a bell per LPR, rung by the simulator whenever it sends a plate (see
+  // SHM_BELL_*)
+  Doorbell *doorbell;
+  // the whole mapped segment, and the name it was opened with
+  void *map;
+  size_t map_size;
+  char *name;
 };
 
-struct SharedMemory *create_shm(char *name);
+#if SHM_CACHE_ALIGNED
+_Static_assert(sizeof(struct LPR) % SHM_CACHE_LINE == 0 &&
+                   sizeof(struct Boomgate) % SHM_CACHE_LINE == 0 &&
+                   sizeof(struct InfoSign) % SHM_CACHE_LINE == 0,
+               "devices must fill whole cache lines");
+_Static_assert(offsetof(struct Entrance, gate) % SHM_CACHE_LINE == 0 &&
+                   offsetof(struct Entrance, sign) % SHM_CACHE_LINE == 0 &&
+                   offsetof(struct Exit, gate) % SHM_CACHE_LINE == 0 &&
+                   offsetof(struct Level, temp) % SHM_CACHE_LINE == 0,
+               "every device must start on its own cache line");
+_Static_assert(sizeof(struct Entrance) % SHM_CACHE_LINE == 0 &&
+                   sizeof(struct Exit) % SHM_CACHE_LINE == 0 &&
+                   sizeof(struct Level) % SHM_CACHE_LINE == 0,
+               "neighbouring entrances, exits and levels must not share a "
+               "cache line");
+#elif SHM_FUTEX
+#if !LPR_RING_SLOTS
+_Static_assert(sizeof(struct Entrance) == 32 && sizeof(struct Exit) == 24 &&
+                   sizeof(struct Level) == 24,
+               "futex devices should be a word or two each");
+#endif
+#else
+// the layout other processes expect from the spec
+_Static_assert(sizeof(struct Entrance) == 288 && sizeof(struct Exit) == 192 &&
+                   sizeof(struct Level) == 104,
+               "shared memory must match the spec's layout");
+#endif
+
+// Devices
+// These work the same with either SHM_FUTEX layout, every process uses them
+// instead of touching a device's fields
+// A stop function is checked whenever a wait is woken up, the wait gives up if
+// it returns true. Wake the waiters (lpr_wake, gate_wake) after making it true
+typedef bool (*shm_stop_fn)(void);
+
+// Put plate on the LPR, once there's room for it (the manager has read the
+// plate before, or enough of the ring). Returns its sequence number
+uint32_t lpr_send(struct LPR *lpr, const char plate[6]);
+
+// Wait until the manager has acknowledged every plate sent to the LPR before
+// seq (from lpr_send), so the sign and gate are answering this one
+void lpr_wait_turn(struct LPR *lpr, uint32_t seq);
+
+// Wait for the next plate at the LPR and copy it into plate, and its sequence
+// number into seq
+// return false if stop (may be NULL) said to give up first
+bool lpr_wait(struct LPR *lpr, char plate[6], uint32_t *seq,
+              shm_stop_fn stop);
+
+// lpr_wait without waiting
+// return false if there isn't a plate at the LPR
+bool lpr_poll(struct LPR *lpr, char plate[6], uint32_t *seq);
+
+// Finish with plate seq (from lpr_wait), so the next one can be read. Without
+// a ring this empties the LPR for the next car
+void lpr_ack(struct LPR *lpr, uint32_t seq);
+
+// Copy whatever plate is on the LPR without waiting, all '\0' if empty (the
+// last one read with a ring)
+void lpr_read(struct LPR *lpr, char plate[6]);
+
+// Wake everything waiting on the LPR, so it checks its stop function
+void lpr_wake(struct LPR *lpr);
+
+// Set the gate's status
+void gate_set(struct Boomgate *gate, char status);
+
+// The gate's status right now
+char gate_get(struct Boomgate *gate);
+
+// Wait for the gate's status to be one of the chars in statuses and return it
+// return '\0' if stop (may be NULL) said to give up first
+char gate_wait(struct Boomgate *gate, const char *statuses, shm_stop_fn stop);
+
+// Wake everything waiting on the gate, so it checks its stop function
+void gate_wake(struct Boomgate *gate);
+
+// Show display on the sign, sending cars to level (1-indexed, 0 for none)
+void sign_set(struct InfoSign *sign, char display, int level);
+
+// What the sign is showing right now, and its level if level isn't NULL
+char sign_get(struct InfoSign *sign, int *level);
+
+// Wait for the sign to show something and return it (and its level if level
+// isn't NULL)
+char sign_wait(struct InfoSign *sign, int *level);
+
+// Create (replacing any old one) and initialise the shared memory for a car
+// park of the given dimensions, NULL for the ones in config.h, mapped as
+// map_flags (SHM_MAP_*) asks
+// exits if it couldn't be created or the dimensions are invalid
+struct SharedMemory *create_shm(char *name, const struct ShmTopology *topology,
+                                int map_flags);
 
-struct SharedMemory *get_shm(char *name);
+// Map the shared memory another process created, with its dimensions, as
+// map_flags (SHM_MAP_*) asks
+// exits if it doesn't exist or wasn't made by a compatible build
+struct SharedMemory *get_shm(char *name, int map_flags);
 
+// Destroy the mutexes and condition variables, unmap and unlink the shared
+// memory
 bool destroy_shm(struct SharedMemory *shm);
@@ -2,7 +2,20 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
+
+// create an empty linked list of plates
+static NumberPlates *list_create(pthread_mutex_t *rand_mutex) {
+  NumberPlates *plates = malloc(sizeof(NumberPlates));
+  if (!plates) {
+    perror("Error allocating memory for plates");
+    exit(EXIT_FAILURE);
+  }
+  plates->rand_mutex = rand_mutex;
+  pthread_mutex_init(&plates->mutex, NULL);
+  plates->count = 0;
+  plates->head = NULL;
+  return plates;
+}
 
 // read number plates from a file called "plates.txt"
 // store them in a linked list
@@ -17,20 +30,11 @@ NumberPlates *list_from_file(char *FILENAME, pthread_mutex_t *rand_mutex) {
   size_t linecap = 0;
   ssize_t linelen;
   // create the linked list
-  NumberPlates *plates = malloc(sizeof(NumberPlates));
-  if (!plates) {
-    perror("Error allocating memory for plates");
-    exit(EXIT_FAILURE);
-  }
-  plates->rand_mutex = rand_mutex;
-  pthread_mutex_init(&plates->mutex, NULL);
-  plates->count = 0;
-  plates->head = NULL;
+  NumberPlates *plates = list_create(rand_mutex);
   // add the plates to the list
-  while ((linelen = getline(&line, &linecap, fp)) > 0) {
-    line[6] = '\0'; // null-terminate the plate if not already
+  while ((linelen = getline(&line, &linecap, fp)) >= PLATE_LEN) {
     // add the plate to the list
-    if (!add_plate(plates, line)) {
+    if (!add_plate(plates, plate_encode(line))) {
       printf("Couldn't add plate %s", line);
     }
   }
@@ -39,14 +43,21 @@ NumberPlates *list_from_file(char *FILENAME, pthread_mutex_t *rand_mutex) {
   return plates;
 }
 
-int add_plate(NumberPlates *plates, char *platestr) {
+NumberPlates *list_from_whitelist(wl_t *wl, pthread_mutex_t *rand_mutex) {
+  NumberPlates *plates = list_create(rand_mutex);
+  for (size_t i = 0; i < wl_size(wl); i++) {
+    add_plate(plates, wl_plate(wl, i));
+  }
+  return plates;
+}
+
+int add_plate(NumberPlates *plates, plate_t platenum) {
   Plate *plate = calloc(1, sizeof(Plate));
   if (plate == NULL) {
     perror("Error allocating memory for plate");
     exit(EXIT_FAILURE);
   }
-  // copy number into plate struct until null terminator or 7 characters
-  memccpy(plate->plate, platestr, 0, 7);
+  plate->plate = platenum;
   pthread_mutex_lock(&plates->mutex);
   plate->next = plates->head;
   plates->head = plate;
@@ -57,12 +68,8 @@ int add_plate(NumberPlates *plates, char *platestr) {
 
 // generate a car with a random number plate
 // 50% of the time will be within the hashtable
-char *random_available_plate(NumberPlates *plates) {
-  char *plate = calloc(7, sizeof(char));
-  if (!plate) {
-    perror("Error allocating memory for plate");
-    exit(EXIT_FAILURE);
-  }
+plate_t random_available_plate(NumberPlates *plates) {
+  plate_t plate = PLATE_NONE;
   pthread_mutex_lock(plates->rand_mutex); // ensure access to rand
   int allowed = rand() % 2;
   pthread_mutex_unlock(plates->rand_mutex);
@@ -93,18 +100,19 @@ char *random_available_plate(NumberPlates *plates) {
     plates->count -= 1;
 
     // set the plate
-    memccpy(plate, plate_node->plate, 0, 7);
+    plate = plate_node->plate;
     // free the deleted plate
     free(plate_node);
   } else {
     // generate random licence plate
-    for (int j = 0; j < 6; j++) {
+    for (int j = 0; j < PLATE_LEN; j++) {
+      char c;
       if (j < 3)
-        plate[j] = ("ABCDEFGHIJKLMNOPQRSTUVWXYZ"[rand() % 26]);
+        c = ("ABCDEFGHIJKLMNOPQRSTUVWXYZ"[rand() % 26]);
       else
-        plate[j] = "0123456789"[(rand() % 10)];
+        c = "0123456789"[(rand() % 10)];
+      plate = (plate << 8) | (unsigned char)c;
     }
-    plate[6] = '\0';
   }
   pthread_mutex_unlock(&plates->mutex); // unlock plates mutex
   return plate;
@@ -1,9 +1,11 @@
 #pragma once
+#include "plate.h"
+#include "whitelist.h"
 #include <pthread.h>
 
 // Node in a linked list of number plates
 typedef struct Plate {
-  char plate[7]; // null-terminated plates
+  plate_t plate;
   struct Plate *next;
 } Plate;
 
@@ -16,11 +18,15 @@ typedef struct NumberPlates {
   Plate *head;
 } NumberPlates;
 
-int add_plate(NumberPlates *plates, char *platestr);
+int add_plate(NumberPlates *plates, plate_t plate);
 
 NumberPlates *list_from_file(char *FILENAME, pthread_mutex_t *rand_mutex);
 
-char *random_available_plate(NumberPlates *plates);
+// same as list_from_file but with the plates of a compiled whitelist, which
+// doesn't need parsing
+NumberPlates *list_from_whitelist(wl_t *wl, pthread_mutex_t *rand_mutex);
+
+plate_t random_available_plate(NumberPlates *plates);
 
 int clear_plates(NumberPlates *plates);
 
@@ -0,0 +1,170 @@
+#include "striped_table.h"
+#include "plate_table.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Size of a cache line, stripes are padded to this so two stripes' locks are
+// never on the same line
+#define CACHE_LINE 64
+
+struct sptab_stripe {
+  pthread_mutex_t mutex; // held by writers
+  ptab_t *table;
+  unsigned int seq; // odd while a writer is changing the table
+} __attribute__((aligned(CACHE_LINE)));
+
+typedef struct sptab {
+  struct sptab_stripe *stripes;
+  // number of stripes, a power of 2
+  size_t num_stripes;
+  size_t value_size;
+} sptab_t;
+
+// Pick the stripe from the top bits of the hash, the plate tables inside
+// each stripe index with the bottom bits
+static struct sptab_stripe *sptab_stripe(sptab_t *t, plate_t plate) {
+  uint64_t hash = plate * 0x9E3779B97F4A7C15ULL;
+  return &t->stripes[(hash >> 40) & (t->num_stripes - 1)];
+}
+
+// Lock the stripe and mark it as being written
+static void sptab_write_begin(struct sptab_stripe *stripe) {
+  pthread_mutex_lock(&stripe->mutex);
+  __atomic_store_n(&stripe->seq, stripe->seq + 1, __ATOMIC_RELAXED);
+  // the odd seq must be visible before any of the writes to the table
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+// Publish the writes and unlock the stripe
+static void sptab_write_end(struct sptab_stripe *stripe) {
+  __atomic_store_n(&stripe->seq, stripe->seq + 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&stripe->mutex);
+}
+
+sptab_t *sptab_create(size_t n, size_t value_size, size_t stripes) {
+  sptab_t *t = calloc(1, sizeof(sptab_t));
+  if (!t) {
+    return NULL;
+  }
+  t->value_size = value_size;
+  t->num_stripes = 1;
+  while (t->num_stripes < stripes) {
+    t->num_stripes <<= 1;
+  }
+  if (posix_memalign((void **)&t->stripes, CACHE_LINE,
+                     t->num_stripes * sizeof(struct sptab_stripe)) != 0) {
+    free(t);
+    return NULL;
+  }
+  for (size_t i = 0; i < t->num_stripes; i++) {
+    struct sptab_stripe *stripe = &t->stripes[i];
+    pthread_mutex_init(&stripe->mutex, NULL);
+    stripe->seq = 0;
+    // plates are spread evenly so each stripe gets its share
+    stripe->table = ptab_create_shared(n / t->num_stripes + 1, value_size);
+    if (!stripe->table) {
+      t->num_stripes = i;
+      sptab_destroy(t);
+      return NULL;
+    }
+  }
+  return t;
+}
+
+void sptab_destroy(sptab_t *t) {
+  for (size_t i = 0; i < t->num_stripes; i++) {
+    pthread_mutex_destroy(&t->stripes[i].mutex);
+    ptab_destroy(t->stripes[i].table);
+  }
+  free(t->stripes);
+  free(t);
+}
+
+bool sptab_get(sptab_t *t, plate_t plate, void *value) {
+  struct sptab_stripe *stripe = sptab_stripe(t, plate);
+  // copy into a buffer so a torn read never reaches the caller
+  char copy[t->value_size];
+  unsigned int start;
+  bool found;
+  while (1) {
+    start = __atomic_load_n(&stripe->seq, __ATOMIC_ACQUIRE);
+    if (start & 1) {
+      // a writer is in the middle of it, let it finish
+      sched_yield();
+      continue;
+    }
+    found = ptab_read_racy(stripe->table, plate, copy);
+    // the reads above must happen before checking seq again
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&stripe->seq, __ATOMIC_RELAXED) == start) {
+      break;
+    }
+  }
+  if (found) {
+    memcpy(value, copy, t->value_size);
+  }
+  return found;
+}
+
+bool sptab_set(sptab_t *t, plate_t plate, const void *value) {
+  struct sptab_stripe *stripe = sptab_stripe(t, plate);
+  sptab_write_begin(stripe);
+  bool success = ptab_set(stripe->table, plate, value);
+  sptab_write_end(stripe);
+  return success;
+}
+
+bool sptab_remove(sptab_t *t, plate_t plate) {
+  struct sptab_stripe *stripe = sptab_stripe(t, plate);
+  sptab_write_begin(stripe);
+  bool success = ptab_remove(stripe->table, plate);
+  sptab_write_end(stripe);
+  return success;
+}
+
+bool sptab_update(sptab_t *t, plate_t plate, sptab_update_fn fn, void *arg,
+                  void *result) {
+  struct sptab_stripe *stripe = sptab_stripe(t, plate);
+  sptab_write_begin(stripe);
+  void *value = ptab_get(stripe->table, plate);
+  if (value) {
+    fn(value, arg);
+    if (result) {
+      memcpy(result, value, t->value_size);
+    }
+  }
+  sptab_write_end(stripe);
+  return value != NULL;
+}
+
+bool sptab_upsert(sptab_t *t, plate_t plate, const void *init,
+                  sptab_update_fn fn, void *arg, void *result) {
+  struct sptab_stripe *stripe = sptab_stripe(t, plate);
+  sptab_write_begin(stripe);
+  void *value = ptab_get(stripe->table, plate);
+  if (!value && ptab_set(stripe->table, plate, init)) {
+    value = ptab_get(stripe->table, plate);
+  }
+  if (value) {
+    fn(value, arg);
+    if (result) {
+      memcpy(result, value, t->value_size);
+    }
+  }
+  sptab_write_end(stripe);
+  return value != NULL;
+}
+
+size_t sptab_size(sptab_t *t) {
+  size_t size = 0;
+  for (size_t i = 0; i < t->num_stripes; i++) {
+    pthread_mutex_lock(&t->stripes[i].mutex);
+    size += ptab_size(t->stripes[i].table);
+    pthread_mutex_unlock(&t->stripes[i].mutex);
+  }
+  return size;
+}
+
+size_t sptab_stripes(sptab_t *t) { return t->num_stripes; }
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "plate.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// A thread-safe plate table split into lock stripes
+// Each stripe is its own plate table (ptab_t) with its own mutex, and a plate
+// always lives in the stripe picked by its hash. Threads working on plates in
+// different stripes never wait on each other.
+//
+// Values are copied in and out, so callers never hold a pointer into the
+// table. Writers take the stripe lock, readers take no lock at all: each
+// stripe is also a seqlock and a read that overlapped a write just retries.
+typedef struct sptab sptab_t;
+
+// Callback for sptab_update, called with the stripe locked and a pointer to
+// the plate's value which it may modify in place
+typedef void (*sptab_update_fn)(void *value, void *arg);
+
+// Create a table with room for at least n plates with values of value_size
+// bytes each, spread across (at least) the given number of stripes.
+// Returns NULL if the memory couldn't be allocated
+sptab_t *sptab_create(size_t n, size_t value_size, size_t stripes);
+
+// Destroy and free memory allocated for the table
+void sptab_destroy(sptab_t *t);
+
+// Copy the value stored for plate into value, without locking
+// return false if the plate is not in the table
+bool sptab_get(sptab_t *t, plate_t plate, void *value);
+
+// Add a plate to the table OR update its value if it already exists
+bool sptab_set(sptab_t *t, plate_t plate, const void *value);
+
+// Remove a plate from the table
+// return false if the plate was not in the table
+bool sptab_remove(sptab_t *t, plate_t plate);
+
+// Atomically read-modify-write the value for plate: fn is called with the
+// stripe locked. If result is not NULL the updated value is copied into it.
+// return false (without calling fn) if the plate is not in the table
+bool sptab_update(sptab_t *t, plate_t plate, sptab_update_fn fn, void *arg,
+                  void *result);
+
+// Like sptab_update, but if the plate is not in the table it is first added
+// with a copy of init, all under the same lock
+// return false if the plate couldn't be added
+bool sptab_upsert(sptab_t *t, plate_t plate, const void *init,
+                  sptab_update_fn fn, void *arg, void *result);
+
+// number of plates (a snapshot, other threads may be adding or removing)
+size_t sptab_size(sptab_t *t);
+
+// number of stripes
+size_t sptab_stripes(sptab_t *t);
@@ -0,0 +1,228 @@
+#include "whitelist.h"
+#include "bloom.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Identifies a whitelist image (and the version of its layout)
+#define WL_MAGIC "PLATEWL2"
+// Table slots per plate, lookups stay short at this load
+#define WL_SLOTS_PER_PLATE 2
+// smallest number of slots an image will have
+#define WL_MIN_CAPACITY 8
+
+// Start of every image, followed by the filter's words, then capacity slots
+// (PLATE_NONE if empty) and then the count plates in file order
+struct wl_header {
+  char magic[8];
+  uint64_t count;
+  // number of slots, always a power of 2 so we can mask instead of mod
+  uint64_t capacity;
+  // words in the Bloom filter, 0 if the image has no filter
+  uint64_t filter_words;
+  // pad to a cache line so the filter starts on one
+  char pad[32];
+};
+
+typedef struct wl {
+  // the whole mapped image
+  void *map;
+  size_t map_size;
+  const uint64_t *filter;
+  size_t filter_words;
+  const plate_t *slots;
+  const plate_t *plates;
+  size_t count;
+  size_t capacity;
+} wl_t;
+
+// find the slot holding plate, or the empty slot it would go in
+static size_t wl_probe(const plate_t *slots, size_t capacity, plate_t plate) {
+  size_t mask = capacity - 1;
+  size_t i = plate_hash(plate) & mask;
+  while (slots[i] != PLATE_NONE && !plate_eq(slots[i], plate)) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+// Read every plate in a text file into a malloc'd array
+// return NULL if the file couldn't be read
+static plate_t *wl_read_text(const char *text_path, size_t *count) {
+  FILE *fp = fopen(text_path, "r");
+  if (fp == NULL) {
+    return NULL;
+  }
+  size_t cap = 64;
+  plate_t *plates = malloc(cap * sizeof(plate_t));
+  if (!plates) {
+    fclose(fp);
+    return NULL;
+  }
+  *count = 0;
+  char *line = NULL;
+  size_t linecap = 0;
+  while (getline(&line, &linecap, fp) >= PLATE_LEN) {
+    if (*count == cap) {
+      cap *= 2;
+      plate_t *bigger = realloc(plates, cap * sizeof(plate_t));
+      if (!bigger) {
+        free(plates);
+        plates = NULL;
+        break;
+      }
+      plates = bigger;
+    }
+    plates[(*count)++] = plate_encode(line);
+  }
+  free(line);
+  fclose(fp);
+  return plates;
+}
+
+bool wl_compile(const char *text_path, const char *image_path,
+                size_t filter_bits) {
+  size_t num_lines;
+  plate_t *plates = wl_read_text(text_path, &num_lines);
+  if (!plates) {
+    return false;
+  }
+  struct wl_header header = {0};
+  memcpy(header.magic, WL_MAGIC, sizeof(header.magic));
+  header.capacity = WL_MIN_CAPACITY;
+  while (header.capacity < num_lines * WL_SLOTS_PER_PLATE) {
+    header.capacity <<= 1;
+  }
+  plate_t *slots = calloc(header.capacity, sizeof(plate_t));
+  header.filter_words = bloom_words(num_lines, filter_bits);
+  // (+1 so there is something to free with no filter)
+  uint64_t *filter = calloc(header.filter_words + 1, sizeof(uint64_t));
+  if (!slots || !filter) {
+    free(slots);
+    free(filter);
+    free(plates);
+    return false;
+  }
+  // fill the table, dropping repeats (and empty lines) from the plate list
+  header.count = 0;
+  for (size_t i = 0; i < num_lines; i++) {
+    if (plates[i] == PLATE_NONE) {
+      continue;
+    }
+    size_t slot = wl_probe(slots, header.capacity, plates[i]);
+    if (slots[slot] == PLATE_NONE) {
+      slots[slot] = plates[i];
+      plates[header.count++] = plates[i];
+      bloom_add(filter, header.filter_words, plates[i]);
+    }
+  }
+
+  // write it somewhere else first, then swap it in all at once
+  char tmp_path[strlen(image_path) + 32];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp%d", image_path, (int)getpid());
+  FILE *fp = fopen(tmp_path, "wb");
+  bool written = fp != NULL &&
+                 fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                 fwrite(filter, sizeof(uint64_t), header.filter_words, fp) ==
+                     header.filter_words &&
+                 fwrite(slots, sizeof(plate_t), header.capacity, fp) ==
+                     header.capacity &&
+                 fwrite(plates, sizeof(plate_t), header.count, fp) ==
+                     header.count;
+  if (fp != NULL && fclose(fp) != 0) {
+    written = false;
+  }
+  free(filter);
+  free(slots);
+  free(plates);
+  if (!written || rename(tmp_path, image_path) != 0) {
+    unlink(tmp_path);
+    return false;
+  }
+  return true;
+}
+
+wl_t *wl_open(const char *image_path) {
+  int fd = open(image_path, O_RDONLY);
+  if (fd == -1) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct wl_header)) {
+    close(fd);
+    return NULL;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping keeps the file open
+  close(fd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+  const struct wl_header *header = map;
+  // make sure it's an image, and all of it is there
+  bool valid =
+      memcmp(header->magic, WL_MAGIC, sizeof(header->magic)) == 0 &&
+      header->capacity >= WL_MIN_CAPACITY &&
+      (header->capacity & (header->capacity - 1)) == 0 &&
+      header->count < header->capacity &&
+      (header->filter_words & (header->filter_words - 1)) == 0 &&
+      (size_t)st.st_size ==
+          sizeof(struct wl_header) +
+              header->filter_words * sizeof(uint64_t) +
+              (header->capacity + header->count) * sizeof(plate_t);
+  wl_t *wl = valid ? calloc(1, sizeof(wl_t)) : NULL;
+  if (!wl) {
+    munmap(map, st.st_size);
+    return NULL;
+  }
+  wl->map = map;
+  wl->map_size = st.st_size;
+  wl->capacity = header->capacity;
+  wl->count = header->count;
+  wl->filter_words = header->filter_words;
+  wl->filter = (const uint64_t *)(header + 1);
+  wl->slots = (const plate_t *)(wl->filter + wl->filter_words);
+  wl->plates = wl->slots + wl->capacity;
+  return wl;
+}
+
+wl_t *wl_load(const char *text_path, const char *image_path) {
+  struct stat text_st, image_st;
+  bool stale = stat(image_path, &image_st) == -1;
+  if (!stale && stat(text_path, &text_st) == 0) {
+    stale = text_st.st_mtim.tv_sec > image_st.st_mtim.tv_sec ||
+            (text_st.st_mtim.tv_sec == image_st.st_mtim.tv_sec &&
+             text_st.st_mtim.tv_nsec > image_st.st_mtim.tv_nsec);
+  }
+  if (stale && !wl_compile(text_path, image_path, WL_FILTER_BITS)) {
+    return NULL;
+  }
+  return wl_open(image_path);
+}
+
+void wl_close(wl_t *wl) {
+  munmap(wl->map, wl->map_size);
+  free(wl);
+}
+
+bool wl_maybe_contains(wl_t *wl, plate_t plate) {
+  return bloom_maybe_contains(wl->filter, wl->filter_words, plate);
+}
+
+bool wl_contains(wl_t *wl, plate_t plate) {
+  if (plate == PLATE_NONE) {
+    return false;
+  }
+  return wl->slots[wl_probe(wl->slots, wl->capacity, plate)] != PLATE_NONE;
+}
+
+size_t wl_size(wl_t *wl) { return wl->count; }
+
+plate_t wl_plate(wl_t *wl, size_t i) {
+  return i < wl->count ? wl->plates[i] : PLATE_NONE;
+}
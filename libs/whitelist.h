@@ -0,0 +1,56 @@
+#pragma once
+
+#include "plate.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// A read-only set of allowed number plates, compiled from plates.txt into a
+// binary image that is mmap'd straight into memory. Opening it doesn't read
+// or parse anything, the pages are only loaded when a lookup touches them and
+// are shared by every process that has the same image open.
+//
+// The image holds a header, a Bloom filter of the plates (to turn away plates
+// that aren't on the list without touching the table), an open-addressing
+// table of plates (for lookups) and the plates in file order (for picking
+// plates out of it).
+//
+// Thread-safe, nothing in it ever changes once opened
+typedef struct wl wl_t;
+
+// Bloom filter bits per plate wl_load compiles with, see bloom.h for how many
+// plates that aren't on the list get past the filter to the table
+#define WL_FILTER_BITS 10
+
+// Compile a file of plates (one per line) into an image at image_path, with a
+// Bloom filter of filter_bits bits per plate (0 for no filter)
+// The image is written next to image_path and renamed into place, so a
+// process opening it never sees half an image.
+// return false if either file couldn't be read or written
+bool wl_compile(const char *text_path, const char *image_path,
+                size_t filter_bits);
+
+// Map a compiled image read-only
+// return NULL if it couldn't be opened or isn't a valid image
+wl_t *wl_open(const char *image_path);
+
+// Open image_path, first (re)compiling it from text_path if the image is
+// missing or older than the text file
+// return NULL if it couldn't be compiled or opened
+wl_t *wl_load(const char *text_path, const char *image_path);
+
+// Unmap the image
+void wl_close(wl_t *wl);
+
+// Check just the Bloom filter, never touches the table
+// false means plate is definitely not on the whitelist, true means it might be
+// (always true if the image has no filter)
+bool wl_maybe_contains(wl_t *wl, plate_t plate);
+
+// Whether plate is on the whitelist
+bool wl_contains(wl_t *wl, plate_t plate);
+
+// number of plates on the whitelist
+size_t wl_size(wl_t *wl);
+
+// the ith plate on the whitelist, in the order they were in the text file
+plate_t wl_plate(wl_t *wl, size_t i);
@@ -15,3 +15,47 @@
 #define MAX_PARK_TIME 1000
 // how much to charge customers per milisecond ($)
 #define COST_PER_MS 0.05
+// 1 to give every device in shared memory (each LPR, boomgate, sign and level
+// temperature) its own cache lines, 0 for the packed layout from the spec
+// every process has to agree, e.g. `make clean all OPT=-DSHM_CACHE_ALIGNED=1`
+#ifndef SHM_CACHE_ALIGNED
+#define SHM_CACHE_ALIGNED 0
+#endif
+// 1 for devices that are a futex word each instead of a mutex and condition
+// variable, a much smaller segment where a gate or sign change is one atomic
+// store. Every process has to agree, like SHM_CACHE_ALIGNED
+#ifndef SHM_FUTEX
+#define SHM_FUTEX 0
+#endif
+// slots in each LPR's ring of plates, 0 for the spec's one plate per LPR. With
+// a ring, cars don't wait for the manager to finish with the plate before
+// theirs, and the manager acknowledges plates by sequence number instead of
+// clearing them. A power of two, needs SHM_FUTEX, and every process has to agree
+#ifndef LPR_RING_SLOTS
+#define LPR_RING_SLOTS 0
+#endif
+// how each process maps the shared memory, SHM_MAP_* flags from
+// libs/shm_parking.h or'd together, 0 to fault pages in as they're first used.
+// Unlike the layout the processes don't have to agree, e.g.
+// `make clean all OPT=-DSHM_MAP_FLAGS=SHM_MAP_ALL`
+#ifndef SHM_MAP_FLAGS
+#define SHM_MAP_FLAGS 0
+#endif
+// 0 for a manager thread per entrance, level and exit, otherwise the number
+// of worker threads serving all of them off the doorbell in shared memory,
+// with gates closing and LPRs clearing on timers instead of a thread sleeping
+// e.g. `make clean all OPT=-DMANAGER_WORKERS=2`
+#ifndef MANAGER_WORKERS
+#define MANAGER_WORKERS 0
+#endif
+// how the manager picks a level for a car it lets in, one of the policies in
+// libs/occupancy.h: occ_random, occ_least_loaded, occ_round_robin or
+// occ_spread, e.g. `make clean all OPT=-DLEVEL_POLICY=occ_least_loaded`
+#ifndef LEVEL_POLICY
+#define LEVEL_POLICY occ_random
+#endif
+// Name of the shared memory journal of device events, read it with
+// ./build/bin/journal_read
+#define JOURNAL_NAME "PARKING_JOURNAL"
+// records the journal keeps (a power of two) before writing over the oldest
+#define JOURNAL_RECORDS (1 << 16)
@@ -1,14 +1,18 @@
 #include "delay.h"
+#include "journal.h"
 #include "logging.h"
 #include <limits.h>
 #include <pthread.h>
 #include <shm_parking.h>
+#include <stdlib.h>
 #include <string.h>
 
 static struct SharedMemory *shm;
 static int alarm_active = 0;
-static int smoothed_temps[NUM_LEVELS]
-                         [30]; // 2D array to store smoothed median values
+static journal_t *journal; // the simulator's journal, NULL if it has none
+// smoothed median values, 30 per level (one row per level in the shared
+// memory)
+static int (*smoothed_temps)[30];
 
 // switches index of 2 array elements
 static void elementSwap(int *element1, int *element2) {
@@ -132,82 +136,148 @@ static void *temp_monitor(void *arg) {
   return NULL;
 }
 
+// EVACUATION
+// ----------------------------------------------------
+// The message goes round the entrance signs on a timer, a letter every 20ms,
+// while the main loop keeps watching the alarm
+static timer_wheel_t *wheel;
+static wheel_timer_t evac_timer;
+// guards evacuating and evac_letter
+static pthread_mutex_t evac_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool evacuating = false; // only shown and rearmed while true
+static int evac_letter = 0;     // next letter of the message to show
+
+static void openboomgates(void);
+
+// Show the next letter on every entrance sign, then again in 20ms. The lock
+// is held throughout, so once stop_evacuating returns nothing more is shown
+static void show_evac_letter(void *arg) {
+  (void)arg;
+  const char evacmessage[9] = "EVACUATE ";
+  pthread_mutex_lock(&evac_mutex);
+  if (!evacuating) { // stopped while this was on its way
+    pthread_mutex_unlock(&evac_mutex);
+    return;
+  }
+  if (evac_letter == 0) {
+    // Handle the alarm system and open boom gates every time round
+    // Activate alarms on all levels
+    for (int i = 0; i < shm->num_levels; i++) {
+      shm->levels[i].alarm = 1; // set shm alarm to true
+    }
+    openboomgates(); // open up all boom gates
+  }
+  for (int j = 0; j < shm->num_entrances; j++) {
+    journal_log(journal, JOURNAL_SIGN_SET, JOURNAL_ENTRANCE, j, 0,
+                evacmessage[evac_letter], 0);
+    sign_set(&shm->entrances[j].sign, evacmessage[evac_letter], 0);
+  }
+  evac_letter = (evac_letter + 1) % 9;
+  wheel_arm(wheel, &evac_timer, 20, show_evac_letter, NULL);
+  pthread_mutex_unlock(&evac_mutex);
+}
+
+static void start_evacuating(void) {
+  pthread_mutex_lock(&evac_mutex);
+  evacuating = true;
+  evac_letter = 0;
+  wheel_arm(wheel, &evac_timer, 0, show_evac_letter, NULL);
+  pthread_mutex_unlock(&evac_mutex);
+}
+
+static void stop_evacuating(void) {
+  pthread_mutex_lock(&evac_mutex);
+  evacuating = false;
+  wheel_cancel(wheel, &evac_timer);
+  pthread_mutex_unlock(&evac_mutex);
+}
+
 // opens all entrance and exit boomgates
-static void openboomgate(int level) {
-  pthread_mutex_lock(&shm->entrances[level].gate.mutex);
-  shm->entrances[level].gate.status = 'O'; // set entrance gates to open
-  pthread_mutex_unlock(&shm->entrances[level].gate.mutex);
-  pthread_mutex_lock(&shm->exits[level].gate.mutex);
-  shm->exits[level].gate.status = 'O'; // set exit gates to open
-  pthread_mutex_unlock(&shm->exits[level].gate.mutex);
+static void openboomgates(void) {
+  for (int i = 0; i < shm->num_entrances; i++) {
+    journal_log(journal, JOURNAL_GATE_SET, JOURNAL_ENTRANCE, i, 0, 'O', 0);
+    gate_set(&shm->entrances[i].gate, 'O'); // set entrance gates to open
+  }
+  for (int i = 0; i < shm->num_exits; i++) {
+    journal_log(journal, JOURNAL_GATE_SET, JOURNAL_EXIT, i, 0, 'O', 0);
+    gate_set(&shm->exits[i].gate, 'O'); // set exit gates to open
+  }
 }
 
 int main(void) {
-  shm = get_shm(SHM_NAME); // get the shared memory object
+  shm = get_shm(SHM_NAME, SHM_MAP_FLAGS); // get the shared memory object
+  journal = journal_open(JOURNAL_NAME);
+  wheel = wheel_start();
+  if (wheel == NULL) {
+    log_print_string("Error starting the timer wheel\n");
+    exit(EXIT_FAILURE);
+  }
+  int num_levels = shm->num_levels;
+
+  smoothed_temps = malloc(num_levels * sizeof(*smoothed_temps));
+  pthread_t *level_threads = calloc(num_levels, sizeof(pthread_t));
+  // each thread's level, kept until it's joined
+  size_t *level_ids = calloc(num_levels, sizeof(size_t));
+  if (smoothed_temps == NULL || level_threads == NULL || level_ids == NULL) {
+    log_print_string("Error allocating levels\n");
+    exit(EXIT_FAILURE);
+  }
+  // init smoothed temps array with non-existing temperature value using
+  // INT_MIN, before any monitor reads it
+  for (int i = 0; i < num_levels; i++) {
+    for (int j = 0; j < 30; j++) {
+      smoothed_temps[i][j] = INT_MIN;
+    }
+  }
 
-  pthread_t level_threads[NUM_LEVELS];
   // create temperature monitoring threads
-  for (size_t i = 0; i < (size_t)NUM_LEVELS; i++) {
+  for (size_t i = 0; i < (size_t)num_levels; i++) {
     // MISRA 11.6: Cast from void pointer to int
     // Cannot be avoided in the case of pthreads
-    size_t level = i;
-    pthread_create(&level_threads[i], NULL, temp_monitor, &level);
+    level_ids[i] = i;
+    pthread_create(&level_threads[i], NULL, temp_monitor, &level_ids[i]);
   }
   int8_t printed_deactivated = 1; // don't print deactivated on first read
   int8_t printed_activated = 0;
 
-  // init smoothed temps array with non-existing temperature value using INT_MIN
-  for (int i = 0; i < (int)NUM_LEVELS; i++) {
-    for (int j = 0; j < 30; j++) {
-      smoothed_temps[i][j] = INT_MIN;
-    }
-  }
-
   log_print_string("Firealarm System Running\n");
   while (1) {
     if (alarm_active == 1) {
       if (!printed_activated) {
         log_raise_alarm();
+        journal_log(journal, JOURNAL_ALARM, JOURNAL_NONE, 0, 0, 1, 0);
         printed_activated = 1;
         printed_deactivated = 0;
+        // Show evacuation message on an endless loop
+        start_evacuating();
       }
-
-      // Handle the alarm system and open boom gates
-      // Activate alarms on all levels
-      for (int i = 0; i < NUM_LEVELS; i++) {
-        shm->levels[i].alarm = 1; // set shm alarm to true
-        openboomgate(i);          // open up all boom gates
-      }
-
-      // Show evacuation message on an endless loop
-      const char evacmessage[9] = "EVACUATE ";
-      for (int i = 0; i < 9; i++) {
-        for (int j = 0; j < NUM_ENTRANCES; j++) {
-          pthread_mutex_lock(&shm->entrances[j].sign.mutex);
-          shm->entrances[j].sign.display = evacmessage[i];
-          pthread_mutex_unlock(&shm->entrances[j].sign.mutex);
-        }
-        delay_ms(20); // update sign with new letter every 20ms
-      }
+      delay_ms(2); // sleep for 2 ms
     } else {
       if (!printed_deactivated) {
         log_stop_alarm();
+        journal_log(journal, JOURNAL_ALARM, JOURNAL_NONE, 0, 0, 0, 0);
         printed_deactivated = 1;
         printed_activated = 0;
+        stop_evacuating();
       }
       // Deactivate alarms on all levels
-      for (int i = 0; i < NUM_LEVELS; i++) {
+      for (int i = 0; i < num_levels; i++) {
         shm->levels[i].alarm = 0; // set shm alarm to false
       }
       delay_ms(2); // sleep for 2 ms
     }
   }
 
-  for (int i = 0; i < NUM_LEVELS; i++) {
+  for (int i = 0; i < num_levels; i++) {
     int jres = pthread_join(level_threads[i], NULL);
     if (jres != 0) {
       log_print_string("Error joining thread");
       break;
     }
   }
-}
\ No newline at end of file
+  free(level_ids);
+  free(level_threads);
+  free(smoothed_temps);
+  wheel_stop(wheel);
+  journal_close(journal, false);
+}
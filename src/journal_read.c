@@ -0,0 +1,248 @@
+#include "config.h"
+#include "journal.h"
+#include "plate_table.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+Read the journal of device events the simulator keeps in shared memory (and
+leaves behind when it exits)
+
+  ./build/bin/journal_read [dump|tail|latency]
+
+dump (the default) prints every record still in the journal, oldest first
+tail prints the new records as they're written until it's killed
+latency goes through the journal matching records up by plate, and prints how
+long each stage of a car's trip took (from a car getting to an LPR to the
+manager reading its plate, and so on)
+*/
+
+// how often tail checks for new records (ms)
+#define TAIL_POLL_MS 10
+// how long to wait for a record that's being written (us), and how many times
+// before giving up on it (its writer was killed part way through)
+#define PENDING_WAIT_US 100
+#define PENDING_TRIES 100
+
+// Print one record, time in ms since start
+static void print_record(const struct JournalRecord *r, uint64_t start) {
+  char plate[PLATE_LEN + 1] = "-";
+  if (r->plate != PLATE_NONE) {
+    plate_decode(r->plate, plate);
+  }
+  char value[8] = "-";
+  if (isprint((unsigned char)r->value)) {
+    snprintf(value, sizeof(value), "%c", r->value);
+  } else if (r->type == JOURNAL_ALARM) {
+    snprintf(value, sizeof(value), "%d", r->value);
+  }
+  printf("%12.3f %-11s %-8s %3u %-6s %-2s %d\n",
+         (double)(r->time_ns - start) / 1e6, journal_type_name(r->type),
+         journal_device_name(r->device), r->index, plate, value, r->arg);
+}
+
+// journal_read, waiting for a record that's being written to be finished
+// instead of stopping there
+static enum JournalResult read_next(journal_t *j, uint64_t *pos,
+                                    struct JournalRecord *r) {
+  int tries = 0;
+  enum JournalResult res;
+  while ((res = journal_read(j, pos, r)) == JOURNAL_PENDING) {
+    if (++tries == PENDING_TRIES) {
+      (*pos)++; // never going to be finished, skip it
+      tries = 0;
+    } else {
+      usleep(PENDING_WAIT_US);
+    }
+  }
+  return res;
+}
+
+static void dump(journal_t *j, bool follow) {
+  printf("%12s %-11s %-8s %3s %-6s %-2s %s\n", "ms", "event", "device", "#",
+         "plate", "v", "arg");
+  uint64_t pos = follow ? journal_head(j) : journal_tail(j);
+  uint64_t start = 0;
+  struct JournalRecord r;
+  while (true) {
+    enum JournalResult res = read_next(j, &pos, &r);
+    if (res == JOURNAL_OK) {
+      if (start == 0) {
+        start = r.time_ns;
+      }
+      print_record(&r, start);
+    } else if (res == JOURNAL_LOST) {
+      printf("... records written over before they were read ...\n");
+    } else if (follow) {
+      fflush(stdout);
+      usleep(TAIL_POLL_MS * 1000);
+    } else {
+      return;
+    }
+  }
+}
+
+// Stages of a car's trip the latency mode times
+enum Stage {
+  ENTRANCE_READ,  // entrance lpr-arrived -> lpr-read
+  ENTRANCE_SIGN,  // entrance lpr-read -> sign-set
+  ENTRANCE_SEEN,  // entrance sign-set -> sign-seen
+  ENTRANCE_TOTAL, // entrance lpr-arrived -> sign-seen
+  LEVEL_READ,     // level lpr-arrived -> lpr-read
+  EXIT_READ,      // exit lpr-arrived -> lpr-read
+  NUM_STAGES,
+};
+
+static const char *stage_names[NUM_STAGES] = {
+    "entrance lpr-arrived -> lpr-read",
+    "entrance lpr-read -> sign-set",
+    "entrance sign-set -> sign-seen",
+    "entrance lpr-arrived -> sign-seen",
+    "level lpr-arrived -> lpr-read",
+    "exit lpr-arrived -> lpr-read",
+};
+
+// Latencies of a stage (ns)
+struct samples {
+  uint64_t *ns;
+  size_t len;
+  size_t cap;
+};
+
+// When the car with a plate last got to each point
+struct car_times {
+  uint64_t entrance_sent;
+  uint64_t entrance_read;
+  uint64_t sign_set;
+  uint64_t level_sent;
+  uint64_t exit_sent;
+};
+
+// Add the time since *since to s, if there was a since
+static void sample(struct samples *s, uint64_t *since, uint64_t now) {
+  if (*since == 0 || now < *since) {
+    return;
+  }
+  if (s->len == s->cap) {
+    size_t cap = s->cap ? s->cap * 2 : 1024;
+    uint64_t *ns = realloc(s->ns, cap * sizeof(uint64_t));
+    if (ns == NULL) {
+      return;
+    }
+    s->ns = ns;
+    s->cap = cap;
+  }
+  s->ns[s->len++] = now - *since;
+}
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void latency(journal_t *j) {
+  struct samples stages[NUM_STAGES] = {0};
+  ptab_t *cars = ptab_create(1024, sizeof(struct car_times));
+  if (cars == NULL) {
+    perror("Error creating plate table");
+    exit(EXIT_FAILURE);
+  }
+  uint64_t pos = journal_tail(j);
+  uint64_t end = journal_head(j);
+  size_t lost = 0;
+  struct JournalRecord r;
+  while (pos < end) {
+    enum JournalResult res = read_next(j, &pos, &r);
+    if (res == JOURNAL_LOST) {
+      lost++;
+      continue;
+    }
+    if (res == JOURNAL_EMPTY) {
+      break;
+    }
+    if (r.plate == PLATE_NONE) {
+      continue; // gates and the fire alarm, not a car
+    }
+    struct car_times *t = ptab_get(cars, r.plate);
+    if (t == NULL) {
+      struct car_times none = {0};
+      if (!ptab_set(cars, r.plate, &none)) {
+        continue;
+      }
+      t = ptab_get(cars, r.plate);
+    }
+    uint64_t now = r.time_ns;
+    if (r.device == JOURNAL_ENTRANCE) {
+      if (r.type == JOURNAL_LPR_ARRIVED) {
+        *t = (struct car_times){.entrance_sent = now};
+      } else if (r.type == JOURNAL_LPR_READ) {
+        sample(&stages[ENTRANCE_READ], &t->entrance_sent, now);
+        t->entrance_read = now;
+      } else if (r.type == JOURNAL_SIGN_SET) {
+        sample(&stages[ENTRANCE_SIGN], &t->entrance_read, now);
+        t->sign_set = now;
+      } else if (r.type == JOURNAL_SIGN_SEEN) {
+        sample(&stages[ENTRANCE_SEEN], &t->sign_set, now);
+        sample(&stages[ENTRANCE_TOTAL], &t->entrance_sent, now);
+      }
+    } else if (r.device == JOURNAL_LEVEL) {
+      if (r.type == JOURNAL_LPR_ARRIVED) {
+        t->level_sent = now;
+      } else if (r.type == JOURNAL_LPR_READ) {
+        sample(&stages[LEVEL_READ], &t->level_sent, now);
+        t->level_sent = 0;
+      }
+    } else if (r.device == JOURNAL_EXIT) {
+      if (r.type == JOURNAL_LPR_ARRIVED) {
+        t->exit_sent = now;
+      } else if (r.type == JOURNAL_LPR_READ) {
+        sample(&stages[EXIT_READ], &t->exit_sent, now);
+        t->exit_sent = 0;
+      }
+    }
+  }
+  if (lost) {
+    printf("%zu runs of records were written over while reading\n", lost);
+  }
+  printf("%-34s %8s %10s %10s %10s\n", "stage", "cars", "p50 us", "p99 us",
+         "max us");
+  for (int i = 0; i < NUM_STAGES; i++) {
+    struct samples *s = &stages[i];
+    if (s->len == 0) {
+      printf("%-34s %8d %10s %10s %10s\n", stage_names[i], 0, "-", "-", "-");
+      continue;
+    }
+    qsort(s->ns, s->len, sizeof(uint64_t), compare_u64);
+    printf("%-34s %8zu %10.1f %10.1f %10.1f\n", stage_names[i], s->len,
+           (double)s->ns[s->len / 2] / 1000,
+           (double)s->ns[s->len * 99 / 100] / 1000,
+           (double)s->ns[s->len - 1] / 1000);
+    free(s->ns);
+  }
+  ptab_destroy(cars);
+}
+
+int main(int argc, char *argv[]) {
+  const char *mode = argc > 1 ? argv[1] : "dump";
+  journal_t *j = journal_open(JOURNAL_NAME);
+  if (j == NULL) {
+    fprintf(stderr, "No journal, run the simulator first\n");
+    return EXIT_FAILURE;
+  }
+  if (strcmp(mode, "dump") == 0) {
+    dump(j, false);
+  } else if (strcmp(mode, "tail") == 0) {
+    dump(j, true);
+  } else if (strcmp(mode, "latency") == 0) {
+    latency(j);
+  } else {
+    fprintf(stderr, "Usage: %s [dump|tail|latency]\n", argv[0]);
+    journal_close(j, false);
+    return EXIT_FAILURE;
+  }
+  journal_close(j, false);
+  return EXIT_SUCCESS;
+}
@@ -2,8 +2,15 @@
 #include "delay.h"
 #include "display.h"
 #include "hashtable.h"
+#include "journal.h"
+#include "occupancy.h"
+#include "plate.h"
+#include "reactor.h"
 #include "shm_parking.h"
+#include "striped_table.h"
+#include "whitelist.h"
 #include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,16 +27,25 @@ struct car_levels {
 #define CHAR_TO_INT(c) (c - '0')
 #define INT_TO_CHAR(i) (i + '0')
 
-// number of plates to initialise hashtable, can be lower than the actual number
-// and table will grow
-#define EXPECTED_NUM_PLATES 10
+// number of cars to initialise the cars table for (a full car park), it grows
+// past this as more whitelisted cars visit
+#define EXPECTED_NUM_CARS(shm) ((shm)->num_levels * (shm)->level_capacity)
+// number of lock stripes in the cars table, more stripes means entrance, level
+// and exit threads are less likely to wait on each other
+#define CARS_TABLE_STRIPES 64
+// level value meaning "leave this level as it is" for ts_set_levels
+#define KEEP_LEVEL -2
 
 pthread_mutex_t rand_mutex; // mutex for rand() function
-pthread_mutex_t cars_mutex; // mutex for hashtable of vehicles
-ht_t *cars_ht; // hashtable of vehicles and their current and assigned level
+// plates allowed into the car park, mapped from plates.wl (read-only, so no
+// locks). Its Bloom filter turns most unknown plates away before any lookup
+wl_t *whitelist;
+// table of whitelisted vehicles that have visited and their current and
+// assigned level (thread-safe), a car that isn't in here hasn't got a level
+sptab_t *cars_ht;
 
-pthread_mutex_t capacity_mutex; // mutex for capacity of each level
-ht_t *capacity_ht;              // hashtable of levels and their capacity
+// cars on each level and which levels have room (lock-free)
+occupancy_t *occupancy;
 
 // hashtable for storing billing information for cars
 ht_t *billing_ht;
@@ -42,6 +58,7 @@ int gettimeofday(struct timeval *tp, struct timezone *tz);
 int run = 1;
 
 struct SharedMemory *shm; // shared memory
+journal_t *journal;       // the simulator's journal, NULL if it has none
 
 // structs for passing arguments to threads
 struct EntryArgs {
@@ -56,159 +73,76 @@ struct LevelArgs {
 };
 
 // thread-safe access to capacity of a level
-int ts_cars_on_level(int l) {
-  char level[2];
-  level[0] = INT_TO_CHAR(l);
-  level[1] = '\0';
-  int cars;
-  pthread_mutex_lock(&capacity_mutex);
-  cars = *(int *)htab_get(capacity_ht, level);
-  pthread_mutex_unlock(&capacity_mutex);
-  return cars;
+int ts_cars_on_level(int l) { return occ_cars(occupancy, l); }
+
+// thread-safe change to the number of cars on a level
+int ts_add_cars_to_level(int l, int num_cars) {
+  return occ_add(occupancy, l, num_cars);
 }
 
-// Get Levels that have not reached capacity
-// Returns int array with first element being the number of available levels
-// and the rest being the actual levels
-int *get_available_levels(int *levels) {
-  if (levels == NULL) {
-    perror("Level Malloc");
-    exit(EXIT_FAILURE);
+// thread-safe claim of a spot on a level
+// return false if the level is full
+bool ts_add_car_if_room(int l) { return occ_try_add(occupancy, l); }
+
+// thread-safe copy of a car's levels into value, takes no lock so the entry,
+// level and exit handlers never wait on each other to read
+// return false if the car isn't whitelisted (not allowed in)
+bool ts_get_number_plate(plate_t plate, struct car_levels *value) {
+  if (!wl_contains(whitelist, plate)) {
+    return false;
   }
-  int i = 0;
-  for (int l = 0; l < NUM_LEVELS; l++) {
-    if (ts_cars_on_level(l) < LEVEL_CAPACITY) {
-      i++;
-      levels[i] = l;
-    }
+  // a whitelisted car that hasn't been here yet has no levels
+  if (!sptab_get(cars_ht, plate, value)) {
+    value->current = -1;
+    value->assigned = -1;
   }
-  levels[0] = i;
-  return levels;
+  return true;
 }
 
-// thread-safe setting of level capacity
-int ts_add_cars_to_level(int l, int num_cars) {
-  if (l >= NUM_LEVELS || l < 0) {
-    return 0;
+// update callback for cars_ht, copies over any level in arg that isn't
+// KEEP_LEVEL
+static void update_levels(void *value, void *arg) {
+  struct car_levels *levels = (struct car_levels *)value;
+  struct car_levels *update = (struct car_levels *)arg;
+  if (update->current != KEEP_LEVEL) {
+    levels->current = update->current;
   }
-  // turn level into null-terminated string
-  char level[2];
-  level[0] = INT_TO_CHAR(l);
-  level[1] = '\0';
-  int cars;
-  pthread_mutex_lock(&capacity_mutex);
-  int *cars_ptr = (int *)htab_get(capacity_ht, level);
-  if (cars_ptr == NULL) {
-    return 0;
+  if (update->assigned != KEEP_LEVEL) {
+    levels->assigned = update->assigned;
   }
-  cars = *cars_ptr;
-  cars += num_cars;
-  // This is such a hack, if you're marking this just ignore
-  // the fact that I brute force the capacity to 0 if it goes below 0 during a
-  // fire
-  cars = cars > 0 ? cars : 0;
-  htab_set(capacity_ht, level, &cars, sizeof(int));
-  pthread_mutex_unlock(&capacity_mutex);
-  return cars;
-}
-
-// thread-safe access to the number plates
-struct car_levels *ts_get_number_plate(char *plate) {
-  struct car_levels *value;
-  // ensure the plate is null-terminated
-  char null_terminated_plate[7];
-  strncpy(null_terminated_plate, plate, 7);
-  null_terminated_plate[6] = '\0';
-  // ----------
-  pthread_mutex_lock(&cars_mutex);
-  value = (struct car_levels *)htab_get(cars_ht, null_terminated_plate);
-  pthread_mutex_unlock(&cars_mutex);
-  return value;
 }
 
-// thread-safe allocation to a level
-bool ts_set_assigned_level(char *plate, int level) {
-  // ensure the plate is null-terminated
-  char null_terminated_plate[7];
-  strncpy(null_terminated_plate, plate, 7);
-  null_terminated_plate[6] = '\0';
-  // ----------
-  bool success;
-  pthread_mutex_lock(&cars_mutex);
-  struct car_levels *current_value =
-      (struct car_levels *)htab_get(cars_ht, null_terminated_plate);
-  struct car_levels new_value = {-1, -1}; // assume failure
-  if (current_value) {
-    new_value = *current_value; // if not fail, update
+// thread-safe update of both a car's assigned and current level, with one
+// lock and one lookup. Pass KEEP_LEVEL to leave either as it is
+// return false if the car isn't whitelisted
+bool ts_set_levels(plate_t plate, int assigned, int current) {
+  if (!wl_contains(whitelist, plate)) {
+    return false;
   }
-  new_value.assigned = level; // set the assigned level
-  success = htab_set(cars_ht, null_terminated_plate, &new_value,
-                     sizeof(struct car_levels));
-  pthread_mutex_unlock(&cars_mutex);
-  return success;
+  struct car_levels unassigned = {-1, -1};
+  struct car_levels update = {current, assigned};
+  return sptab_upsert(cars_ht, plate, &unassigned, update_levels, &update,
+                      NULL);
 }
 
 // thread-safe allocation to current level
-bool ts_set_current_level(char *plate, int level) {
-  // ensure the plate is null-terminated
-  char null_terminated_plate[7];
-  strncpy(null_terminated_plate, plate, 7);
-  null_terminated_plate[6] = '\0';
-  // ----------
-  bool success;
-  pthread_mutex_lock(&cars_mutex);
-  struct car_levels *current_value =
-      (struct car_levels *)htab_get(cars_ht, null_terminated_plate);
-  struct car_levels new_value = {-1, -1}; // assume failure
-  if (current_value) {
-    new_value = *current_value; // if not fail, update
-  }
-  new_value.current = level; // set the assigned level
-  success = htab_set(cars_ht, null_terminated_plate, &new_value,
-                     sizeof(struct car_levels));
-  pthread_mutex_unlock(&cars_mutex);
-  return success;
+bool ts_set_current_level(plate_t plate, int level) {
+  return ts_set_levels(plate, KEEP_LEVEL, level);
 }
 
-// read each line of a file into a hashtable, initialising their value to 0
-ht_t *ht_from_file(char *filename) {
-  puts(filename);
-  FILE *fp = fopen(filename, "r");
-  if (fp == NULL) {
-    perror("Error opening file");
-    return NULL;
-  }
-  // create a hashtable
-  ht_t *ht = NULL;
-  ht = htab_create(ht, EXPECTED_NUM_PLATES);
-  // read the file line by line
-  char *line = NULL;
-  size_t linecap = 0;
-  ssize_t linelen;
-  struct car_levels unassigned = {-1, -1};
-  while ((linelen = getline(&line, &linecap, fp)) > 0) {
-    // null-terminate the plate if not already
-    line[6] = '\0';
-    // set the value to 0xFF (unassigned)
-    htab_set(ht, line, &unassigned, sizeof(struct car_levels));
-  }
-  free(line);
-  return ht;
-}
+// stop function for the LPR handlers
+static bool stopped(void) { return !run; }
 
-// Wait at the LPR for a licence plate to be written
-void wait_for_lpr(struct LPR *lpr) {
-  // wait at the given LPR for anything other than NULL to be written
-  pthread_mutex_lock(&lpr->mutex);
-  while (lpr->plate[0] == '\0' && run) { // while the lpr is empty
-    pthread_cond_wait(&lpr->condition, &lpr->mutex);
-  }
-  pthread_mutex_unlock(&lpr->mutex);
+// Wait at the LPR for a licence plate to be written and copy it into plate,
+// and its sequence number into seq (to acknowledge it with)
+// return false if the manager stopped first
+bool wait_for_lpr(struct LPR *lpr, char plate[PLATE_LEN], uint32_t *seq) {
+  return lpr_wait(lpr, plate, seq, stopped);
 }
 
 // checks each level, returns 1 immediately if any level has the alarm active
 int alarm_is_active() {
-  for (int i = 0; i < NUM_LEVELS; i++) {
+  for (int i = 0; i < shm->num_levels; i++) {
     if (shm->levels[i].alarm) {
       return 1;
     }
@@ -216,114 +150,209 @@ int alarm_is_active() {
   return 0;
 }
 
+// Decide what entrance id's sign shows the car with plate, and which level
+// it's sent to in *assigned (0-indexed, -1 if it isn't let in). The car is
+// counted on that level straight away, so cars let in before it gets there
+// don't all see it empty and get sent to it too
+static char entry_decide(int id, plate_t plate, int *assigned) {
+  char level = '\0';
+  *assigned = -1;
+  // check if the car is in the hashtable (and not already in the car park)
+  struct car_levels value;
+
+  if (!wl_maybe_contains(whitelist, plate)) // filter says it can't be there
+  {
+    level = 'X';
+  } else if (!ts_get_number_plate(plate, &value)) // not in the hashtable
+  {
+    level = 'X';
+  } else if (value.assigned == -1 &&
+             value.current == -1) // not already in but allowed
+  {
+    // a level that isn't full, picked by the LEVEL_POLICY in config.h. If
+    // another entrance takes its last spot first, pick again
+    for (;;) {
+      unsigned n = 0;
+      if (LEVEL_POLICY == occ_random) { // the only one that wants it
+        pthread_mutex_lock(&rand_mutex);
+        n = rand();
+        pthread_mutex_unlock(&rand_mutex);
+      }
+      *assigned = LEVEL_POLICY(occupancy, id, n);
+      if (*assigned == -1 ? occ_num_free(occupancy) == 0
+                          : ts_add_car_if_room(*assigned)) { // hold its spot
+        break;
+      }
+      sched_yield(); // let whoever filled it finish updating the counts
+    }
+    if (*assigned == -1) {
+      level = 'F'; // Carpark Full
+    } else {
+      level = sign_level_char(*assigned);
+    }
+  } else { // not allowed in the car park (already in )
+    level = 'X';
+  }
+  return level;
+}
+
+// Let the car with plate in through entrance id to its assigned level: raise
+// the gate and start billing it
+static void entry_admit(int id, plate_t plate, int assigned) {
+  // assign them the given level, they aren't on a current level yet
+  ts_set_levels(plate, assigned, -1);
+  journal_log(journal, JOURNAL_GATE_SET, JOURNAL_ENTRANCE, id, plate, 'R', 0);
+  gate_set(&shm->entrances[id].gate, 'R'); // set the gate to rising
+  // Add car to billing table
+  // Null terminate plate
+  char array[PLATE_LEN + 1];
+  plate_decode(plate, array);
+
+  // get current time in milliseconds
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  long long millisecondsTime =
+      (long long)(tv.tv_sec) * 1000 +
+      (long long)(tv.tv_usec) / 1000; // convert tv_sec & tv_usec to// milliseconds
+
+  // add to hashtable, a car that's been here before reuses its entry
+  pthread_mutex_lock(&billing_mutex);
+  long long *entry_time =
+      (long long *)htab_upsert(billing_ht, array, sizeof(long long), NULL);
+  if (entry_time) {
+    *entry_time = millisecondsTime;
+  }
+  pthread_mutex_unlock(&billing_mutex);
+}
+
+// The car with plate (lpr_plate as read) went past level level_id's LPR, so
+// it's either just parked there or leaving. A car is counted on its assigned
+// level from when it's let in until it leaves a level
+static void level_arrive(int level_id, plate_t plate,
+                         const char lpr_plate[PLATE_LEN]) {
+  // check if they are entering or exiting
+  struct car_levels value = {-1, -1};
+  ts_get_number_plate(plate, &value);
+  int assigned = value.assigned;
+  int current = value.current;
+  if (current != -1) // they are already on a level
+  {
+    if (current == level_id) // they must be on this level and leaving
+    {
+      // unassign car from the level, giving up its spot
+      ts_set_levels(plate, -1, -1);
+      // decrement the level capacity
+      ts_add_cars_to_level(level_id, -1);
+    } else // they are on a different level currently ????
+    {
+      // something went real wrong, they haven't left the level they were on
+      printf("Car %.6s teleported to different level, current: %d, "
+             "thislevel: %d, value: c:%d, a:%d\n",
+             lpr_plate, current, level_id, value.current, value.assigned);
+      exit(EXIT_FAILURE);
+    }
+  } else if (assigned != level_id) // they aren't assigned to this level
+  {
+    // they are on the wrong level (or not assigned at all), re-assign them
+    // if there is room, moving their spot here
+    if (ts_add_car_if_room(level_id)) {
+      ts_add_cars_to_level(assigned, -1);
+      ts_set_levels(plate, level_id, level_id);
+    } else {
+      // Can't really communicate with the cars as there is no sign, they
+      // keep their spot on the assigned level
+      printf("Car trying to enter full level\n");
+    }
+  } else // they are assigned this level and current level is NO_LEVEL
+  {
+    // set the car's current level, it's been counted here since it was let in
+    ts_set_current_level(plate, level_id);
+  }
+}
+
+// Let the car with plate out through exit id: raise the gate, bill it and
+// unassign it from the car park
+static void exit_leave(int id, plate_t plate) {
+  // open the gate
+  journal_log(journal, JOURNAL_GATE_SET, JOURNAL_EXIT, id, plate, 'R', 0);
+  gate_set(&shm->exits[id].gate, 'R');
+  // Calculate billing
+  char exitplate[PLATE_LEN + 1];
+  plate_decode(plate, exitplate);
+  pthread_mutex_lock(&billing_mutex);
+  long long *entry_time = (long long *)htab_get(billing_ht, exitplate);
+  pthread_mutex_unlock(&billing_mutex);
+  if (!entry_time) {
+    printf("Car %s not found in billing table\n", exitplate);
+  } else {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    long long millisecondsTime =
+        (long long)(tv.tv_sec) * 1000 +
+        (long long)(tv.tv_usec) /
+            1000; // convert tv_sec & tv_usec to// milliseconds
+    int time_in_carpark = (millisecondsTime - *entry_time) / TIME_FACTOR;
+    float bill = time_in_carpark * COST_PER_MS;
+    FILE *billing_file = fopen("billing.txt", "a");
+    fprintf(billing_file, "%s $%.2f \n", exitplate, bill);
+    fclose(billing_file);
+    total_bill += bill;
+  }
+
+  // car left, unassign them from the carpark, giving back the spot of a car
+  // that never made it onto (or off) a level
+  struct car_levels value = {-1, -1};
+  ts_get_number_plate(plate, &value);
+  ts_add_cars_to_level(value.assigned, -1);
+  ts_set_levels(plate, -1, -1);
+}
+
 void *entry_handler(void *arg) {
   struct EntryArgs *args = (struct EntryArgs *)arg;
   int id = args->id;
   struct Entrance *entrance = &shm->entrances[id]; // The corresponding entrance
-  int *available_levels = calloc(NUM_LEVELS + 1, sizeof(int));
-  if (available_levels == NULL) {
-    perror("Levels Calloc");
-    exit(EXIT_FAILURE);
-  }
   while (run) {
     // wait for a car to arrive at the LPR
-    wait_for_lpr(&entrance->lpr);
-    if (!run)
+    char lpr_plate[PLATE_LEN];
+    uint32_t seq;
+    if (!wait_for_lpr(&entrance->lpr, lpr_plate, &seq) || !run)
       break;
     // should be a licence plate there now, so read it
-    char *plate = entrance->lpr.plate;
-    char level = '\0';
+    plate_t plate = plate_encode(lpr_plate);
+    journal_log(journal, JOURNAL_LPR_READ, JOURNAL_ENTRANCE, id, plate, 0, 0);
 
     if (alarm_is_active()) {
       // clear the LPR and continue to the next iteration
-      pthread_mutex_lock(&entrance->lpr.mutex);
-      memset(entrance->lpr.plate, '\0', 6);
-      pthread_cond_broadcast(&entrance->lpr.condition);
-      pthread_mutex_unlock(&entrance->lpr.mutex);
+      lpr_ack(&entrance->lpr, seq);
       continue;
     }
-    // check if the car is in the hashtable (and not already in the car park)
-    struct car_levels *value = ts_get_number_plate(plate);
-
-    if (!value) // not in the hashtable
-    {
-      level = 'X';
-    } else if (value->assigned == -1 &&
-               value->current == -1) // not already in but allowed
-    {
-      // update available levels
-      available_levels = get_available_levels(available_levels);
-      if (available_levels[0] == 0) {
-        level = 'F'; // Carpark Full
-      } else {
-        pthread_mutex_lock(&rand_mutex);
-        // id of a random available level
-        int available_level_index = rand() % available_levels[0] + 1;
-        pthread_mutex_unlock(&rand_mutex);
-        level = available_levels[available_level_index]; // random available
-                                                         // level (integer)
-        level = INT_TO_CHAR(level + 1); // level offset by 1 for display
-      }
-    } else { // not allowed in the car park (already in )
-      level = 'X';
-    }
+    int assigned; // level the car is sent to (0-indexed)
+    char level = entry_decide(id, plate, &assigned);
 
-    // set the sign
-    pthread_mutex_lock(&entrance->sign.mutex);
+    // set the sign, level is 0 if they weren't given one
     if (level) { // don't touch the level if we are evacuating
-      entrance->sign.display = level;
+      // journalled before it's set, so it's before the car seeing it
+      journal_log(journal, JOURNAL_SIGN_SET, JOURNAL_ENTRANCE, id, plate,
+                  level, assigned + 1);
+      sign_set(&entrance->sign, level, assigned + 1);
     }
-    pthread_cond_broadcast(&entrance->sign.condition);
-    pthread_mutex_unlock(&entrance->sign.mutex);
-
-    // Tell the simulator to open the gate if the level is one of the numbers
-    if ((level && level >= '0' && level <= '9')) {
-      ts_set_assigned_level(plate,
-                            CHAR_TO_INT(level) -
-                                1);    // assign them the given level
-      ts_set_current_level(plate, -1); // they aren't on a current level
-      pthread_mutex_lock(&entrance->gate.mutex);
-      entrance->gate.status = 'R'; // set the gate to rising
-      pthread_cond_broadcast(&entrance->gate.condition);
-      pthread_mutex_unlock(&entrance->gate.mutex);
-      // Add car to billing table
-      // Null terminate plate
-      char array[7];
-      memccpy(array, plate, 0, 6);
-      array[6] = '\0';
-
-      // get current time in milliseconds
-      struct timeval tv;
-      gettimeofday(&tv, NULL);
-      long long millisecondsTime =
-          (long long)(tv.tv_sec) * 1000 +
-          (long long)(tv.tv_usec) /
-              1000; // convert tv_sec & tv_usec to// milliseconds
-
-      // add to hashtable
-      pthread_mutex_lock(&billing_mutex);
-      htab_set(billing_ht, array, &millisecondsTime, sizeof(long long));
-      pthread_mutex_unlock(&billing_mutex);
+
+    // Tell the simulator to open the gate if the car was given a level
+    if (assigned != -1) {
+      entry_admit(id, plate, assigned);
 
       // close gate after 20ms
       delay_ms(20);
-      pthread_mutex_lock(&entrance->gate.mutex);
-      entrance->gate.status = 'L';
-      pthread_cond_broadcast(&entrance->gate.condition);
-      pthread_mutex_unlock(&entrance->gate.mutex);
+      journal_log(journal, JOURNAL_GATE_SET, JOURNAL_ENTRANCE, id, plate, 'L',
+                  0);
+      gate_set(&entrance->gate, 'L');
     }
     delay_ms(20); // allow sim time to close the gate
     // clear the Sign from the last guy
-    pthread_mutex_lock(&entrance->sign.mutex);
-    entrance->sign.display = '\0';
-    pthread_mutex_unlock(&entrance->sign.mutex);
-    // clear the LPR
-    pthread_mutex_lock(&entrance->lpr.mutex);
-    memset(entrance->lpr.plate, '\0', 6);
-    pthread_cond_broadcast(&entrance->lpr.condition);
-    pthread_mutex_unlock(&entrance->lpr.mutex);
+    sign_set(&entrance->sign, '\0', 0);
+    // clear the LPR (let the next car know it's their turn)
+    lpr_ack(&entrance->lpr, seq);
   }
-  free(available_levels); // get rid of the levels array
   printf("Entry Stop %d\n", id);
   return NULL;
 }
@@ -335,57 +364,22 @@ void *level_handler(void *arg) {
   // forever stuck checking for cars
   while (run) {
     // wait at the lpr for a car to arrive
-    wait_for_lpr(&level->lpr);
-    if (!run)
+    char lpr_plate[PLATE_LEN];
+    uint32_t seq;
+    if (!wait_for_lpr(&level->lpr, lpr_plate, &seq) || !run)
       break;
     // read the plate
-    char *plate = level->lpr.plate;
-    // check if they are entering or exiting
-    struct car_levels *value = ts_get_number_plate(plate);
-    int assigned = value->assigned;
-    int current = value->current;
-    if (current != -1) // they are already on a level
-    {
-      if (current == level_id) // they must be on this level and leaving
-      {
-        // unassign car from the level
-        ts_set_current_level(plate, -1);
-        // decrement the level capacity
-        ts_add_cars_to_level(level_id, -1);
-      } else // they are on a different level currently ????
-      {
-        // something went real wrong, they haven't left the level they were on
-        printf("Car %.6s teleported to different level, current: %d, "
-               "thislevel: %d, value: c:%d, a:%d\n",
-               plate, current, level_id, value->current, value->assigned);
-        exit(EXIT_FAILURE);
-      }
-    } else if (assigned != level_id) // they aren't assigned to this level
-    {
-      // they are on the wrong level (or not assigned at all), re-assign them
-      // if there is room
-      if (ts_cars_on_level(level_id) < LEVEL_CAPACITY) {
-        ts_add_cars_to_level(assigned, -1);
-        ts_add_cars_to_level(level_id, 1);
-        ts_set_current_level(plate, level_id);
-      } else {
-        // Can't really communicate with the cars as there is no sign
-        printf("Car trying to enter full level\n");
-      }
-    } else // they are assigned this level and current level is NO_LEVEL
-    {
-      // increment the level capacity
-      ts_add_cars_to_level(level_id, 1);
-      // set the car's current level
-      ts_set_current_level(plate, level_id);
+    plate_t plate = plate_encode(lpr_plate);
+    journal_log(journal, JOURNAL_LPR_READ, JOURNAL_LEVEL, level_id, plate, 0,
+                0);
+    level_arrive(level_id, plate, lpr_plate);
+
+    // clear the lpr after 20ms so it flashes on the screen. With a ring the
+    // next car's plate is already waiting, and the display shows the last one
+    if (!LPR_PIPELINED) {
+      delay_ms(20);
     }
-
-    // clear the lpr after 20ms so it flashes on the screen
-    delay_ms(20);
-    pthread_mutex_lock(&level->lpr.mutex);
-    memset(level->lpr.plate, '\0', 6);
-    pthread_cond_broadcast(&level->lpr.condition);
-    pthread_mutex_unlock(&level->lpr.mutex);
+    lpr_ack(&level->lpr, seq);
   }
   return NULL;
 }
@@ -396,64 +390,175 @@ void *exit_handler(void *arg) {
   struct Exit *exit = &shm->exits[id]; // The corresponding exit
   while (run) {
     // wait for a car to arrive at the LPR
-    wait_for_lpr(&exit->lpr);
-    if (!run)
+    char lpr_plate[PLATE_LEN];
+    uint32_t seq;
+    if (!wait_for_lpr(&exit->lpr, lpr_plate, &seq) || !run)
       break;
     // should be a licence plate there now, so read it
-    char *plate = exit->lpr.plate;
-    // open the gate
-    pthread_mutex_lock(&exit->gate.mutex);
-    exit->gate.status = 'R';
-
-    pthread_cond_broadcast(&exit->gate.condition);
-    pthread_mutex_unlock(&exit->gate.mutex);
-    // Calculate billing
-    char exitplate[7];
-    memccpy(exitplate, plate, 0, 6);
-    exitplate[6] = '\0';
-    pthread_mutex_lock(&billing_mutex);
-    long long *entry_time = (long long *)htab_get(billing_ht, exitplate);
-    pthread_mutex_unlock(&billing_mutex);
-    if (!entry_time) {
-      printf("Car %.6s not found in billing table\n", plate);
-    } else {
-      struct timeval tv;
-      gettimeofday(&tv, NULL);
-      long long millisecondsTime =
-          (long long)(tv.tv_sec) * 1000 +
-          (long long)(tv.tv_usec) /
-              1000; // convert tv_sec & tv_usec to// milliseconds
-      int time_in_carpark = (millisecondsTime - *entry_time) / TIME_FACTOR;
-      float bill = time_in_carpark * COST_PER_MS;
-      FILE *billing_file = fopen("billing.txt", "a");
-      fprintf(billing_file, "%s $%.2f \n", exitplate, bill);
-      fclose(billing_file);
-      total_bill += bill;
-    }
-
-    // car left, unassign them from the carpark.
-    ts_set_assigned_level(plate, -1);
-    ts_set_current_level(plate, -1);
+    plate_t plate = plate_encode(lpr_plate);
+    journal_log(journal, JOURNAL_LPR_READ, JOURNAL_EXIT, id, plate, 0, 0);
+    exit_leave(id, plate);
 
     // wait 20ms and then tell sim to close the gate, only if we aren't
     // evacuating
     if (!alarm_is_active()) {
       delay_ms(20);
-      pthread_mutex_lock(&exit->gate.mutex);
-      exit->gate.status = 'L';
-      pthread_cond_broadcast(&exit->gate.condition);
-      pthread_mutex_unlock(&exit->gate.mutex);
+      journal_log(journal, JOURNAL_GATE_SET, JOURNAL_EXIT, id, plate, 'L', 0);
+      gate_set(&exit->gate, 'L');
     }
     delay_ms(20); // allow sim time to close the gate
     // clear the LPR, ready for another car
-    pthread_mutex_lock(&exit->lpr.mutex);
-    memset(exit->lpr.plate, '\0', 6);
-    pthread_cond_broadcast(&exit->lpr.condition);
-    pthread_mutex_unlock(&exit->lpr.mutex);
+    lpr_ack(&exit->lpr, seq);
   }
   return NULL;
 }
 
+// REACTOR (MANAGER_WORKERS)
+// ----------------------------------------------------
+// Instead of a thread per device, a few workers serve every LPR from the
+// doorbell the simulator rings, and the 20ms waits are reactor timers
+
+// What a device is waiting to do next
+enum DeviceStep {
+  STEP_IDLE,       // waiting for a plate
+  STEP_CLOSE_GATE, // the car's had time to go through, lower the gate
+  STEP_CLEAR,      // the gate's had time to close, let the next car up
+};
+
+// The car a device is dealing with, one per bell on the doorbell
+struct ReactorDevice {
+  enum DeviceStep step;
+  plate_t plate;
+  uint32_t seq;
+};
+struct ReactorDevice *reactor_devices;
+
+// Which entrance, level or exit a device is (its id in *id)
+static enum JournalDevice device_kind(int device, int *id) {
+  if (device < shm->num_entrances) {
+    *id = device;
+    return JOURNAL_ENTRANCE;
+  }
+  device -= shm->num_entrances;
+  if (device < shm->num_levels) {
+    *id = device;
+    return JOURNAL_LEVEL;
+  }
+  *id = device - shm->num_levels;
+  return JOURNAL_EXIT;
+}
+
+static struct LPR *device_lpr(enum JournalDevice kind, int id) {
+  if (kind == JOURNAL_ENTRANCE) {
+    return &shm->entrances[id].lpr;
+  } else if (kind == JOURNAL_LEVEL) {
+    return &shm->levels[id].lpr;
+  }
+  return &shm->exits[id].lpr;
+}
+
+// Deal with the plates at the device's LPR, until one needs something done
+// later or there aren't any left
+static void reactor_next_car(reactor_t *r, int device) {
+  struct ReactorDevice *d = &reactor_devices[device];
+  int id;
+  enum JournalDevice kind = device_kind(device, &id);
+  struct LPR *lpr = device_lpr(kind, id);
+  char lpr_plate[PLATE_LEN];
+  while (run && lpr_poll(lpr, lpr_plate, &d->seq)) {
+    d->plate = plate_encode(lpr_plate);
+    journal_log(journal, JOURNAL_LPR_READ, kind, id, d->plate, 0, 0);
+    if (kind == JOURNAL_ENTRANCE) {
+      if (alarm_is_active()) {
+        lpr_ack(lpr, d->seq);
+        continue;
+      }
+      int assigned;
+      char level = entry_decide(id, d->plate, &assigned);
+      if (level) {
+        journal_log(journal, JOURNAL_SIGN_SET, JOURNAL_ENTRANCE, id, d->plate,
+                    level, assigned + 1);
+        sign_set(&shm->entrances[id].sign, level, assigned + 1);
+      }
+      if (assigned != -1) {
+        entry_admit(id, d->plate, assigned);
+        d->step = STEP_CLOSE_GATE;
+      } else {
+        d->step = STEP_CLEAR;
+      }
+    } else if (kind == JOURNAL_LEVEL) {
+      level_arrive(id, d->plate, lpr_plate);
+      if (LPR_PIPELINED) {
+        lpr_ack(lpr, d->seq);
+        continue;
+      }
+      d->step = STEP_CLEAR;
+    } else {
+      exit_leave(id, d->plate);
+      // the gates stay open while we're evacuating
+      d->step = alarm_is_active() ? STEP_CLEAR : STEP_CLOSE_GATE;
+    }
+    reactor_defer(r, device, 20);
+    return;
+  }
+}
+
+// A car is at the device's LPR (or more, with a ring)
+static void reactor_ring(reactor_t *r, int device, void *arg) {
+  (void)arg;
+  // a busy device gets to the car when it's finished with the last one
+  if (reactor_devices[device].step == STEP_IDLE) {
+    reactor_next_car(r, device);
+  }
+}
+
+// A device's 20ms is up
+static void reactor_timer(reactor_t *r, int device, void *arg) {
+  (void)arg;
+  struct ReactorDevice *d = &reactor_devices[device];
+  int id;
+  enum JournalDevice kind = device_kind(device, &id);
+  if (d->step == STEP_CLOSE_GATE) {
+    journal_log(journal, JOURNAL_GATE_SET, kind, id, d->plate, 'L', 0);
+    gate_set(kind == JOURNAL_ENTRANCE ? &shm->entrances[id].gate
+                                      : &shm->exits[id].gate,
+             'L');
+    d->step = STEP_CLEAR;
+    reactor_defer(r, device, 20);
+  } else if (d->step == STEP_CLEAR) {
+    if (kind == JOURNAL_ENTRANCE) {
+      sign_set(&shm->entrances[id].sign, '\0', 0);
+    }
+    lpr_ack(device_lpr(kind, id), d->seq);
+    d->step = STEP_IDLE;
+    // the next car may have got there already
+    reactor_next_car(r, device);
+  }
+}
+
+// Start MANAGER_WORKERS workers serving every device
+static reactor_t *start_reactor(void) {
+  int devices = SHM_BELLS(shm);
+  reactor_devices = calloc(devices, sizeof(struct ReactorDevice));
+  if (reactor_devices == NULL) {
+    perror("calloc reactor devices");
+    exit(EXIT_FAILURE);
+  }
+  // whatever the simulator rang before we started is still rung
+  reactor_t *r = reactor_start(shm->doorbell, devices, MANAGER_WORKERS,
+                               reactor_ring, reactor_timer, NULL);
+  if (r == NULL) {
+    perror("Error starting the reactor");
+    exit(EXIT_FAILURE);
+  }
+  return r;
+}
+
+static void stop_reactor(reactor_t *r) {
+  reactor_stop(r);
+  free(reactor_devices);
+}
+
 void *input_handler() {
   char input = 'o';
   // setup terminal to read character without pressing enter
@@ -480,84 +585,116 @@ int main(int argc, char *argv[]) {
   // initialise local mutexes
   srand(time(NULL));
   pthread_mutex_init(&rand_mutex, NULL);
-  pthread_mutex_init(&cars_mutex, NULL);
-  pthread_mutex_init(&capacity_mutex, NULL);
 
   // get the shared memory object
-  shm = get_shm(SHM_NAME);
-
-  // read the allowed number plates from a file into hashtable
-  cars_ht = ht_from_file("plates.txt");
+  shm = get_shm(SHM_NAME, SHM_MAP_FLAGS);
+  // journal what it does alongside the simulator, if it's keeping one
+  journal = journal_open(JOURNAL_NAME);
+
+  // map the allowed number plates, only compiling plates.txt if it changed
+  whitelist = wl_load("plates.txt", "plates.wl");
+  if (whitelist == NULL) {
+    perror("Error loading plates.txt");
+    exit(EXIT_FAILURE);
+  }
+  cars_ht = sptab_create(EXPECTED_NUM_CARS(shm), sizeof(struct car_levels),
+                         CARS_TABLE_STRIPES);
+  if (cars_ht == NULL) {
+    perror("Error creating plate table");
+    exit(EXIT_FAILURE);
+  }
 
-  // initialise level capacity hashtable
-  capacity_ht = htab_create(capacity_ht, NUM_LEVELS);
-  for (int i = 0; i < NUM_LEVELS; i++) {
-    char level[2] = {INT_TO_CHAR(i), '\0'};
-    int num_cars = 0;
-    htab_set(capacity_ht, level, &num_cars, sizeof(int));
+  // initialise level capacity, every level empty
+  occupancy = occ_create(shm->num_levels, shm->level_capacity);
+  if (occupancy == NULL) {
+    perror("Error creating level occupancy");
+    exit(EXIT_FAILURE);
   }
 
   // initialise billing hashtable
-  billing_ht = htab_create(billing_ht, 5);
-
-  // create entrance threads
-  // -------------------------------
-  pthread_t entry_threads[NUM_ENTRANCES];
-  struct EntryArgs *entry_args[NUM_ENTRANCES];
-  for (int i = 0; i < NUM_ENTRANCES; i++) {
-    struct EntryArgs *args = calloc(1, sizeof(struct EntryArgs));
-    if (args == NULL) {
-      perror("calloc entry");
+  // at most every whitelisted car is in the car park at once, and once it's
+  // bigger than that it grows a few buckets per operation instead of
+  // rehashing everything while an LPR handler holds billing_mutex. Entries
+  // come from a slab pool so a car's entry doesn't cost its own mallocs
+  billing_ht = htab_create_pooled(billing_ht, 5);
+  htab_reserve(billing_ht, wl_size(whitelist));
+  htab_set_incremental(billing_ht, true);
+
+  // with MANAGER_WORKERS, a few workers serve every device off the doorbell,
+  // otherwise each device gets its own thread
+  reactor_t *reactor = NULL;
+  pthread_t *entry_threads = NULL, *level_threads = NULL, *exit_threads = NULL;
+  struct EntryArgs **entry_args = NULL;
+  struct LevelArgs **level_args = NULL;
+  struct ExitArgs **exit_args = NULL;
+  if (MANAGER_WORKERS > 0) {
+    reactor = start_reactor();
+  } else {
+    // create entrance threads
+    // -------------------------------
+    // the car park is sized by the simulator, so one of each thread per device
+    // in the shared memory
+    entry_threads = calloc(shm->num_entrances, sizeof(pthread_t));
+    entry_args = calloc(shm->num_entrances, sizeof(struct EntryArgs *));
+    level_threads = calloc(shm->num_levels, sizeof(pthread_t));
+    level_args = calloc(shm->num_levels, sizeof(struct LevelArgs *));
+    exit_threads = calloc(shm->num_exits, sizeof(pthread_t));
+    exit_args = calloc(shm->num_exits, sizeof(struct ExitArgs *));
+    if (entry_threads == NULL || entry_args == NULL || level_threads == NULL ||
+        level_args == NULL || exit_threads == NULL || exit_args == NULL) {
+      perror("calloc threads");
       exit(EXIT_FAILURE);
     }
-    entry_args[i] = args;
-    args->id = i;
-    pthread_t thread;
-    // pass in i
-    pthread_create(&thread, NULL, entry_handler, args);
-    entry_threads[i] = thread;
-  }
-  // create level threads
-  // -------------------------------
-  pthread_t level_threads[NUM_LEVELS];
-  struct LevelArgs *level_args[NUM_LEVELS];
-  for (int i = 0; i < NUM_LEVELS; i++) {
-    struct LevelArgs *args = calloc(1, sizeof(struct LevelArgs));
-    if (args == NULL) {
-      perror("calloc level");
-      exit(EXIT_FAILURE);
+    for (int i = 0; i < shm->num_entrances; i++) {
+      struct EntryArgs *args = calloc(1, sizeof(struct EntryArgs));
+      if (args == NULL) {
+        perror("calloc entry");
+        exit(EXIT_FAILURE);
+      }
+      entry_args[i] = args;
+      args->id = i;
+      pthread_t thread;
+      // pass in i
+      pthread_create(&thread, NULL, entry_handler, args);
+      entry_threads[i] = thread;
     }
-    level_args[i] = args;
-    args->id = i;
-    pthread_t thread;
-    // pass in i
-    pthread_create(&thread, NULL, level_handler, args);
-    level_threads[i] = thread;
-  }
-  // create exit threads
-  // -------------------------------
-  pthread_t exit_threads[NUM_EXITS];
-  struct ExitArgs *exit_args[NUM_EXITS];
-  for (int i = 0; i < NUM_EXITS; i++) {
-    struct ExitArgs *args = calloc(1, sizeof(struct ExitArgs));
-    if (args == NULL) {
-      perror("calloc exit");
-      exit(EXIT_FAILURE);
+    // create level threads
+    // -------------------------------
+    for (int i = 0; i < shm->num_levels; i++) {
+      struct LevelArgs *args = calloc(1, sizeof(struct LevelArgs));
+      if (args == NULL) {
+        perror("calloc level");
+        exit(EXIT_FAILURE);
+      }
+      level_args[i] = args;
+      args->id = i;
+      pthread_t thread;
+      // pass in i
+      pthread_create(&thread, NULL, level_handler, args);
+      level_threads[i] = thread;
+    }
+    // create exit threads
+    // -------------------------------
+    for (int i = 0; i < shm->num_exits; i++) {
+      struct ExitArgs *args = calloc(1, sizeof(struct ExitArgs));
+      if (args == NULL) {
+        perror("calloc exit");
+        exit(EXIT_FAILURE);
+      }
+      exit_args[i] = args;
+      args->id = i;
+      pthread_t thread;
+      // pass in i
+      pthread_create(&thread, NULL, exit_handler, args);
+      exit_threads[i] = thread;
     }
-    exit_args[i] = args;
-    args->id = i;
-    pthread_t thread;
-    // pass in i
-    pthread_create(&thread, NULL, exit_handler, args);
-    exit_threads[i] = thread;
   }
 
-  pthread_t display_thread = NULL;
+  pthread_t display_thread = 0;
   // don't run the display if we don't want it
   if (argc < 2 || strcmp(argv[1], "nodisp") != 0) {
     ManDisplayData display_data;
-    display_data.ht = capacity_ht;
-    display_data.ht_mutex = &capacity_mutex;
+    display_data.occupancy = occupancy;
     display_data.shm = shm;
     display_data.billing_total = &total_bill;
     display_data.run = &run;
@@ -569,42 +706,47 @@ int main(int argc, char *argv[]) {
   pthread_create(&input_thread, NULL, input_handler, NULL);
 
   pthread_join(input_thread, NULL);   // wait for input thread to finish
-  pthread_join(display_thread, NULL); // wait for display thread to finish
+  if (display_thread) {
+    pthread_join(display_thread, NULL); // wait for display thread to finish
+  }
 
   printf("Exiting...\n");
 
-  // signal all the possible waitings after input thread
-  int num_lprs = NUM_ENTRANCES + NUM_LEVELS + NUM_EXITS;
-  for (int i = 0; i < num_lprs; i++) {
-    if (i < NUM_ENTRANCES) {
-      pthread_mutex_lock(&shm->entrances[i].lpr.mutex);
-      pthread_cond_broadcast(&shm->entrances[i].lpr.condition);
-      pthread_mutex_unlock(&shm->entrances[i].lpr.mutex);
-    } else if (i < NUM_ENTRANCES + NUM_LEVELS) {
-      pthread_mutex_lock(&shm->levels[i - NUM_ENTRANCES].lpr.mutex);
-      pthread_cond_broadcast(&shm->levels[i - NUM_ENTRANCES].lpr.condition);
-      pthread_mutex_unlock(&shm->levels[i - NUM_ENTRANCES].lpr.mutex);
-    } else {
-      pthread_mutex_lock(&shm->exits[i - NUM_ENTRANCES - NUM_LEVELS].lpr.mutex);
-      pthread_cond_broadcast(
-          &shm->exits[i - NUM_ENTRANCES - NUM_LEVELS].lpr.condition);
-      pthread_mutex_unlock(
-          &shm->exits[i - NUM_ENTRANCES - NUM_LEVELS].lpr.mutex);
+  if (reactor != NULL) {
+    stop_reactor(reactor);
+  } else {
+    // signal all the possible waitings after input thread
+    for (int i = 0; i < shm->num_entrances; i++) {
+      lpr_wake(&shm->entrances[i].lpr);
+    }
+    for (int i = 0; i < shm->num_levels; i++) {
+      lpr_wake(&shm->levels[i].lpr);
+    }
+    for (int i = 0; i < shm->num_exits; i++) {
+      lpr_wake(&shm->exits[i].lpr);
     }
-  }
 
-  // wait for threads to finish and clean up their resources
-  for (int i = 0; i < NUM_ENTRANCES; i++) {
-    pthread_join(entry_threads[i], NULL);
-    free(entry_args[i]);
-  }
+    // wait for threads to finish and clean up their resources
+    for (int i = 0; i < shm->num_entrances; i++) {
+      pthread_join(entry_threads[i], NULL);
+      free(entry_args[i]);
+    }
 
-  for (int i = 0; i < NUM_LEVELS; i++) {
-    pthread_join(level_threads[i], NULL);
-    free(level_args[i]);
-  }
-  for (int i = 0; i < NUM_EXITS; i++) {
-    pthread_join(exit_threads[i], NULL);
-    free(exit_args[i]);
+    for (int i = 0; i < shm->num_levels; i++) {
+      pthread_join(level_threads[i], NULL);
+      free(level_args[i]);
+    }
+    for (int i = 0; i < shm->num_exits; i++) {
+      pthread_join(exit_threads[i], NULL);
+      free(exit_args[i]);
+    }
+    free(entry_threads);
+    free(entry_args);
+    free(level_threads);
+    free(level_args);
+    free(exit_threads);
+    free(exit_args);
   }
+  occ_destroy(occupancy);
+  journal_close(journal, false);
 }
\ No newline at end of file
@@ -24,28 +24,40 @@ pthread_mutex_t used_threads_mutex; // mutex for used_threads
 NumberPlates *plates; // Linked list of number plates
 pthread_mutex_t plate_mutex = PTHREAD_MUTEX_INITIALIZER; // mutex for plate
 
+journal_t *journal; // device events, for journal_read
+
 // CAR UTILITIES
 // ----------------------------------------------------
 void wait_at_gate(struct Boomgate *gate) {
   // wait for exit gate to be open
-  pthread_mutex_lock(&gate->mutex);
-  while (gate->status != 'O') {
-    pthread_cond_wait(&gate->condition, &gate->mutex);
-  }
-  pthread_mutex_unlock(&gate->mutex);
+  gate_wait(gate, "O", NULL);
 }
 
-void send_licence_plate(char *plate, struct LPR *lpr) {
-  pthread_mutex_lock(&lpr->mutex);
-  // wait for level lpr to be free (cleared by manager)
-  while (lpr->plate[0] != '\0') {
-    pthread_cond_wait(&lpr->condition, &lpr->mutex);
+// returns the plate's sequence number at the lpr
+uint32_t send_licence_plate(struct SharedMemory *shm, plate_t plate,
+                            enum JournalDevice device, int index) {
+  struct LPR *lpr;
+  int bell;
+  if (device == JOURNAL_ENTRANCE) {
+    lpr = &shm->entrances[index].lpr;
+    bell = SHM_BELL_ENTRANCE(shm, index);
+  } else if (device == JOURNAL_LEVEL) {
+    lpr = &shm->levels[index].lpr;
+    bell = SHM_BELL_LEVEL(shm, index);
+  } else {
+    lpr = &shm->exits[index].lpr;
+    bell = SHM_BELL_EXIT(shm, index);
   }
-  // write the car's plate to the level lpr
-  memccpy(lpr->plate, plate, 0, 6);
-  // broadcast to threads waiting on the level lpr and unlock mutex
-  pthread_cond_broadcast(&lpr->condition);
-  pthread_mutex_unlock(&lpr->mutex);
+  char chars[PLATE_LEN];
+  plate_to_chars(plate, chars);
+  // journalled first so it's always before the manager reading it, the time
+  // from here to the manager reading it includes waiting for room
+  journal_log(journal, JOURNAL_LPR_ARRIVED, device, index, plate, 0, 0);
+  // waits for room at the lpr (cleared by manager)
+  uint32_t seq = lpr_send(lpr, chars);
+  // for a manager serving every LPR from a few threads
+  doorbell_ring(shm->doorbell, bell);
+  return seq;
 }
 
 // car is at front of queue
@@ -53,21 +65,22 @@ int attempt_entry(ct_data *car_data) {
   // wait 2ms
   delay_ms(2);
   // signal LPR on the shared memory
-  struct Entrance *entrance =
-      &car_data->shm->entrances[car_data->entry_queue->id];
-  send_licence_plate(car_data->plate, &entrance->lpr);
+  int entrance_id = car_data->entry_queue->id;
+  struct Entrance *entrance = &car_data->shm->entrances[entrance_id];
+  uint32_t seq = send_licence_plate(car_data->shm, car_data->plate,
+                                    JOURNAL_ENTRANCE, entrance_id);
   int level_id; // index (0-indexed) of level to travel to
 
-  // wait on the entrance sign
-  pthread_mutex_lock(&entrance->sign.mutex);
-  while (entrance->sign.display == '\0') {
-    pthread_cond_wait(&entrance->sign.condition, &entrance->sign.mutex);
-  }
-  char display = entrance->sign.display;
-  pthread_mutex_unlock(&entrance->sign.mutex);
+  // wait for the manager to be done with the cars before, then the sign is
+  // for us
+  lpr_wait_turn(&entrance->lpr, seq);
+  int sign_level;
+  char display = sign_wait(&entrance->sign, &sign_level);
+  journal_log(journal, JOURNAL_SIGN_SEEN, JOURNAL_ENTRANCE, entrance_id,
+              car_data->plate, display, sign_level);
 
-  if (display > '0' && display <= '9') { // level number
-    level_id = display - '1';            // convert to level index
+  if (sign_shows_level(display)) { // level number
+    level_id = sign_level - 1;     // convert to level index
     // wait at gate if given a level
     wait_at_gate(&entrance->gate);
   } else {
@@ -77,7 +90,7 @@ int attempt_entry(ct_data *car_data) {
   // remove self from queue
   // safe to do this because we know the car is at the front of the queue,
   // and has been assigned a level so the entry process is complete
-  queue_pop(car_data->entry_queue);
+  iqueue_pop(car_data->entry_queue);
   return level_id;
 }
 
@@ -85,7 +98,7 @@ void park_car(ct_data *car_data, int level_id) {
   // travel to the level (10ms)
   delay_ms(10);
   // signal the level that the car is there
-  send_licence_plate(car_data->plate, &car_data->shm->levels[level_id].lpr);
+  send_licence_plate(car_data->shm, car_data->plate, JOURNAL_LEVEL, level_id);
 
   // stay parked for 100-1000ms
   rand_delay_ms(100, MAX_PARK_TIME, &rand_mutex);
@@ -93,15 +106,17 @@ void park_car(ct_data *car_data, int level_id) {
 
 void exit_car(ct_data *car_data, int level_id) {
   // signal the level lpr
-  send_licence_plate(car_data->plate, &car_data->shm->levels[level_id].lpr);
+  send_licence_plate(car_data->shm, car_data->plate, JOURNAL_LEVEL, level_id);
   // travel to the exit (10ms)
   delay_ms(10);
   // get random exit
   pthread_mutex_lock(&rand_mutex);
-  int exit = rand() % NUM_EXITS;
+  int exit = rand() % car_data->shm->num_exits;
   pthread_mutex_unlock(&rand_mutex);
-  // trigger exit lpr
-  send_licence_plate(car_data->plate, &car_data->shm->exits[exit].lpr);
+  // trigger exit lpr, then wait for the manager to get to us
+  struct LPR *lpr = &car_data->shm->exits[exit].lpr;
+  lpr_wait_turn(lpr, send_licence_plate(car_data->shm, car_data->plate,
+                                         JOURNAL_EXIT, exit));
   // wait for gate to open
   wait_at_gate(&car_data->shm->exits[exit].gate);
   // we are all done
@@ -109,42 +124,27 @@ void exit_car(ct_data *car_data, int level_id) {
 }
 
 void *car_handler(void *arg) {
-  Queue *car_queue = (Queue *)arg;
-  while (run) {
-    // get the next car from the queue and pop it
-    QItem *car_item = NULL;
-    pthread_mutex_lock(&car_queue->mutex);
-    while (car_item == NULL && run) {
-      pthread_cond_wait(&car_queue->condition, &car_queue->mutex);
-      car_item = unsafe_queue_pop_return(
-          car_queue); // get the item from the queue, we need to free later
-    }
-    pthread_mutex_unlock(&car_queue->mutex);
-    if (!run) {
-      break;
-    }
+  Ring *car_queue = (Ring *)arg;
+  ct_data car;
+  // wait for the next car, only this thread is woken for it
+  while (ring_pop(car_queue, &car)) {
     // we got a car
     pthread_mutex_lock(&used_threads_mutex);
     used_threads++;
     pthread_mutex_unlock(&used_threads_mutex);
-    ct_data *data = (ct_data *)car_item->value;
-    // add self to entrance queue (size 7 as 6 characters on the plate + pad
-    // with null)
-    queue_push(data->entry_queue, data->plate, 7);
-    // wait until front of queue
-    // while not at front of queue
-    pthread_mutex_lock(&data->entry_queue->mutex);
-    while (strcmp(queue_peek(data->entry_queue)->value, data->plate) != 0) {
-      pthread_cond_wait(&data->entry_queue->condition,
-                        &data->entry_queue->mutex);
-    }
-    pthread_mutex_unlock(&data->entry_queue->mutex);
+    ct_data *data = &car;
+    // add self to entrance queue
+    // (links the car in, no copy)
+    iqueue_push(data->entry_queue, &data->node);
+    // wait until front of queue, only woken when the car in front leaves
+    iqueue_wait_front(data->entry_queue, &data->node);
 
     // Assigned level, or -1 if not allowed
     int level_id = attempt_entry(data);
 
-    if (level_id >= NUM_LEVELS) {
-      perror("Error: level_id is greater than or equal to NUM_LEVELS\n");
+    if (level_id >= data->shm->num_levels) {
+      perror("Error: level_id is greater than or equal to the number of "
+             "levels\n");
       exit(EXIT_FAILURE);
     }
     // if level_id is negative, then the car is not allowed
@@ -155,15 +155,13 @@ void *car_handler(void *arg) {
       pthread_mutex_lock(&used_threads_mutex);
       used_threads--;
       pthread_mutex_unlock(&used_threads_mutex);
-      free(data);
-      free(car_item);
       continue; // ready for next car
     }
 
     pthread_mutex_lock(&rand_mutex);
     int listen = rand() % 2;
     if (!listen) {
-      level_id = rand() % NUM_LEVELS;
+      level_id = rand() % data->shm->num_levels;
     }
     pthread_mutex_unlock(&rand_mutex);
 
@@ -176,8 +174,6 @@ void *car_handler(void *arg) {
 
     // add licence plate back in the available pool
     add_plate(plates, data->plate);
-    free(data);
-    free(car_item);
 
     // update used threads
     pthread_mutex_lock(&used_threads_mutex);
@@ -190,11 +186,12 @@ void *car_handler(void *arg) {
 // Simulate temperature
 void *temp_simulator(void *arg) {
   struct SharedMemory *shm = (struct SharedMemory *)arg;
-  int16_t randTempChange;  // a random temperature change to alter temp
-  int16_t fixedTempChange; // a specific temperature (e.g from fire to no fire)
-  int lastFireType;
+  int16_t randTempChange = 0;  // a random temperature change to alter temp
+  int16_t fixedTempChange = 0; // a specific temperature (e.g from fire to no
+                               // fire)
+  int lastFireType = FIRE_OFF;
   while (run) {
-    for (int i = 0; i < NUM_LEVELS; i++) {
+    for (int i = 0; i < shm->num_levels; i++) {
       if (fire == FIRE_OFF) // no fire
       {
         // generate a random temperature between 25 and 32
@@ -234,31 +231,31 @@ void *temp_simulator(void *arg) {
   return NULL;
 }
 
+// stop function for the gates, they're needed until the last car has left
+static bool gates_done(void) { return used_threads == 0 && !run; }
+
 void *gate_handler(void *arg) {
-  struct Boomgate *gate = (struct Boomgate *)arg;
+  gt_data *data = (gt_data *)arg;
+  struct Boomgate *gate = data->gate;
   while (run || used_threads > 0) {
-    pthread_mutex_lock(&gate->mutex);
-    while (!(gate->status == 'R' || gate->status == 'L') &&
-           (used_threads > 0 || run)) {
-      pthread_cond_wait(&gate->condition, &gate->mutex);
-    }
-    pthread_mutex_unlock(&gate->mutex);
-    if (used_threads == 0 && !run) {
+    char status = gate_wait(gate, "RL", gates_done);
+    if (gates_done()) {
       break;
     }
     // gate is now 'R' or 'L
-    if (gate->status == 'R') {
+    char moved;
+    if (status == 'R') {
       delay_ms(10); // raising takes 10ms
-      pthread_mutex_lock(&gate->mutex);
-      gate->status = 'O';
-      pthread_cond_broadcast(&gate->condition);
-    } else if (gate->status == 'L') {
+      moved = 'O';
+    } else if (status == 'L') {
       delay_ms(10); // closing takes 10ms
-      pthread_mutex_lock(&gate->mutex);
-      gate->status = 'C';
-      pthread_cond_broadcast(&gate->condition);
+      moved = 'C';
+    } else {
+      continue;
     }
-    pthread_mutex_unlock(&gate->mutex);
+    journal_log(journal, JOURNAL_GATE_MOVED, data->device, data->index, 0,
+                moved, 0);
+    gate_set(gate, moved);
   }
   // stopped running and all car threads alive
   return NULL;
@@ -295,8 +292,47 @@ void *input_handler() {
 
 int main(int argc, char *argv[]) {
   srand(time(NULL));
+  // size the car park from the command line, anything not given comes from
+  // config.h. The manager and fire alarm read it back from the shared memory
+  struct ShmTopology topology = SHM_DEFAULT_TOPOLOGY;
+  int opt;
+  while ((opt = getopt(argc, argv, "e:x:l:c:")) != -1) {
+    switch (opt) {
+    case 'e':
+      topology.num_entrances = atoi(optarg);
+      break;
+    case 'x':
+      topology.num_exits = atoi(optarg);
+      break;
+    case 'l':
+      topology.num_levels = atoi(optarg);
+      break;
+    case 'c':
+      topology.level_capacity = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr,
+              "Usage: %s [-e entrances] [-x exits] [-l levels] "
+              "[-c level_capacity] [nodisp]\n",
+              argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  bool display = optind >= argc || strcmp(argv[optind], "nodisp") != 0;
   // initialise the shared memory
-  struct SharedMemory *shm = create_shm(SHM_NAME);
+  struct SharedMemory *shm = create_shm(SHM_NAME, &topology, SHM_MAP_FLAGS);
+  // and the journal, left behind at exit so journal_read can go through it
+  journal = journal_create(JOURNAL_NAME, JOURNAL_RECORDS);
+  if (journal == NULL) {
+    perror("Error creating the journal, carrying on without it");
+  }
+  int num_entrances = shm->num_entrances;
+  int num_gates = shm->num_entrances + shm->num_exits;
+  // enough car threads for every space, with plenty to spare for waiting
+  int num_car_threads =
+      shm->num_levels * shm->level_capacity * CAR_THREADS_PER_SPACE;
+  // number of new cars that can be waiting for a car thread
+  size_t car_queue_size = num_car_threads;
 
   // protect rand with a mutex
   pthread_mutex_init(&rand_mutex, NULL);
@@ -307,13 +343,28 @@ int main(int argc, char *argv[]) {
   // read allowed plates into a linked list
   // doesn't need to be a hashtable, as we are just grabbing a random plate
   // manager has the hashtable
-  plates = list_from_file("plates.txt", &rand_mutex);
+  // comes from the same compiled whitelist the manager maps
+  wl_t *whitelist = wl_load("plates.txt", "plates.wl");
+  if (whitelist == NULL) {
+    perror("Error loading plates.txt");
+    exit(EXIT_FAILURE);
+  }
+  plates = list_from_whitelist(whitelist, &rand_mutex);
+  wl_close(whitelist);
   printf("Loaded %zu plates\n", plates->count);
 
   // create queues for each entry
-  Queue *entry_queues[NUM_ENTRANCES];
-  for (int i = 0; i < NUM_ENTRANCES; i++) {
-    entry_queues[i] = queue_create(i);
+  IQueue **entry_queues = calloc(num_entrances, sizeof(IQueue *));
+  QueueStats **entry_stats = calloc(num_entrances, sizeof(QueueStats *));
+  if (entry_queues == NULL || entry_stats == NULL) {
+    perror("Error allocating entry queues");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < num_entrances; i++) {
+    entry_queues[i] = iqueue_create(i);
+    // record how long cars wait at each entrance and how deep it gets
+    entry_stats[i] = qstats_create(ENTRY_QUEUE_SAMPLE_MS);
+    iqueue_set_stats(entry_queues[i], entry_stats[i]);
   }
 
   // handle any user input (q) to quit
@@ -321,34 +372,48 @@ int main(int argc, char *argv[]) {
   pthread_create(&input_thread, NULL, input_handler, NULL);
 
   // handle the (limited) display for the simulator
-  pthread_t display_thread;
+  pthread_t display_thread = 0; // only started without nodisp
   SimDisplayData display_data;
-  if (argc < 2 || strcmp(argv[1], "nodisp") != 0) {
+  if (display) {
     printf("Starting Sim Display\n");
     display_data.num_cars = &used_threads;
     display_data.entry_queues = entry_queues;
+    display_data.num_entrances = num_entrances;
     display_data.running = &run;
     display_data.available_plates = &plates->count;
     pthread_create(&display_thread, NULL, sim_display_handler, &display_data);
   }
 
-  Queue *car_queue = queue_create(0);
+  Ring *car_queue = ring_create(car_queue_size, sizeof(ct_data));
+  if (car_queue == NULL) {
+    perror("Error creating car queue");
+    exit(EXIT_FAILURE);
+  }
 
   // threads who's jobs are to just look at boomgates and open/close them
   // depending on the manager
-  pthread_t gate_threads[NUM_ENTRANCES + NUM_EXITS];
-  for (int i = 0; i < NUM_ENTRANCES + NUM_EXITS; i++) {
-    if (i < NUM_ENTRANCES) {
-      struct Boomgate *gate = &shm->entrances[i].gate;
-      pthread_create(&gate_threads[i], NULL, gate_handler, gate);
+  pthread_t *gate_threads = calloc(num_gates, sizeof(pthread_t));
+  gt_data *gates = calloc(num_gates, sizeof(gt_data));
+  pthread_t *car_threads = calloc(num_car_threads, sizeof(pthread_t));
+  // cars made while every thread was busy and the queue was full, handed over
+  // together as soon as there's room
+  ct_data *pending = calloc(car_queue_size, sizeof(ct_data));
+  if (gate_threads == NULL || gates == NULL || car_threads == NULL ||
+      pending == NULL) {
+    perror("Error allocating threads");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < num_gates; i++) {
+    if (i < num_entrances) {
+      gates[i] = (gt_data){&shm->entrances[i].gate, JOURNAL_ENTRANCE, i};
     } else {
-      struct Boomgate *gate = &shm->exits[i - NUM_ENTRANCES].gate;
-      pthread_create(&gate_threads[i], NULL, gate_handler, gate);
+      int exit = i - num_entrances;
+      gates[i] = (gt_data){&shm->exits[exit].gate, JOURNAL_EXIT, exit};
     }
+    pthread_create(&gate_threads[i], NULL, gate_handler, &gates[i]);
   }
 
-  pthread_t car_threads[CAR_THREADS];
-  for (int i = 0; i < CAR_THREADS; i++) {
+  for (int i = 0; i < num_car_threads; i++) {
     // create a car thread
     pthread_create(&car_threads[i], NULL, car_handler, car_queue);
   }
@@ -357,41 +422,36 @@ int main(int argc, char *argv[]) {
   pthread_t temperature;
   pthread_create(&temperature, NULL, temp_simulator, shm);
 
+  size_t num_pending = 0;
   while (run) {
-    char *plate = random_available_plate(plates);
-    if (plate) {
-      // create a car thread
-      ct_data *data = calloc(1, sizeof(ct_data));
-      if (!data) {
-        perror("Calloc car data");
-        exit(EXIT_FAILURE);
-      }
-      memccpy(data->plate, plate, 0, 7);
+    plate_t plate = num_pending < car_queue_size
+                        ? random_available_plate(plates)
+                        : PLATE_NONE;
+    if (plate != PLATE_NONE) {
+      // make a new car for a car thread
+      ct_data *data = &pending[num_pending++];
+      data->plate = plate;
 
       pthread_mutex_lock(&rand_mutex);
-      data->entry_queue = entry_queues[rand() % NUM_ENTRANCES];
+      data->entry_queue = entry_queues[rand() % num_entrances];
       pthread_mutex_unlock(&rand_mutex);
 
       data->shm = shm;
-      // add the car to the queue
-      queue_push(car_queue, data, sizeof(ct_data));
-      // free our copy of the car, queue_push makes a copy
-      free(data);
     }
-    free(plate); // we don't need the plate anymore
+    // add as many waiting cars to the queue as fit (copied in), in one go
+    size_t pushed = ring_push_n(car_queue, pending, num_pending);
+    num_pending -= pushed;
+    memmove(pending, pending + pushed, num_pending * sizeof(ct_data));
     // wait between 1 and 100 ms before creating new car
     rand_delay_ms(1, 100, &rand_mutex);
   }
   // join the threads
-  // broadcast to the car_queue to wake up all the threads
-  // that might be waiting for a car to enter the queue
-  // and let them know to exit
+  // close the car_queue to wake up all the threads that might be waiting for
+  // a car to enter the queue and let them know to exit
   printf("Attempting To Join Car Threads\n");
-  pthread_mutex_lock(&car_queue->mutex);
-  pthread_cond_broadcast(&car_queue->condition);
-  pthread_mutex_unlock(&car_queue->mutex);
+  ring_close(car_queue);
 
-  for (int i = 0; i < CAR_THREADS; i++) {
+  for (int i = 0; i < num_car_threads; i++) {
     int jres = pthread_join(car_threads[i], NULL);
     if (jres != 0) {
       perror("Error joining thread");
@@ -402,22 +462,20 @@ int main(int argc, char *argv[]) {
   printf("Car Threads Joined, Used Threads = %d\n", used_threads);
   // signal to gate threads
   // they will check that run is false and there are no more cars alive
-  for (int i = 0; i < NUM_ENTRANCES + NUM_EXITS; i++) {
-    if (i < NUM_ENTRANCES) {
-      pthread_mutex_lock(&shm->entrances[i].gate.mutex);
-      pthread_cond_broadcast(&shm->entrances[i].gate.condition);
-      pthread_mutex_unlock(&shm->entrances[i].gate.mutex);
+  for (int i = 0; i < num_gates; i++) {
+    if (i < num_entrances) {
+      gate_wake(&shm->entrances[i].gate);
     } else {
-      pthread_mutex_lock(&shm->exits[i - NUM_ENTRANCES].gate.mutex);
-      pthread_cond_broadcast(&shm->exits[i - NUM_ENTRANCES].gate.condition);
-      pthread_mutex_unlock(&shm->exits[i - NUM_ENTRANCES].gate.mutex);
+      gate_wake(&shm->exits[i - num_entrances].gate);
     }
   }
 
   pthread_join(input_thread, NULL);
   printf("Input Thread Joined\n");
-  pthread_join(display_thread, NULL);
-  printf("Display Thread Joined\n");
+  if (display_thread) {
+    pthread_join(display_thread, NULL);
+    printf("Display Thread Joined\n");
+  }
   pthread_join(temperature, NULL);
   printf("Temperature Thread Joined\n");
 
@@ -432,7 +490,7 @@ int main(int argc, char *argv[]) {
   printf("Plates Destroyed\n");
 
   // join gate threads
-  for (int i = 0; i < (NUM_ENTRANCES + NUM_EXITS); i++) {
+  for (int i = 0; i < num_gates; i++) {
     int jres = pthread_join(gate_threads[i], NULL);
     if (jres != 0) {
       perror("Error joining thread");
@@ -445,12 +503,32 @@ int main(int argc, char *argv[]) {
   pthread_mutex_destroy(&rand_mutex);
   pthread_mutex_destroy(&plate_mutex);
   pthread_mutex_destroy(&used_threads_mutex);
+  // how the entrances coped, for sizing the number of entrances
+  for (int i = 0; i < num_entrances; i++) {
+    QueueStats stats;
+    qstats_read(entry_stats[i], &stats);
+    printf("EntryQ %d: %lu cars, mean wait %lu us, p99 < %lu us, "
+           "max depth %lu\n",
+           i, (unsigned long)stats.popped,
+           (unsigned long)(stats.popped ? stats.wait_us_total / stats.popped
+                                        : 0),
+           (unsigned long)qstats_wait_percentile_us(&stats, 0.99),
+           (unsigned long)stats.max_depth);
+  }
   // destroy the queues
-  for (int i = 0; i < NUM_ENTRANCES; i++) {
-    destroy_queue(entry_queues[i]);
+  for (int i = 0; i < num_entrances; i++) {
+    destroy_iqueue(entry_queues[i]);
+    qstats_destroy(entry_stats[i]);
   }
-  destroy_queue(car_queue);
+  free(entry_queues);
+  free(entry_stats);
+  free(gate_threads);
+  free(gates);
+  free(car_threads);
+  free(pending);
+  ring_destroy(car_queue);
   printf("Entry Queue Destroyed\n");
+  journal_close(journal, false);
 
   // destroy the shared memory after use
   // can't actually have this as manager may still be using it so it locks up
@@ -1,10 +1,14 @@
 #pragma once
 #include "config.h"
+#include "journal.h"
+#include "plate.h"
 #include "queue.h"
 #include "shm_parking.h"
 
-// number of possible car threads - most sleeping so more than enough
-#define CAR_THREADS (NUM_LEVELS * LEVEL_CAPACITY * 2)
+// car threads per parking space - most sleeping so more than enough
+#define CAR_THREADS_PER_SPACE 2
+// how often each entry queue's depth is recorded (ms)
+#define ENTRY_QUEUE_SAMPLE_MS 100
 
 // Types of fires - DEBUG ONLY, not used in real version
 #define FIRE_ROR 1
@@ -15,11 +19,19 @@
 // ==============
 
 typedef struct car_thread_data {
-  Queue *entry_queue;       // pointer to the entry queue
-  char plate[7];            // number plate of the car
+  IQueue *entry_queue;      // pointer to the entry queue
+  QNode node;               // link in the entry queue while the car is in it
+  plate_t plate;            // number plate of the car
   struct SharedMemory *shm; // pointer to the shared memory
 } ct_data;
 
+// A gate for gate_handler, and which one it is for the journal
+typedef struct gate_thread_data {
+  struct Boomgate *gate;
+  enum JournalDevice device; // JOURNAL_ENTRANCE or JOURNAL_EXIT
+  int index;
+} gt_data;
+
 /*
 Main thread handler function for cars
 
@@ -52,7 +64,7 @@ Simulate the temperature changing every 2ms
 void *temp_simulator(void *arg);
 
 /*
-Handle the asynchronous opening and closing of the given boomgate
+Handle the asynchronous opening and closing of the given boomgate (gt_data)
 
   WHEN the gate is set to R: wait 20ms, then set the gate to O
 
@@ -67,12 +79,14 @@ void *gate_handler(void *arg);
 void wait_at_gate(struct Boomgate *gate);
 
 /*
-Send the given plate to the given plate reader
-- Waits for the plate reader to be NULL before sending
-- Sets the plate reader to the given plate, broadcasts to all threads and
-returns
+Send the given plate to the plate reader of the given device and index
+- Waits for room at the plate reader (empty, or a free slot in its ring)
+- Puts the given plate on it, wakes the manager (and rings its doorbell) and
+returns the plate's sequence number (for lpr_wait_turn)
+- Journals it against the device and index
 */
-void send_licence_plate(char *plate, struct LPR *lpr);
+uint32_t send_licence_plate(struct SharedMemory *shm, plate_t plate,
+                            enum JournalDevice device, int index);
 
 /*
   Attempt to gain entry to the carpark
@@ -0,0 +1,34 @@
+#include "whitelist.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+Compile a whitelist of plates (one per line) into the binary image the
+manager and simulator map at startup
+
+  ./build/bin/whitelist_compile [plates.txt] [plates.wl] [filter_bits]
+
+filter_bits is the Bloom filter bits per plate (0 for no filter), more bits
+turn away more of the plates that aren't on the list before the table lookup
+
+The manager and simulator recompile the image themselves if it is missing or
+older than plates.txt, this just does it ahead of time (e.g. for a huge list)
+*/
+int main(int argc, char *argv[]) {
+  char *text_path = argc > 1 ? argv[1] : "plates.txt";
+  char *image_path = argc > 2 ? argv[2] : "plates.wl";
+  size_t filter_bits = argc > 3 ? strtoul(argv[3], NULL, 10) : WL_FILTER_BITS;
+  if (!wl_compile(text_path, image_path, filter_bits)) {
+    perror("Error compiling whitelist");
+    return EXIT_FAILURE;
+  }
+  wl_t *wl = wl_open(image_path);
+  if (wl == NULL) {
+    fprintf(stderr, "Error opening compiled whitelist %s\n", image_path);
+    return EXIT_FAILURE;
+  }
+  printf("Compiled %zu plates from %s into %s\n", wl_size(wl), text_path,
+         image_path);
+  wl_close(wl);
+  return EXIT_SUCCESS;
+}
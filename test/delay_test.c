@@ -0,0 +1,183 @@
+#include "delay.h"
+#include "testing.h"
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_TIMERS 1000
+
+struct fired {
+  uint64_t armed_at; // us
+  int ms;
+  uint64_t at; // us, when it ran
+  int count;
+  timer_wheel_t *w;
+  wheel_timer_t timer;
+};
+
+static struct fired timers[NUM_TIMERS];
+static bool cancelled[NUM_TIMERS]; // for many, before they could run
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Wait up to ms for *count to get to want
+static bool wait_for(int *count, int want, int ms) {
+  for (int i = 0; i < ms; i++) {
+    if (__atomic_load_n(count, __ATOMIC_ACQUIRE) >= want)
+      return true;
+    usleep(1000);
+  }
+  return __atomic_load_n(count, __ATOMIC_ACQUIRE) >= want;
+}
+
+static void fire(void *arg) {
+  struct fired *f = arg;
+  f->at = now_us();
+  __atomic_add_fetch(&f->count, 1, __ATOMIC_RELEASE);
+}
+
+static void arm(timer_wheel_t *w, struct fired *f, int ms) {
+  f->armed_at = now_us();
+  f->ms = ms;
+  wheel_arm(w, &f->timer, ms, fire, f);
+}
+
+// ran once, not early
+static bool on_time(struct fired *f) {
+  return f->count == 1 && f->at - f->armed_at >= (uint64_t)f->ms * 1000;
+}
+
+bool fires(timer_wheel_t *w) {
+  // a timer runs once, after the time it was armed for
+  memset(timers, 0, sizeof(timers));
+  arm(w, &timers[0], 10);
+  bool passed = wait_for(&timers[0].count, 1, 1000);
+  usleep(20000);
+  return passed && on_time(&timers[0]) &&
+         timers[0].at - timers[0].armed_at < 100000;
+}
+
+bool cascades(timer_wheel_t *w) {
+  // timers past the first wheel (64ms) and the second (4096ms) still run on
+  // time once they drop into the first
+  memset(timers, 0, sizeof(timers));
+  arm(w, &timers[0], 70);
+  arm(w, &timers[1], 130);
+  arm(w, &timers[2], 4100);
+  bool passed = wait_for(&timers[2].count, 1, 6000);
+  return passed && on_time(&timers[0]) && on_time(&timers[1]) &&
+         on_time(&timers[2]) && timers[0].at <= timers[1].at &&
+         timers[1].at <= timers[2].at;
+}
+
+bool cancel(timer_wheel_t *w) {
+  // a cancelled timer doesn't run, cancelling it again says it wasn't armed
+  memset(timers, 0, sizeof(timers));
+  arm(w, &timers[0], 10);
+  bool passed = wheel_cancel(w, &timers[0].timer);
+  usleep(30000);
+  return passed && timers[0].count == 0 && !wheel_cancel(w, &timers[0].timer);
+}
+
+bool rearm(timer_wheel_t *w) {
+  // arming an armed timer moves it, it only runs once
+  memset(timers, 0, sizeof(timers));
+  arm(w, &timers[0], 500);
+  arm(w, &timers[0], 5);
+  bool passed = wait_for(&timers[0].count, 1, 400);
+  usleep(600000);
+  return passed && timers[0].count == 1;
+}
+
+static void fire_again(void *arg) {
+  struct fired *f = arg;
+  // armed again from its own callback, until it's run 5 times
+  if (__atomic_add_fetch(&f->count, 1, __ATOMIC_RELEASE) < 5)
+    wheel_arm(f->w, &f->timer, 2, fire_again, f);
+}
+
+bool from_callback(timer_wheel_t *w) {
+  // a callback can arm its own timer again
+  memset(timers, 0, sizeof(timers));
+  timers[0].w = w;
+  wheel_arm(w, &timers[0].timer, 1, fire_again, &timers[0]);
+  bool passed = wait_for(&timers[0].count, 5, 1000);
+  usleep(20000);
+  return passed && timers[0].count == 5;
+}
+
+bool many(timer_wheel_t *w) {
+  // lots of timers up to 200ms off, cancelling every third, the rest all run
+  // once and on time. A cancel can come too late for the shortest ones, then
+  // it says so and they've run
+  memset(timers, 0, sizeof(timers));
+  for (int i = 0; i < NUM_TIMERS; i++)
+    arm(w, &timers[i], (i * 37) % 200);
+  for (int i = 0; i < NUM_TIMERS; i++)
+    cancelled[i] = i % 3 == 0 && wheel_cancel(w, &timers[i].timer);
+  usleep(400000);
+  for (int i = 0; i < NUM_TIMERS; i++) {
+    if (cancelled[i] ? timers[i].count != 0 : !on_time(&timers[i]))
+      return false;
+  }
+  return true;
+}
+
+int main(void) {
+  // Initialise
+  // set color to yellow
+  printf("\033[0;33m");
+  printf("Testing Timer Wheel\n");
+  // reset color
+  printf("\033[0m");
+  timer_wheel_t *w = wheel_start();
+
+  // Run tests
+  setlocale(LC_CTYPE, "");
+  wchar_t cross = 0x00D7;
+  wchar_t check = 0x2713;
+
+  int num_tests = 6;
+  bool (*funcs[6])(timer_wheel_t * w) = {
+      fires,         /*0*/
+      cascades,      /*1*/
+      cancel,        /*2*/
+      rearm,         /*3*/
+      from_callback, /*4*/
+      many,          /*5*/
+  };
+  int num_passed = 0;
+  for (int i = 0; i < num_tests; i++) {
+    if ((*funcs[i])(w)) {
+      // set color to green
+      printf("\033[0;32m");
+      wprintf(L"%lc Test %d passed\n", check, i);
+      num_passed++;
+    } else {
+      // set color to red
+      printf("\033[0;31m");
+      wprintf(L"%lc Test %d failed\n", cross, i);
+    }
+  }
+
+  if (num_passed == num_tests) {
+    // set color to green
+    printf("\033[0;32m");
+    printf("---------------------\n");
+    printf("All Timer Wheel Tests passed\n");
+    // reset color
+    printf("\033[0m");
+  } else {
+    // set color to red
+    printf("\033[0;31m");
+    printf("Passed %d/%d tests\n", num_passed, num_tests);
+    // reset color
+    printf("\033[0m");
+  }
+
+  wheel_stop(w);
+  return 0;
+}
@@ -0,0 +1,199 @@
+#include "futex.h"
+#include "testing.h"
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define NUM_WAITERS 4
+#define PING_PONGS 10000
+
+bool store_load(FutexWord *w) {
+  // values come back out, bits above the value are masked off (and don't
+  // touch the kick count)
+  fword_store(w, 42);
+  uint32_t word = fword_load(w);
+  if (FWORD_VALUE(word) != 42)
+    return false;
+  fword_store(w, 0xFF000001);
+  return fword_load(w) == ((word & ~FWORD_VALUE_MASK) | 1);
+}
+
+bool cas(FutexWord *w) {
+  // only swaps from the word it was given
+  fword_store(w, 1);
+  uint32_t word = fword_load(w);
+  if (!fword_cas(w, word, 2) || FWORD_VALUE(fword_load(w)) != 2)
+    return false;
+  return !fword_cas(w, word, 3) && FWORD_VALUE(fword_load(w)) == 2;
+}
+
+bool wait_changed(FutexWord *w) {
+  // waiting on an old word returns straight away
+  fword_store(w, 1);
+  uint32_t word = fword_load(w);
+  fword_store(w, 2);
+  fword_wait(w, word);
+  return FWORD_VALUE(fword_load(w)) == 2;
+}
+
+static void *wait_for_value(void *arg) {
+  FutexWord *w = arg;
+  uint32_t word;
+  while (FWORD_VALUE(word = fword_load(w)) != 7)
+    fword_wait(w, word);
+  return NULL;
+}
+
+bool store_wakes(FutexWord *w) {
+  // a store wakes every waiter
+  fword_store(w, 0);
+  pthread_t threads[NUM_WAITERS];
+  for (int i = 0; i < NUM_WAITERS; i++)
+    pthread_create(&threads[i], NULL, wait_for_value, w);
+  // let them get to sleep
+  while (__atomic_load_n(&w->waiters, __ATOMIC_SEQ_CST) < NUM_WAITERS)
+    sched_yield();
+  fword_store(w, 7);
+  for (int i = 0; i < NUM_WAITERS; i++)
+    pthread_join(threads[i], NULL);
+  return w->waiters == 0;
+}
+
+static volatile int kicked_stop;
+
+static void *wait_for_stop(void *arg) {
+  FutexWord *w = arg;
+  uint32_t word;
+  while (!kicked_stop && FWORD_VALUE(word = fword_load(w)) == 5)
+    fword_wait(w, word);
+  return NULL;
+}
+
+bool kick(FutexWord *w) {
+  // a kick wakes waiters without changing the value
+  fword_store(w, 5);
+  kicked_stop = 0;
+  pthread_t thread;
+  pthread_create(&thread, NULL, wait_for_stop, w);
+  while (__atomic_load_n(&w->waiters, __ATOMIC_SEQ_CST) < 1)
+    sched_yield();
+  kicked_stop = 1;
+  fword_kick(w);
+  pthread_join(thread, NULL);
+  return FWORD_VALUE(fword_load(w)) == 5;
+}
+
+bool timed_wait(FutexWord *w) {
+  // a timed wait on a word nobody changes gives up
+  fword_store(w, 9);
+  uint32_t word = fword_load(w);
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  fword_timedwait(w, word, 5000000); // 5ms
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  long waited_us = (end.tv_sec - start.tv_sec) * 1000000 +
+                   (end.tv_nsec - start.tv_nsec) / 1000;
+  return waited_us >= 4000 && FWORD_VALUE(fword_load(w)) == 9;
+}
+
+bool kick_then_store(FutexWord *w) {
+  // a waiter that loaded the word before a kick and a store of the same
+  // value still sees it changed, and doesn't sleep through the kick
+  fword_store(w, 3);
+  uint32_t word = fword_load(w);
+  fword_kick(w);
+  fword_store(w, 3);
+  if (fword_load(w) == word)
+    return false;
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  fword_timedwait(w, word, 1000000000); // 1s, if it sleeps at all
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  long waited_us = (end.tv_sec - start.tv_sec) * 1000000 +
+                   (end.tv_nsec - start.tv_nsec) / 1000;
+  return waited_us < 500000 && FWORD_VALUE(fword_load(w)) == 3;
+}
+
+static void *pong(void *arg) {
+  FutexWord *w = arg;
+  for (uint32_t i = 0; i < PING_PONGS; i++) {
+    // wait for the odd ping then answer with the next even number
+    uint32_t word;
+    while (FWORD_VALUE(word = fword_load(w)) != 2 * i + 1)
+      fword_wait(w, word);
+    fword_store(w, 2 * i + 2);
+  }
+  return NULL;
+}
+
+bool ping_pong(FutexWord *w) {
+  // two threads taking turns never miss a wake up
+  fword_store(w, 0);
+  pthread_t thread;
+  pthread_create(&thread, NULL, pong, w);
+  for (uint32_t i = 0; i < PING_PONGS; i++) {
+    fword_store(w, 2 * i + 1);
+    uint32_t word;
+    while (FWORD_VALUE(word = fword_load(w)) != 2 * i + 2)
+      fword_wait(w, word);
+  }
+  pthread_join(thread, NULL);
+  return FWORD_VALUE(fword_load(w)) == 2 * PING_PONGS;
+}
+
+int main(void) {
+  // Initialise
+  // set color to yellow
+  printf("\033[0;33m");
+  printf("Testing Futex Words\n");
+  // reset color
+  printf("\033[0m");
+  FutexWord w = {0, 0};
+
+  // Run tests
+  setlocale(LC_CTYPE, "");
+  wchar_t cross = 0x00D7;
+  wchar_t check = 0x2713;
+
+  int num_tests = 8;
+  bool (*funcs[8])(FutexWord * w) = {
+      store_load,      /*0*/
+      cas,             /*1*/
+      wait_changed,    /*2*/
+      store_wakes,     /*3*/
+      kick,            /*4*/
+      ping_pong,       /*5*/
+      timed_wait,      /*6*/
+      kick_then_store, /*7*/
+  };
+  int num_passed = 0;
+  for (int i = 0; i < num_tests; i++) {
+    if ((*funcs[i])(&w)) {
+      // set color to green
+      printf("\033[0;32m");
+      wprintf(L"%lc Test %d passed\n", check, i);
+      num_passed++;
+    } else {
+      // set color to red
+      printf("\033[0;31m");
+      wprintf(L"%lc Test %d failed\n", cross, i);
+    }
+  }
+
+  if (num_passed == num_tests) {
+    // set color to green
+    printf("\033[0;32m");
+    printf("---------------------\n");
+    printf("All Futex Tests passed\n");
+    // reset color
+    printf("\033[0m");
+  } else {
+    // set color to red
+    printf("\033[0;31m");
+    printf("Passed %d/%d tests\n", num_passed, num_tests);
+    // reset color
+    printf("\033[0m");
+  }
+
+  return 0;
+}
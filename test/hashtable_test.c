@@ -89,6 +89,110 @@ bool remove_item(ht_t *h) {
   return true;
 }
 
+// nth distinct key, KEY0, KEY1, ...
+static void nth_key(size_t n, char *key) { sprintf(key, "KEY%zu", n); }
+
+bool reserve(ht_t *h) {
+  // pre-sizing never shrinks the table or loses items
+  size_t size = htab_size(h);
+  if (!htab_reserve(h, 1000))
+    return false;
+  return htab_capacity(h) > 1000 && htab_size(h) == size &&
+         !htab_resizing(h);
+}
+
+bool incremental_resize(ht_t *h) {
+  // every item can be found (and removed) while a resize is only part done,
+  // and the resize finishes on its own
+  size_t num_items = htab_capacity(h) * 2;
+  char key[24];
+  htab_set_incremental(h, true);
+  bool saw_resizing = false;
+  for (size_t i = 0; i < num_items; i++) {
+    nth_key(i, key);
+    if (!htab_set(h, key, &i, sizeof(size_t)))
+      return false;
+    saw_resizing |= htab_resizing(h);
+    // look back over everything added so far
+    for (size_t j = 0; j <= i; j += 97) {
+      nth_key(j, key);
+      size_t *value = htab_get(h, key);
+      if (value == NULL || *value != j)
+        return false;
+    }
+  }
+  if (!saw_resizing)
+    return false;
+  for (size_t i = 0; i < num_items; i += 2) {
+    nth_key(i, key);
+    htab_remove(h, key);
+  }
+  for (size_t i = 0; i < num_items; i++) {
+    nth_key(i, key);
+    if ((i % 2 == 0) != (htab_get(h, key) == NULL))
+      return false;
+  }
+  return !htab_resizing(h);
+}
+
+bool upsert(ht_t *h) {
+  // a new key comes back zeroed, after that the same slot comes back
+  bool inserted;
+  long long *value = htab_upsert(h, "upsert", sizeof(long long), &inserted);
+  if (value == NULL || !inserted || *value != 0)
+    return false;
+  *value = 42;
+  long long *again = htab_upsert(h, "upsert", sizeof(long long), &inserted);
+  return again == value && !inserted &&
+         *(long long *)htab_get(h, "upsert") == 42;
+}
+
+bool set_in_place(ht_t *h) {
+  // setting a value of the same size doesn't move it
+  long long *value = htab_get(h, "upsert");
+  long long new_value = 7;
+  if (!htab_set(h, "upsert", &new_value, sizeof(long long)))
+    return false;
+  return htab_get(h, "upsert") == value && *value == 7;
+}
+
+bool find_batch(ht_t *h) {
+  // a batch finds the same items as finding them one at a time, including
+  // the ones that aren't there
+  char keys[40][24];
+  char *key_ptrs[40];
+  item_t *items[40];
+  for (size_t i = 0; i < 40; i++) {
+    // every 4th key was never added, the odd KEYs are left from
+    // incremental_resize
+    if (i % 4 == 3)
+      sprintf(keys[i], "MISSING%zu", i);
+    else
+      nth_key(i * 2 + 1, keys[i]);
+    key_ptrs[i] = keys[i];
+  }
+  size_t found = htab_find_batch(h, key_ptrs, 40, items);
+  if (found != 30)
+    return false;
+  for (size_t i = 0; i < 40; i++) {
+    if (items[i] != htab_find(h, keys[i]))
+      return false;
+  }
+  return true;
+}
+
+bool set_hash(ht_t *h) {
+  // the hash can only be swapped while a table is empty
+  if (htab_set_hash(h, djb_hash))
+    return false;
+  ht_t *djb = NULL;
+  djb = htab_create(djb, 4);
+  bool ok = htab_set_hash(djb, djb_hash) && add_items(djb) &&
+            htab_size(djb) == INITIAL_CAPACITY * 2;
+  htab_destroy(djb);
+  return ok;
+}
+
 int main(void) {
   // Initialise
   // set color to yellow
@@ -104,8 +208,8 @@ int main(void) {
   wchar_t cross = 0x00D7;
   wchar_t check = 0x2713;
 
-  int num_tests = 6;
-  bool (*funcs[8])(ht_t * h) = {
+  int num_tests = 14;
+  bool (*funcs[14])(ht_t * h) = {
       add_item,             /*0*/
       add_items,            /*1*/
       find,                 /*2*/
@@ -113,7 +217,13 @@ int main(void) {
       get_overwritten_item, /*4*/
       find_non_existent,    /*5*/
       remove_item,          /*6*/
-      find_removed          /*7*/
+      find_removed,         /*7*/
+      reserve,              /*8*/
+      incremental_resize,   /*9*/
+      upsert,               /*10*/
+      set_in_place,         /*11*/
+      find_batch,           /*12*/
+      set_hash,             /*13*/
   };
   int num_passed = 0;
   for (int i = 0; i < num_tests; i++) {
@@ -0,0 +1,186 @@
+#include "queue.h"
+#include "testing.h"
+
+struct test_struct {
+  int value;
+  QNode node;
+};
+
+static struct test_struct items[3] = {
+    {1, {NULL, NULL, 0}}, {2, {NULL, NULL, 0}}, {3, {NULL, NULL, 0}}};
+
+bool push_items(IQueue *q) {
+  // push a few items, they're linked in rather than copied
+  for (int i = 0; i < 3; i++)
+    iqueue_push(q, &items[i].node);
+  return q->length == 3 && q->head == &items[0].node &&
+         q->tail == &items[2].node;
+}
+
+bool peek_item(IQueue *q) {
+  // the item at the front is the first one pushed
+  QNode *node = iqueue_peek(q);
+  if (node == NULL)
+    return false;
+  return QNODE_ENTRY(node, struct test_struct, node)->value == 1;
+}
+
+bool snapshot_items(IQueue *q) {
+  // copies out the structs the nodes are in, without unlinking them
+  struct test_struct copies[2];
+  if (IQUEUE_SNAPSHOT(q, copies, 2, struct test_struct, node) != 2)
+    return false;
+  return copies[0].value == 1 && copies[1].value == 2 && q->length == 3 &&
+         iqueue_peek(q) == &items[0].node;
+}
+
+bool pop_items(IQueue *q) {
+  // items come back out in order, and are the same items that went in
+  for (int i = 0; i < 3; i++) {
+    QNode *node = iqueue_pop(q);
+    if (node != &items[i].node)
+      return false;
+    if (QNODE_ENTRY(node, struct test_struct, node)->value != i + 1)
+      return false;
+  }
+  return true;
+}
+
+bool is_empty(IQueue *q) {
+  // check if queue is empty, popping from it gives nothing
+  if (q->head || q->tail || q->length)
+    return false;
+  return iqueue_pop(q) == NULL && iqueue_peek(q) == NULL;
+}
+
+bool push_again(IQueue *q) {
+  // a popped item can be pushed again
+  iqueue_push(q, &items[1].node);
+  if (iqueue_peek(q) != &items[1].node || items[1].node.next != NULL)
+    return false;
+  return iqueue_pop(q) == &items[1].node && q->length == 0;
+}
+
+bool record_stats(IQueue *q) {
+  // pushes, pops, waits and the deepest it got are all recorded
+  QueueStats *stats = qstats_create(0);
+  iqueue_set_stats(q, stats);
+  for (int i = 0; i < 3; i++)
+    iqueue_push(q, &items[i].node);
+  for (int i = 0; i < 3; i++)
+    iqueue_pop(q);
+  iqueue_set_stats(q, NULL);
+  QueueStats read;
+  qstats_read(stats, &read);
+  uint64_t waits = 0;
+  for (int i = 0; i < QSTATS_BUCKETS; i++)
+    waits += read.wait_hist[i];
+  // a sample for every push and pop, the last one after emptying it
+  bool passed = read.pushed == 3 && read.popped == 3 && waits == 3 &&
+                read.max_depth == 3 && read.num_samples == 6 &&
+                QSTATS_SAMPLE_DEPTH(read.series[2]) == 3 &&
+                QSTATS_SAMPLE_DEPTH(read.series[5]) == 0 &&
+                qstats_wait_percentile_us(&read, 0.99) > 0;
+  qstats_destroy(stats);
+  return passed && q->stats == NULL;
+}
+
+#define NUM_WAITERS 8
+
+struct waiter {
+  IQueue *q;
+  QNode node;
+  int *order;
+  int *next;
+  int id;
+};
+
+static void *wait_turn(void *arg) {
+  struct waiter *w = arg;
+  iqueue_wait_front(w->q, &w->node);
+  // only the front waiter gets here, so this needs no lock of its own
+  w->order[(*w->next)++] = w->id;
+  iqueue_pop(w->q);
+  return NULL;
+}
+
+bool wait_in_order(IQueue *q) {
+  // waiters get to the front one at a time, in the order they were pushed,
+  // whatever order their threads start in
+  struct waiter waiters[NUM_WAITERS];
+  pthread_t threads[NUM_WAITERS];
+  int order[NUM_WAITERS];
+  int next = 0;
+  for (int i = 0; i < NUM_WAITERS; i++) {
+    waiters[i] = (struct waiter){q, {NULL, NULL, 0}, order, &next, i};
+    iqueue_push(q, &waiters[i].node);
+  }
+  for (int i = NUM_WAITERS - 1; i >= 0; i--)
+    pthread_create(&threads[i], NULL, wait_turn, &waiters[i]);
+  for (int i = 0; i < NUM_WAITERS; i++)
+    pthread_join(threads[i], NULL);
+  for (int i = 0; i < NUM_WAITERS; i++) {
+    if (order[i] != i)
+      return false;
+  }
+  return next == NUM_WAITERS && q->length == 0 && q->head == NULL;
+}
+
+int main(void) {
+  // Initialise
+  // set color to yellow
+  printf("\033[0;33m");
+  printf("Testing Intrusive Queue\n");
+  // reset color
+  printf("\033[0m");
+  IQueue *q = iqueue_create(0);
+
+  // Run tests
+  setlocale(LC_CTYPE, "");
+  wchar_t cross = 0x00D7;
+  wchar_t check = 0x2713;
+
+  int num_tests = 8;
+  bool (*funcs[8])(IQueue * q) = {
+      push_items,     /* 0 */
+      peek_item,      /* 1 */
+      snapshot_items, /* 2 */
+      pop_items,      /* 3 */
+      is_empty,       /* 4 */
+      push_again,     /* 5 */
+      wait_in_order,  /* 6 */
+      record_stats,   /* 7 */
+  };
+  int num_passed = 0;
+  for (int i = 0; i < num_tests; i++) {
+    if ((*funcs[i])(q)) {
+      // set color to green
+      printf("\033[0;32m");
+      wprintf(L"%lc Test %d passed\n", check, i);
+      num_passed++;
+    } else {
+      // set color to red
+      printf("\033[0;31m");
+      wprintf(L"%lc Test %d failed\n", cross, i);
+    }
+  }
+
+  destroy_iqueue(q);
+
+  if (num_passed == num_tests) {
+    // set color to green
+    printf("\033[0;32m");
+    printf("---------------------\n");
+    printf("All Intrusive Queue Tests Passed\n");
+    // reset color
+    printf("\033[0m");
+  } else {
+    // set color to red
+    printf("\033[0;31m");
+    printf("Passed %d/%d Intrusive Queue tests\n", num_passed, num_tests);
+    // reset color
+    printf("\033[0m");
+  }
+
+  return 0;
+}
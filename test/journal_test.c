@@ -0,0 +1,155 @@
+#include "journal.h"
+#include "testing.h"
+#include <pthread.h>
+
+#define TEST_RECORDS 4096
+#define NUM_WRITERS 4
+#define RECORDS_PER_WRITER 1000
+
+bool log_read(const char *name) {
+  // records come back out as they went in, then there's nothing left
+  journal_t *j = journal_create(name, TEST_RECORDS);
+  if (j == NULL)
+    return false;
+  plate_t plate = plate_encode("ABC123");
+  journal_log(j, JOURNAL_LPR_ARRIVED, JOURNAL_ENTRANCE, 2, plate, 0, 0);
+  journal_log(j, JOURNAL_SIGN_SET, JOURNAL_ENTRANCE, 2, plate, '3', 3);
+  uint64_t pos = journal_tail(j);
+  struct JournalRecord a, b;
+  bool passed = journal_read(j, &pos, &a) == JOURNAL_OK &&
+                journal_read(j, &pos, &b) == JOURNAL_OK &&
+                journal_read(j, &pos, &b) == JOURNAL_EMPTY && pos == 2;
+  passed = passed && a.type == JOURNAL_LPR_ARRIVED && a.plate == plate &&
+           a.device == JOURNAL_ENTRANCE && a.index == 2;
+  passed = passed && b.type == JOURNAL_SIGN_SET && b.value == '3' &&
+           b.arg == 3 && b.time_ns >= a.time_ns;
+  journal_close(j, true);
+  return passed;
+}
+
+bool wrap(const char *name) {
+  // once it's full the oldest go, and a reader that fell behind is told
+  journal_t *j = journal_create(name, TEST_RECORDS);
+  if (j == NULL)
+    return false;
+  for (int i = 0; i < TEST_RECORDS + 5; i++)
+    journal_log(j, JOURNAL_GATE_MOVED, JOURNAL_EXIT, 0, 0, 'O', i);
+  uint64_t pos = 0;
+  struct JournalRecord r;
+  bool passed = journal_read(j, &pos, &r) == JOURNAL_LOST && pos == 5;
+  for (int i = 5; passed && i < TEST_RECORDS + 5; i++)
+    passed = journal_read(j, &pos, &r) == JOURNAL_OK && r.arg == i;
+  passed = passed && journal_read(j, &pos, &r) == JOURNAL_EMPTY;
+  journal_close(j, true);
+  return passed;
+}
+
+bool open_existing(const char *name) {
+  // another process's view sees the same records, and nothing isn't a journal
+  if (journal_open(name) != NULL)
+    return false;
+  journal_t *j = journal_create(name, TEST_RECORDS);
+  journal_t *other = journal_open(name);
+  if (j == NULL || other == NULL)
+    return false;
+  journal_log(other, JOURNAL_ALARM, JOURNAL_NONE, 0, 0, 1, 0);
+  uint64_t pos = 0;
+  struct JournalRecord r;
+  bool passed = journal_read(j, &pos, &r) == JOURNAL_OK &&
+                r.type == JOURNAL_ALARM && r.value == 1;
+  journal_close(other, false);
+  journal_close(j, true);
+  // sizes that aren't a power of two are refused
+  return passed && journal_create(name, 1000) == NULL;
+}
+
+struct writer {
+  journal_t *j;
+  int id;
+};
+
+static void *write_records(void *arg) {
+  struct writer *w = arg;
+  for (int i = 0; i < RECORDS_PER_WRITER; i++)
+    journal_log(w->j, JOURNAL_LPR_READ, JOURNAL_LEVEL, w->id, 0, 0, i);
+  return NULL;
+}
+
+bool concurrent_writers(const char *name) {
+  // writers racing each other never lose or mix up a record
+  journal_t *j = journal_create(name, TEST_RECORDS);
+  if (j == NULL)
+    return false;
+  pthread_t threads[NUM_WRITERS];
+  struct writer writers[NUM_WRITERS];
+  for (int i = 0; i < NUM_WRITERS; i++) {
+    writers[i] = (struct writer){j, i};
+    pthread_create(&threads[i], NULL, write_records, &writers[i]);
+  }
+  for (int i = 0; i < NUM_WRITERS; i++)
+    pthread_join(threads[i], NULL);
+  // each writer's records are all there, in the order it wrote them
+  int next[NUM_WRITERS] = {0};
+  uint64_t pos = 0;
+  struct JournalRecord r;
+  bool passed = journal_head(j) == NUM_WRITERS * RECORDS_PER_WRITER;
+  while (passed && journal_read(j, &pos, &r) == JOURNAL_OK)
+    passed = r.index < NUM_WRITERS && r.arg == next[r.index]++;
+  for (int i = 0; passed && i < NUM_WRITERS; i++)
+    passed = next[i] == RECORDS_PER_WRITER;
+  journal_close(j, true);
+  return passed;
+}
+
+int main(void) {
+  // Initialise
+  // set color to yellow
+  printf("\033[0;33m");
+  printf("Testing Journal\n");
+  // reset color
+  printf("\033[0m");
+  const char *name = "PARKING_JOURNAL_TEST";
+
+  // Run tests
+  setlocale(LC_CTYPE, "");
+  wchar_t cross = 0x00D7;
+  wchar_t check = 0x2713;
+
+  int num_tests = 4;
+  bool (*funcs[4])(const char *name) = {
+      log_read,           /*0*/
+      wrap,               /*1*/
+      open_existing,      /*2*/
+      concurrent_writers, /*3*/
+  };
+  int num_passed = 0;
+  for (int i = 0; i < num_tests; i++) {
+    if ((*funcs[i])(name)) {
+      // set color to green
+      printf("\033[0;32m");
+      wprintf(L"%lc Test %d passed\n", check, i);
+      num_passed++;
+    } else {
+      // set color to red
+      printf("\033[0;31m");
+      wprintf(L"%lc Test %d failed\n", cross, i);
+    }
+  }
+
+  if (num_passed == num_tests) {
+    // set color to green
+    printf("\033[0;32m");
+    printf("---------------------\n");
+    printf("All Journal Tests passed\n");
+    // reset color
+    printf("\033[0m");
+  } else {
+    // set color to red
+    printf("\033[0;31m");
+    printf("Passed %d/%d tests\n", num_passed, num_tests);
+    // reset color
+    printf("\033[0m");
+  }
+
+  return 0;
+}
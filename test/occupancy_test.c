@@ -0,0 +1,289 @@
+#include "occupancy.h"
+#include "testing.h"
+#include <pthread.h>
+
+#define TEST_LEVELS 100 // more than one word of bitmap
+#define TEST_CAPACITY 3
+#define NUM_THREADS 4
+#define OPS_PER_THREAD 200000
+
+bool counts(occupancy_t *o) {
+  // cars are counted per level, never going below 0
+  if (occ_add(o, 5, 2) != 2 || occ_add(o, 5, -1) != 1 || occ_cars(o, 5) != 1)
+    return false;
+  if (occ_add(o, 5, -4) != 0 || occ_cars(o, 5) != 0)
+    return false;
+  // no such levels
+  return occ_add(o, -1, 1) == 0 && occ_add(o, TEST_LEVELS, 1) == 0 &&
+         occ_cars(o, TEST_LEVELS) == 0;
+}
+
+bool full_levels(occupancy_t *o) {
+  // a full level isn't picked, and is again once a car leaves
+  occ_add(o, 70, TEST_CAPACITY);
+  if (occ_num_free(o) != TEST_LEVELS - 1)
+    return false;
+  for (unsigned n = 0; n < 2 * TEST_LEVELS; n++) {
+    if (occ_pick(o, n) == 70)
+      return false;
+  }
+  occ_add(o, 70, -1);
+  return occ_num_free(o) == TEST_LEVELS;
+}
+
+bool picks_every_level(occupancy_t *o) {
+  // n from 0 to how many are free picks each free level once, in order
+  for (int i = 0; i < TEST_LEVELS; i += 2)
+    occ_add(o, i, TEST_CAPACITY);
+  bool passed = occ_num_free(o) == TEST_LEVELS / 2;
+  for (unsigned n = 0; n < TEST_LEVELS / 2; n++) {
+    if (occ_pick(o, n) != (int)n * 2 + 1)
+      passed = false;
+  }
+  for (int i = 0; i < TEST_LEVELS; i += 2)
+    occ_add(o, i, -TEST_CAPACITY);
+  return passed;
+}
+
+bool all_full(occupancy_t *o) {
+  // nothing to pick once every level is full
+  for (int i = 0; i < TEST_LEVELS; i++)
+    occ_add(o, i, TEST_CAPACITY);
+  bool passed = occ_num_free(o) == 0 && occ_pick(o, 12) == -1;
+  for (int i = 0; i < TEST_LEVELS; i++)
+    occ_add(o, i, -TEST_CAPACITY);
+  return passed && occ_pick(o, 12) == 12;
+}
+
+struct adder {
+  occupancy_t *o;
+  int id;
+};
+
+static void *add_remove(void *arg) {
+  struct adder *a = arg;
+  for (int i = 0; i < OPS_PER_THREAD; i++) {
+    // a few levels, so the threads are on the same ones around capacity
+    int level = (a->id + i) % 3;
+    occ_add(a->o, level, 1);
+    occ_add(a->o, level, -1);
+  }
+  return NULL;
+}
+
+bool bitmap_matches(occupancy_t *o) {
+  // however adds from many threads land, the bitmap ends up agreeing with
+  // the counts
+  for (int i = 0; i < 3; i++)
+    occ_add(o, i, TEST_CAPACITY - 1);
+  pthread_t threads[NUM_THREADS];
+  struct adder adders[NUM_THREADS];
+  for (int i = 0; i < NUM_THREADS; i++) {
+    adders[i] = (struct adder){o, i};
+    pthread_create(&threads[i], NULL, add_remove, &adders[i]);
+  }
+  for (int i = 0; i < NUM_THREADS; i++)
+    pthread_join(threads[i], NULL);
+  bool passed = occ_num_free(o) == TEST_LEVELS;
+  for (int i = 0; i < 3; i++) {
+    if (occ_cars(o, i) != TEST_CAPACITY - 1)
+      passed = false;
+    occ_add(o, i, TEST_CAPACITY);
+  }
+  return passed && occ_num_free(o) == TEST_LEVELS - 3;
+}
+
+bool least_loaded(occupancy_t *o) {
+  // the emptiest level, lowest first, and none once they're all full
+  (void)o;
+  occupancy_t *l = occ_create(5, TEST_CAPACITY);
+  bool passed = occ_least_loaded(l, 0, 0) == 0;
+  occ_add(l, 0, 1);
+  occ_add(l, 1, 2);
+  passed = passed && occ_least_loaded(l, 0, 0) == 2;
+  for (int i = 2; i < 5; i++)
+    occ_add(l, i, 2);
+  passed = passed && occ_least_loaded(l, 0, 0) == 0;
+  for (int i = 0; i < 5; i++)
+    occ_add(l, i, TEST_CAPACITY);
+  passed = passed && occ_least_loaded(l, 0, 0) == -1;
+  occ_add(l, 3, -3); // room for one
+  passed = passed && occ_least_loaded(l, 0, 0) == 3;
+  occ_destroy(l);
+  return passed;
+}
+
+static void *add_remove_many(void *arg) {
+  struct adder *a = arg;
+  for (int i = 0; i < OPS_PER_THREAD; i++) {
+    int level = (a->id * 31 + i * 7) % TEST_LEVELS;
+    occ_add(a->o, level, 1);
+    occ_add(a->o, level, -1);
+  }
+  return NULL;
+}
+
+bool least_loaded_threads(occupancy_t *o) {
+  // the tree ends up right however adds from many threads land
+  (void)o;
+  occupancy_t *l = occ_create(TEST_LEVELS, 1000);
+  for (int i = 0; i < TEST_LEVELS; i++)
+    occ_add(l, i, 2);
+  occ_add(l, 57, -1); // the least loaded
+  pthread_t threads[NUM_THREADS];
+  struct adder adders[NUM_THREADS];
+  for (int i = 0; i < NUM_THREADS; i++) {
+    adders[i] = (struct adder){l, i};
+    pthread_create(&threads[i], NULL, add_remove_many, &adders[i]);
+  }
+  for (int i = 0; i < NUM_THREADS; i++)
+    pthread_join(threads[i], NULL);
+  bool passed = occ_least_loaded(l, 0, 0) == 57;
+  occ_add(l, 57, 1);
+  passed = passed && occ_least_loaded(l, 0, 0) == 0;
+  occ_destroy(l);
+  return passed;
+}
+
+struct claimer {
+  occupancy_t *o;
+  int claimed; // spots it kept
+  bool over;   // saw the level over capacity
+};
+
+static void *claim_spots(void *arg) {
+  struct claimer *c = arg;
+  // take and give back spots, checking the level is never over
+  for (int i = 0; i < OPS_PER_THREAD; i++) {
+    if (occ_try_add(c->o, 0)) {
+      if (occ_cars(c->o, 0) > TEST_CAPACITY)
+        c->over = true;
+      occ_add(c->o, 0, -1);
+    }
+  }
+  // then keep whatever can be had
+  for (int i = 0; i < TEST_CAPACITY; i++) {
+    if (occ_try_add(c->o, 0))
+      c->claimed++;
+  }
+  return NULL;
+}
+
+bool try_add_threads(occupancy_t *o) {
+  // threads taking a nearly full level's last spots at once never put it
+  // over capacity, and get exactly the spots there were between them
+  (void)o;
+  occupancy_t *l = occ_create(2, TEST_CAPACITY);
+  occ_add(l, 0, TEST_CAPACITY - 1);
+  pthread_t threads[NUM_THREADS];
+  struct claimer claimers[NUM_THREADS];
+  for (int i = 0; i < NUM_THREADS; i++) {
+    claimers[i] = (struct claimer){l, 0, false};
+    pthread_create(&threads[i], NULL, claim_spots, &claimers[i]);
+  }
+  int claimed = 0;
+  bool passed = true;
+  for (int i = 0; i < NUM_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    claimed += claimers[i].claimed;
+    passed = passed && !claimers[i].over;
+  }
+  passed = passed && claimed == 1 && occ_cars(l, 0) == TEST_CAPACITY &&
+           !occ_try_add(l, 0) && occ_num_free(l) == 1 && !occ_try_add(l, 2);
+  occ_destroy(l);
+  return passed;
+}
+
+bool round_robin(occupancy_t *o) {
+  // every level in turn, skipping full ones
+  (void)o;
+  occupancy_t *l = occ_create(4, TEST_CAPACITY);
+  occ_add(l, 2, TEST_CAPACITY);
+  int want[] = {0, 1, 3, 3, 0, 1};
+  bool passed = true;
+  for (int i = 0; i < 6; i++) {
+    if (occ_round_robin(l, i % 3, 0) != want[i])
+      passed = false;
+  }
+  occ_destroy(l);
+  return passed;
+}
+
+bool spread(occupancy_t *o) {
+  // each entrance takes turns from a different level, so cars in through
+  // different entrances at once go to different levels
+  (void)o;
+  occupancy_t *l = occ_create(5, TEST_CAPACITY);
+  bool passed = true;
+  for (int turn = 0; turn < 3; turn++) {
+    bool used[5] = {false};
+    for (int entrance = 0; entrance < 5; entrance++) {
+      int level = occ_spread(l, entrance, 0);
+      if (level != (entrance + turn) % 5 || used[level])
+        passed = false;
+      used[level] = true;
+    }
+  }
+  occ_destroy(l);
+  return passed;
+}
+
+int main(void) {
+  // Initialise
+  // set color to yellow
+  printf("\033[0;33m");
+  printf("Testing Occupancy\n");
+  // reset color
+  printf("\033[0m");
+  occupancy_t *o = occ_create(TEST_LEVELS, TEST_CAPACITY);
+
+  // Run tests
+  setlocale(LC_CTYPE, "");
+  wchar_t cross = 0x00D7;
+  wchar_t check = 0x2713;
+
+  int num_tests = 10;
+  bool (*funcs[10])(occupancy_t * o) = {
+      counts,               /*0*/
+      full_levels,          /*1*/
+      picks_every_level,    /*2*/
+      all_full,             /*3*/
+      bitmap_matches,       /*4*/
+      least_loaded,         /*5*/
+      least_loaded_threads, /*6*/
+      round_robin,          /*7*/
+      spread,               /*8*/
+      try_add_threads,      /*9*/
+  };
+  int num_passed = 0;
+  for (int i = 0; i < num_tests; i++) {
+    if ((*funcs[i])(o)) {
+      // set color to green
+      printf("\033[0;32m");
+      wprintf(L"%lc Test %d passed\n", check, i);
+      num_passed++;
+    } else {
+      // set color to red
+      printf("\033[0;31m");
+      wprintf(L"%lc Test %d failed\n", cross, i);
+    }
+  }
+
+  if (num_passed == num_tests) {
+    // set color to green
+    printf("\033[0;32m");
+    printf("---------------------\n");
+    printf("All Occupancy Tests passed\n");
+    // reset color
+    printf("\033[0m");
+  } else {
+    // set color to red
+    printf("\033[0;31m");
+    printf("Passed %d/%d tests\n", num_passed, num_tests);
+    // reset color
+    printf("\033[0m");
+  }
+
+  occ_destroy(o);
+  return 0;
+}
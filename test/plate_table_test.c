@@ -0,0 +1,157 @@
+#include "plate_table.h"
+#include "testing.h"
+
+#define INITIAL_CAPACITY 4
+#define NUM_PLATES 1000
+#define TEST_PLATE plate_encode("ABC123")
+
+struct test_struct {
+  int a;
+  int b;
+};
+
+// nth distinct plate, AAA000, AAA001, ...
+static plate_t nth_plate(size_t n) {
+  char plate[PLATE_LEN];
+  for (int j = 5; j >= 3; j--) {
+    plate[j] = '0' + n % 10;
+    n /= 10;
+  }
+  for (int j = 2; j >= 0; j--) {
+    plate[j] = 'A' + n % 26;
+    n /= 26;
+  }
+  return plate_encode(plate);
+}
+
+bool add_item(ptab_t *t) {
+  // add one item (don't grow)
+  struct test_struct value = {1, 2};
+  if (!ptab_set(t, TEST_PLATE, &value))
+    return false;
+  return ptab_size(t) == 1;
+}
+
+bool add_items(ptab_t *t) {
+  // add heaps of items (grow the table a few times)
+  for (size_t i = 0; i < NUM_PLATES; i++) {
+    struct test_struct value = {(int)i, -(int)i};
+    if (!ptab_set(t, nth_plate(i), &value))
+      return false;
+  }
+  return ptab_size(t) == NUM_PLATES + 1 && ptab_capacity(t) > NUM_PLATES;
+}
+
+bool find(ptab_t *t) {
+  // find the item we added
+  struct test_struct *value = ptab_get(t, TEST_PLATE);
+  if (value == NULL)
+    return false;
+  return value->a == 1 && value->b == 2;
+}
+
+bool find_all(ptab_t *t) {
+  // every item survived growing
+  for (size_t i = 0; i < NUM_PLATES; i++) {
+    struct test_struct *value = ptab_get(t, nth_plate(i));
+    if (value == NULL || value->a != (int)i || value->b != -(int)i)
+      return false;
+  }
+  return true;
+}
+
+bool overwrite_item(ptab_t *t) {
+  // overwrite in place, size stays the same
+  struct test_struct value = {3, 4};
+  if (!ptab_set(t, TEST_PLATE, &value))
+    return false;
+  struct test_struct *found = ptab_get(t, TEST_PLATE);
+  return found && found->a == 3 && found->b == 4 &&
+         ptab_size(t) == NUM_PLATES + 1;
+}
+
+bool find_non_existent(ptab_t *t) {
+  // find a non-existent item, the empty plate is never in the table
+  return ptab_get(t, plate_encode("ZZZ999")) == NULL &&
+         ptab_get(t, PLATE_NONE) == NULL;
+}
+
+bool remove_items(ptab_t *t) {
+  // remove every other plate, the rest must still be found
+  for (size_t i = 0; i < NUM_PLATES; i += 2) {
+    if (!ptab_remove(t, nth_plate(i)))
+      return false;
+  }
+  for (size_t i = 0; i < NUM_PLATES; i++) {
+    struct test_struct *value = ptab_get(t, nth_plate(i));
+    if ((i % 2 == 0) != (value == NULL))
+      return false;
+  }
+  return ptab_size(t) == NUM_PLATES / 2 + 1;
+}
+
+bool remove_non_existent(ptab_t *t) {
+  // removing twice fails the second time
+  if (!ptab_remove(t, TEST_PLATE))
+    return false;
+  return !ptab_remove(t, TEST_PLATE) && ptab_get(t, TEST_PLATE) == NULL;
+}
+
+int main(void) {
+  // Initialise
+  // set color to yellow
+  printf("\033[0;33m");
+  printf("Testing Plate Table\n");
+  // reset color
+  printf("\033[0m");
+  ptab_t *t = ptab_create(INITIAL_CAPACITY, sizeof(struct test_struct));
+
+  // Run tests
+  setlocale(LC_CTYPE, "");
+  wchar_t cross = 0x00D7;
+  wchar_t check = 0x2713;
+
+  int num_tests = 8;
+  bool (*funcs[8])(ptab_t * t) = {
+      add_item,            /*0*/
+      add_items,           /*1*/
+      find,                /*2*/
+      find_all,            /*3*/
+      overwrite_item,      /*4*/
+      find_non_existent,   /*5*/
+      remove_items,        /*6*/
+      remove_non_existent, /*7*/
+  };
+  int num_passed = 0;
+  for (int i = 0; i < num_tests; i++) {
+    if ((*funcs[i])(t)) {
+      // set color to green
+      printf("\033[0;32m");
+      wprintf(L"%lc Test %d passed\n", check, i);
+      num_passed++;
+    } else {
+      // set color to red
+      printf("\033[0;31m");
+      wprintf(L"%lc Test %d failed\n", cross, i);
+    }
+  }
+
+  ptab_destroy(t);
+
+  if (num_passed == num_tests) {
+    // set color to green
+    printf("\033[0;32m");
+    printf("---------------------\n");
+    printf("All Plate Table Tests passed\n");
+    // reset color
+    printf("\033[0m");
+  } else {
+    // set color to red
+    printf("\033[0;31m");
+    printf("Passed %d/%d tests\n", num_passed, num_tests);
+    // reset color
+    printf("\033[0m");
+  }
+
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include "plate.h"
+#include "testing.h"
+
+bool encode_decode(void) {
+  // a plate comes back out the same as it went in
+  char str[PLATE_LEN + 1];
+  plate_t plate = plate_encode("029MZH");
+  return strcmp(plate_decode(plate, str), "029MZH") == 0;
+}
+
+bool encode_lpr_chars(void) {
+  // LPRs hold exactly 6 chars with no null-terminator
+  char lpr[8] = {'A', 'B', 'C', '1', '2', '3', 'X', 'Y'};
+  char chars[PLATE_LEN];
+  plate_t plate = plate_encode(lpr);
+  plate_to_chars(plate, chars);
+  return plate == plate_encode("ABC123") && memcmp(chars, lpr, 6) == 0;
+}
+
+bool empty_plate(void) {
+  // an empty LPR reads as no plate
+  char lpr[PLATE_LEN] = {0};
+  return plate_encode(lpr) == PLATE_NONE && plate_encode("") == PLATE_NONE;
+}
+
+bool validate(void) {
+  return plate_valid(plate_encode("ABC123")) &&
+         plate_valid(plate_encode("029MZH")) &&
+         !plate_valid(plate_encode("abc123")) &&
+         !plate_valid(plate_encode("AB12")) && !plate_valid(PLATE_NONE);
+}
+
+bool compare(void) {
+  // plates order the same as their strings
+  plate_t a = plate_encode("ABC123");
+  plate_t b = plate_encode("ABD000");
+  plate_t c = plate_encode("AB");
+  return plate_cmp(a, b) < 0 && plate_cmp(b, a) > 0 && plate_cmp(a, a) == 0 &&
+         plate_cmp(c, a) < 0 && plate_eq(a, plate_encode("ABC123")) &&
+         !plate_eq(a, b);
+}
+
+bool hash(void) {
+  // equal plates hash the same, neighbouring plates don't
+  return plate_hash(plate_encode("ABC123")) ==
+             plate_hash(plate_encode("ABC123")) &&
+         plate_hash(plate_encode("ABC123")) !=
+             plate_hash(plate_encode("ABC124"));
+}
+
+int main(void) {
+  // Initialise
+  // set color to yellow
+  printf("\033[0;33m");
+  printf("Testing Plates\n");
+  // reset color
+  printf("\033[0m");
+
+  // Run tests
+  setlocale(LC_CTYPE, "");
+  wchar_t cross = 0x00D7;
+  wchar_t check = 0x2713;
+
+  int num_tests = 6;
+  bool (*funcs[6])(void) = {
+      encode_decode,    /*0*/
+      encode_lpr_chars, /*1*/
+      empty_plate,      /*2*/
+      validate,         /*3*/
+      compare,          /*4*/
+      hash,             /*5*/
+  };
+  int num_passed = 0;
+  for (int i = 0; i < num_tests; i++) {
+    if ((*funcs[i])()) {
+      // set color to green
+      printf("\033[0;32m");
+      wprintf(L"%lc Test %d passed\n", check, i);
+      num_passed++;
+    } else {
+      // set color to red
+      printf("\033[0;31m");
+      wprintf(L"%lc Test %d failed\n", cross, i);
+    }
+  }
+
+  if (num_passed == num_tests) {
+    // set color to green
+    printf("\033[0;32m");
+    printf("---------------------\n");
+    printf("All Plate Tests passed\n");
+    // reset color
+    printf("\033[0m");
+  } else {
+    // set color to red
+    printf("\033[0;31m");
+    printf("Passed %d/%d tests\n", num_passed, num_tests);
+    // reset color
+    printf("\033[0m");
+  }
+
+  return 0;
+}
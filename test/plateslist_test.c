@@ -4,7 +4,7 @@
 
 bool add_one_plate(NumberPlates *p) {
   // add one plate
-  if (!add_plate(p, "ABC123"))
+  if (!add_plate(p, plate_encode("ABC123")))
     return false;
   return true;
 }
@@ -12,8 +12,7 @@ bool add_one_plate(NumberPlates *p) {
 bool add_some_plates(NumberPlates *p) {
   // add heaps of plates
   size_t num_plates = 100;
-  char plate[7];
-  plate[6] = '\0';
+  char plate[PLATE_LEN];
   for (size_t i = 0; i < num_plates; i++) {
     // generate a random licence plate as key -> ABC123:
     for (int j = 0; j < 6; j++) {
@@ -22,7 +21,7 @@ bool add_some_plates(NumberPlates *p) {
       else
         plate[j] = "0123456789"[(rand() % 10)];
     }
-    if (!add_plate(p, plate))
+    if (!add_plate(p, plate_encode(plate)))
       return false;
   }
   return true;
@@ -30,10 +29,8 @@ bool add_some_plates(NumberPlates *p) {
 
 bool get_random_plate(NumberPlates *p) {
   // get a random plate
-  char *plate = random_available_plate(p);
-  if (plate == NULL)
-    return false;
-  if (plate[6] != '\0')
+  plate_t plate = random_available_plate(p);
+  if (!plate_valid(plate))
     return false;
   return true;
 }
@@ -48,8 +45,8 @@ bool remove_all_plates(NumberPlates *p) {
 bool get_random_plate_none_available(NumberPlates *p) {
   // get a random plate when none are in the list, should still return
   // a plate because it will generate random
-  char *plate = random_available_plate(p);
-  if (plate == NULL)
+  plate_t plate = random_available_plate(p);
+  if (!plate_valid(plate))
     return false;
   return true;
 }
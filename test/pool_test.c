@@ -0,0 +1,159 @@
+#include "hashtable.h"
+#include "pool.h"
+#include "testing.h"
+#include <stdint.h>
+
+#define NUM_ALLOCS 10000
+
+bool aligned_and_distinct(pool_t *p) {
+  // blocks don't overlap and are 16-byte aligned
+  char *a = pool_alloc(p, 24);
+  char *b = pool_alloc(p, 24);
+  if (!a || !b || (uintptr_t)a % 16 || (uintptr_t)b % 16)
+    return false;
+  memset(a, 'a', 24);
+  memset(b, 'b', 24);
+  bool ok = a[23] == 'a' && b[0] == 'b';
+  pool_free(p, a, 24);
+  pool_free(p, b, 24);
+  return ok;
+}
+
+bool reuse_freed(pool_t *p) {
+  // a freed block is handed out again for the same size class
+  void *a = pool_alloc(p, 40);
+  pool_free(p, a, 40);
+  void *b = pool_alloc(p, 48);
+  pool_free(p, b, 48);
+  return a == b;
+}
+
+bool calloc_zeroed(pool_t *p) {
+  // a recycled block still comes back zeroed from pool_calloc
+  char *a = pool_alloc(p, 64);
+  memset(a, 0xFF, 64);
+  pool_free(p, a, 64);
+  char *b = pool_calloc(p, 64);
+  for (int i = 0; i < 64; i++) {
+    if (b[i] != 0)
+      return false;
+  }
+  pool_free(p, b, 64);
+  return true;
+}
+
+bool few_system_allocs(pool_t *p) {
+  // lots of small allocations only take a handful of slabs
+  struct pool_stats before, after;
+  pool_get_stats(p, &before);
+  for (int i = 0; i < NUM_ALLOCS; i++) {
+    if (!pool_alloc(p, 32))
+      return false;
+  }
+  pool_get_stats(p, &after);
+  return after.allocs - before.allocs == NUM_ALLOCS &&
+         after.system_allocs - before.system_allocs < NUM_ALLOCS / 100;
+}
+
+bool big_allocs(pool_t *p) {
+  // allocations bigger than a size class still work and can be freed
+  char *big = pool_alloc(p, 4096);
+  char *kept = pool_alloc(p, 1000);
+  if (!big || !kept)
+    return false;
+  memset(big, 1, 4096);
+  memset(kept, 2, 1000);
+  pool_free(p, big, 4096);
+  // kept is left for pool_destroy
+  return kept[999] == 2;
+}
+
+bool pooled_hashtable(pool_t *p) {
+  // a pooled hashtable behaves like any other and recycles removed items
+  (void)p;
+  ht_t *h = NULL;
+  h = htab_create_pooled(h, 10);
+  char key[24];
+  for (long long i = 0; i < NUM_ALLOCS; i++) {
+    sprintf(key, "KEY%lld", i);
+    if (!htab_set(h, key, &i, sizeof(long long)))
+      return false;
+  }
+  for (long long i = 0; i < NUM_ALLOCS; i += 2) {
+    sprintf(key, "KEY%lld", i);
+    htab_remove(h, key);
+  }
+  struct pool_stats before, after;
+  pool_get_stats(htab_pool(h), &before);
+  bool ok = htab_size(h) == NUM_ALLOCS / 2;
+  for (long long i = 0; i < NUM_ALLOCS; i++) {
+    sprintf(key, "KEY%lld", i);
+    long long *value = htab_get(h, key);
+    if ((i % 2 == 0) != (value == NULL) || (value && *value != i))
+      ok = false;
+    // put the removed ones back, they reuse the freed blocks
+    if (!value)
+      htab_set(h, key, &i, sizeof(long long));
+  }
+  pool_get_stats(htab_pool(h), &after);
+  ok = ok && after.slabs == before.slabs;
+  htab_destroy(h);
+  return ok;
+}
+
+int main(void) {
+  // Initialise
+  // set color to yellow
+  printf("\033[0;33m");
+  printf("Testing Pool\n");
+  // reset color
+  printf("\033[0m");
+  pool_t *p = pool_create();
+
+  // Run tests
+  setlocale(LC_CTYPE, "");
+  wchar_t cross = 0x00D7;
+  wchar_t check = 0x2713;
+
+  int num_tests = 6;
+  bool (*funcs[6])(pool_t * p) = {
+      aligned_and_distinct, /*0*/
+      reuse_freed,          /*1*/
+      calloc_zeroed,        /*2*/
+      few_system_allocs,    /*3*/
+      big_allocs,           /*4*/
+      pooled_hashtable,     /*5*/
+  };
+  int num_passed = 0;
+  for (int i = 0; i < num_tests; i++) {
+    if ((*funcs[i])(p)) {
+      // set color to green
+      printf("\033[0;32m");
+      wprintf(L"%lc Test %d passed\n", check, i);
+      num_passed++;
+    } else {
+      // set color to red
+      printf("\033[0;31m");
+      wprintf(L"%lc Test %d failed\n", cross, i);
+    }
+  }
+
+  pool_destroy(p);
+
+  if (num_passed == num_tests) {
+    // set color to green
+    printf("\033[0;32m");
+    printf("---------------------\n");
+    printf("All Pool Tests passed\n");
+    // reset color
+    printf("\033[0m");
+  } else {
+    // set color to red
+    printf("\033[0;31m");
+    printf("Passed %d/%d tests\n", num_passed, num_tests);
+    // reset color
+    printf("\033[0m");
+  }
+
+  return 0;
+}
@@ -62,6 +62,62 @@ bool has_item(Queue *q) {
   return true;
 }
 
+bool push_n_items(Queue *q) {
+  // push several items at once, they're all there in order
+  int values[5] = {1, 2, 3, 4, 5};
+  if (!queue_push_n(q, values, sizeof(int), 5) || q->length != 5)
+    return false;
+  QItem *item = queue_peek(q);
+  for (int i = 0; i < 5; i++, item = item->next) {
+    if (item == NULL || *(int *)item->value != values[i])
+      return false;
+  }
+  return item == NULL && *(int *)q->tail->value == 5;
+}
+
+// PRE: push_n_items has been called
+bool snapshot_items(Queue *q) {
+  // copies out the front items without removing any
+  int values[3];
+  if (queue_snapshot(q, values, sizeof(int), 3) != 3 || q->length != 5)
+    return false;
+  return values[0] == 1 && values[1] == 2 && values[2] == 3;
+}
+
+// PRE: push_n_items has been called
+bool drain_items(Queue *q) {
+  // drains up to max items in order, then whatever is left
+  int values[5] = {0};
+  if (queue_drain(q, values, sizeof(int), 2) != 2 || q->length != 3)
+    return false;
+  if (values[0] != 1 || values[1] != 2 || *(int *)queue_peek(q)->value != 3)
+    return false;
+  if (queue_drain(q, values, sizeof(int), 5) != 3)
+    return false;
+  if (values[0] != 3 || values[2] != 5)
+    return false;
+  return queue_drain(q, values, sizeof(int), 5) == 0 && is_empty(q) &&
+         q->length == 0;
+}
+
+bool record_stats(Queue *q) {
+  // batch pushes and drains are recorded item by item
+  QueueStats *stats = qstats_create(1000);
+  queue_set_stats(q, stats);
+  int values[4] = {1, 2, 3, 4};
+  queue_push_n(q, values, sizeof(int), 4);
+  queue_drain(q, values, sizeof(int), 4);
+  queue_set_stats(q, NULL);
+  QueueStats read;
+  qstats_read(stats, &read);
+  // only the first push is sampled, the rest are inside the interval
+  bool passed = read.pushed == 4 && read.popped == 4 &&
+                read.max_depth == 4 && read.num_samples == 1 &&
+                QSTATS_SAMPLE_DEPTH(read.series[0]) == 1;
+  qstats_destroy(stats);
+  return passed;
+}
+
 int main(void) {
   // Initialise
   // set color to yellow
@@ -76,15 +132,19 @@ int main(void) {
   wchar_t cross = 0x00D7;
   wchar_t check = 0x2713;
 
-  int num_tests = 7;
-  bool (*funcs[7])(Queue * q) = {
-      push_item,  /* 0 */
-      has_item,   /* 1 */
-      peek_item,  /* 2 */
-      push_item2, /* 3 */
-      pop_item,   /* 4 */
-      pop_item2,  /* 5 */
-      is_empty    /* 6 */
+  int num_tests = 11;
+  bool (*funcs[11])(Queue * q) = {
+      push_item,      /* 0 */
+      has_item,       /* 1 */
+      peek_item,      /* 2 */
+      push_item2,     /* 3 */
+      pop_item,       /* 4 */
+      pop_item2,      /* 5 */
+      is_empty,       /* 6 */
+      push_n_items,   /* 7 */
+      snapshot_items, /* 8 */
+      drain_items,    /* 9 */
+      record_stats    /* 10 */
   };
   int num_passed = 0;
   for (int i = 0; i < num_tests; i++) {
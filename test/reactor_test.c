@@ -0,0 +1,217 @@
+#include "reactor.h"
+#include "testing.h"
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_DEVICES 200
+#define NUM_WORKERS 3
+#define NUM_RINGERS 4
+#define RINGS_PER_RINGER 20000
+
+struct state {
+  int rings[TEST_DEVICES];
+  int timers[TEST_DEVICES];
+  uint64_t rung_at;
+  uint64_t timer_at;
+  int work[TEST_DEVICES]; // rings not handled yet
+  long handled;
+};
+
+static struct state state;
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Wait up to a second for *count to get to want
+static bool wait_for(int *count, int want) {
+  for (int i = 0; i < 1000; i++) {
+    if (__atomic_load_n(count, __ATOMIC_ACQUIRE) >= want)
+      return true;
+    usleep(1000);
+  }
+  return false;
+}
+
+static void count_ring(reactor_t *r, int device, void *arg) {
+  (void)r;
+  struct state *s = arg;
+  __atomic_add_fetch(&s->rings[device], 1, __ATOMIC_RELEASE);
+}
+
+static void count_timer(reactor_t *r, int device, void *arg) {
+  (void)r;
+  struct state *s = arg;
+  s->timer_at = now_us();
+  __atomic_add_fetch(&s->timers[device], 1, __ATOMIC_RELEASE);
+}
+
+bool ring_take(Doorbell *d) {
+  // rung bells come out once each, from where we start looking
+  doorbell_ring(d, 3);
+  doorbell_ring(d, 70);
+  doorbell_ring(d, 3);
+  if (doorbell_take(d, TEST_DEVICES, 50) != 70)
+    return false;
+  return doorbell_take(d, TEST_DEVICES, 50) == 3 &&
+         doorbell_take(d, TEST_DEVICES, 0) == -1;
+}
+
+bool ring_calls(Doorbell *d) {
+  // a ring gets to on_ring for its device, and only its device
+  memset(&state, 0, sizeof(state));
+  reactor_t *r = reactor_start(d, TEST_DEVICES, NUM_WORKERS, count_ring,
+                               count_timer, &state);
+  if (r == NULL)
+    return false;
+  doorbell_ring(d, 5);
+  doorbell_ring(d, 199);
+  bool passed = wait_for(&state.rings[5], 1) && wait_for(&state.rings[199], 1);
+  reactor_stop(r);
+  return passed && state.rings[6] == 0 && state.timers[5] == 0;
+}
+
+static void defer_10ms(reactor_t *r, int device, void *arg) {
+  struct state *s = arg;
+  s->rung_at = now_us();
+  reactor_defer(r, device, 10);
+}
+
+bool defer(Doorbell *d) {
+  // a deferred timer comes when it was asked for, not before
+  memset(&state, 0, sizeof(state));
+  reactor_t *r = reactor_start(d, TEST_DEVICES, NUM_WORKERS, defer_10ms,
+                               count_timer, &state);
+  if (r == NULL)
+    return false;
+  doorbell_ring(d, 42);
+  bool passed = wait_for(&state.timers[42], 1);
+  reactor_stop(r);
+  return passed && state.timer_at - state.rung_at >= 10000;
+}
+
+static void defer_twice(reactor_t *r, int device, void *arg) {
+  (void)arg;
+  reactor_defer(r, device, 500);
+  reactor_defer(r, device, 5);
+}
+
+bool redefer(Doorbell *d) {
+  // deferring again replaces the timer, it only comes once
+  memset(&state, 0, sizeof(state));
+  reactor_t *r = reactor_start(d, TEST_DEVICES, NUM_WORKERS, defer_twice,
+                               count_timer, &state);
+  if (r == NULL)
+    return false;
+  uint64_t start = now_us();
+  doorbell_ring(d, 7);
+  bool passed = wait_for(&state.timers[7], 1) && now_us() - start < 400000;
+  usleep(20000);
+  reactor_stop(r);
+  return passed && state.timers[7] == 1;
+}
+
+static void drain_work(reactor_t *r, int device, void *arg) {
+  (void)r;
+  struct state *s = arg;
+  // like the manager emptying an LPR, everything rung so far
+  int work = __atomic_exchange_n(&s->work[device], 0, __ATOMIC_ACQ_REL);
+  __atomic_add_fetch(&s->handled, work, __ATOMIC_RELEASE);
+}
+
+struct ringer {
+  Doorbell *d;
+  int id;
+};
+
+static void *ring_devices(void *arg) {
+  struct ringer *ringer = arg;
+  for (int i = 0; i < RINGS_PER_RINGER; i++) {
+    int device = (ringer->id * 7919 + i * 31) % TEST_DEVICES;
+    __atomic_add_fetch(&state.work[device], 1, __ATOMIC_RELEASE);
+    doorbell_ring(ringer->d, device);
+  }
+  return NULL;
+}
+
+bool no_lost_rings(Doorbell *d) {
+  // rings from many threads at once are all handled
+  memset(&state, 0, sizeof(state));
+  reactor_t *r = reactor_start(d, TEST_DEVICES, NUM_WORKERS, drain_work,
+                               count_timer, &state);
+  if (r == NULL)
+    return false;
+  pthread_t threads[NUM_RINGERS];
+  struct ringer ringers[NUM_RINGERS];
+  for (int i = 0; i < NUM_RINGERS; i++) {
+    ringers[i] = (struct ringer){d, i};
+    pthread_create(&threads[i], NULL, ring_devices, &ringers[i]);
+  }
+  for (int i = 0; i < NUM_RINGERS; i++)
+    pthread_join(threads[i], NULL);
+  long want = (long)NUM_RINGERS * RINGS_PER_RINGER;
+  for (int i = 0; i < 1000 && __atomic_load_n(&state.handled,
+                                               __ATOMIC_ACQUIRE) < want;
+       i++)
+    usleep(1000);
+  reactor_stop(r);
+  return state.handled == want;
+}
+
+int main(void) {
+  // Initialise
+  // set color to yellow
+  printf("\033[0;33m");
+  printf("Testing Doorbell and Reactor\n");
+  // reset color
+  printf("\033[0m");
+  Doorbell *d = calloc(1, DOORBELL_SIZE(TEST_DEVICES));
+
+  // Run tests
+  setlocale(LC_CTYPE, "");
+  wchar_t cross = 0x00D7;
+  wchar_t check = 0x2713;
+
+  int num_tests = 5;
+  bool (*funcs[5])(Doorbell * d) = {
+      ring_take,     /*0*/
+      ring_calls,    /*1*/
+      defer,         /*2*/
+      redefer,       /*3*/
+      no_lost_rings, /*4*/
+  };
+  int num_passed = 0;
+  for (int i = 0; i < num_tests; i++) {
+    if ((*funcs[i])(d)) {
+      // set color to green
+      printf("\033[0;32m");
+      wprintf(L"%lc Test %d passed\n", check, i);
+      num_passed++;
+    } else {
+      // set color to red
+      printf("\033[0;31m");
+      wprintf(L"%lc Test %d failed\n", cross, i);
+    }
+  }
+
+  if (num_passed == num_tests) {
+    // set color to green
+    printf("\033[0;32m");
+    printf("---------------------\n");
+    printf("All Reactor Tests passed\n");
+    // reset color
+    printf("\033[0m");
+  } else {
+    // set color to red
+    printf("\033[0;31m");
+    printf("Passed %d/%d tests\n", num_passed, num_tests);
+    // reset color
+    printf("\033[0m");
+  }
+
+  free(d);
+  return 0;
+}
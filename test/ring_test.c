@@ -0,0 +1,186 @@
+#include "queue.h"
+#include "testing.h"
+
+#define CAPACITY 8
+#define NUM_PRODUCERS 4
+#define NUM_CONSUMERS 4
+#define ITEMS_PER_PRODUCER 100000
+
+struct test_struct {
+  long a;
+  long b;
+};
+
+bool push_pop(Ring *r) {
+  // items come back out in order
+  for (long i = 0; i < 3; i++) {
+    struct test_struct item = {i, -i};
+    if (!ring_push(r, &item))
+      return false;
+  }
+  if (ring_length(r) != 3)
+    return false;
+  for (long i = 0; i < 3; i++) {
+    struct test_struct item;
+    if (!ring_pop(r, &item) || item.a != i || item.b != -i)
+      return false;
+  }
+  return ring_length(r) == 0;
+}
+
+bool empty(Ring *r) {
+  // nothing to pop without waiting
+  struct test_struct item;
+  return !ring_try_pop(r, &item);
+}
+
+bool full(Ring *r) {
+  // can't push more than the capacity, then there's room again after a pop
+  struct test_struct item = {1, -1};
+  for (int i = 0; i < CAPACITY; i++) {
+    if (!ring_push(r, &item))
+      return false;
+  }
+  if (ring_push(r, &item))
+    return false;
+  if (!ring_try_pop(r, &item) || !ring_push(r, &item))
+    return false;
+  // leave it empty for the next test
+  while (ring_try_pop(r, &item))
+    ;
+  return ring_length(r) == 0;
+}
+
+bool push_n(Ring *r) {
+  // pushes as many as fit, in order
+  struct test_struct items[CAPACITY + 2];
+  for (long i = 0; i < CAPACITY + 2; i++)
+    items[i] = (struct test_struct){i, -i};
+  if (ring_push_n(r, items, 3) != 3)
+    return false;
+  if (ring_push_n(r, items + 3, CAPACITY - 1) != CAPACITY - 3)
+    return false;
+  if (ring_push_n(r, items, 1) != 0)
+    return false;
+  for (long i = 0; i < CAPACITY; i++) {
+    struct test_struct item;
+    if (!ring_try_pop(r, &item) || item.a != i || item.b != -i)
+      return false;
+  }
+  return ring_length(r) == 0;
+}
+
+static void *producer(void *arg) {
+  Ring *r = arg;
+  for (long i = 1; i <= ITEMS_PER_PRODUCER; i++) {
+    struct test_struct item = {i, -i};
+    while (!ring_push(r, &item))
+      sched_yield();
+  }
+  return NULL;
+}
+
+static void *consumer(void *arg) {
+  Ring *r = arg;
+  long sum = 0;
+  struct test_struct item;
+  while (ring_pop(r, &item)) {
+    // a torn item would have a != -b
+    if (item.a != -item.b)
+      return (void *)-1;
+    sum += item.a;
+  }
+  return (void *)sum;
+}
+
+bool concurrent(Ring *r) {
+  // every item pushed is popped exactly once, then closing wakes every
+  // consumer
+  pthread_t producers[NUM_PRODUCERS];
+  pthread_t consumers[NUM_CONSUMERS];
+  for (int i = 0; i < NUM_CONSUMERS; i++)
+    pthread_create(&consumers[i], NULL, consumer, r);
+  for (int i = 0; i < NUM_PRODUCERS; i++)
+    pthread_create(&producers[i], NULL, producer, r);
+  for (int i = 0; i < NUM_PRODUCERS; i++)
+    pthread_join(producers[i], NULL);
+  // let the consumers drain it before closing
+  while (ring_length(r) > 0)
+    sched_yield();
+  ring_close(r);
+  long total = 0;
+  bool passed = true;
+  for (int i = 0; i < NUM_CONSUMERS; i++) {
+    void *sum;
+    pthread_join(consumers[i], &sum);
+    passed = passed && (long)sum >= 0;
+    total += (long)sum;
+  }
+  long expected =
+      NUM_PRODUCERS * (long)ITEMS_PER_PRODUCER * (ITEMS_PER_PRODUCER + 1) / 2;
+  return passed && total == expected;
+}
+
+bool closed(Ring *r) {
+  // nothing goes in or comes out once closed
+  struct test_struct item = {1, -1};
+  return !ring_push(r, &item) && !ring_pop(r, &item) &&
+         !ring_try_pop(r, &item);
+}
+
+int main(void) {
+  // Initialise
+  // set color to yellow
+  printf("\033[0;33m");
+  printf("Testing Ring\n");
+  // reset color
+  printf("\033[0m");
+  Ring *r = ring_create(CAPACITY, sizeof(struct test_struct));
+
+  // Run tests
+  setlocale(LC_CTYPE, "");
+  wchar_t cross = 0x00D7;
+  wchar_t check = 0x2713;
+
+  int num_tests = 6;
+  bool (*funcs[6])(Ring * r) = {
+      push_pop,   /*0*/
+      empty,      /*1*/
+      full,       /*2*/
+      push_n,     /*3*/
+      concurrent, /*4*/
+      closed,     /*5*/
+  };
+  int num_passed = 0;
+  for (int i = 0; i < num_tests; i++) {
+    if ((*funcs[i])(r)) {
+      // set color to green
+      printf("\033[0;32m");
+      wprintf(L"%lc Test %d passed\n", check, i);
+      num_passed++;
+    } else {
+      // set color to red
+      printf("\033[0;31m");
+      wprintf(L"%lc Test %d failed\n", cross, i);
+    }
+  }
+
+  ring_destroy(r);
+
+  if (num_passed == num_tests) {
+    // set color to green
+    printf("\033[0;32m");
+    printf("---------------------\n");
+    printf("All Ring Tests passed\n");
+    // reset color
+    printf("\033[0m");
+  } else {
+    // set color to red
+    printf("\033[0;31m");
+    printf("Passed %d/%d tests\n", num_passed, num_tests);
+    // reset color
+    printf("\033[0m");
+  }
+
+  return 0;
+}
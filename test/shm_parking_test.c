@@ -0,0 +1,346 @@
+/*
+The shared memory devices, in whichever layout this is built with. `make all`
+builds and runs it again with SHM_FUTEX, and with SHM_FUTEX and a ring of
+plates at each LPR (LPR_RING_SLOTS), see devicetests in the Makefile
+*/
+#include "shm_parking.h"
+#include "testing.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#define TEST_SHM_NAME "PARKING_TEST"
+#define NUM_PRODUCERS 4
+#define PLATES_PER_PRODUCER 5000
+
+static volatile int run = 1;
+
+static bool stopped(void) { return !run; }
+
+// let a thread get to sleep on a device
+static void settle(void) { usleep(20000); }
+
+struct waiter {
+  struct SharedMemory *shm;
+  int done; // set once the wait returns
+  bool result;
+  char plate[6];
+  uint32_t seq;
+  char status;
+};
+
+static void *wait_lpr(void *arg) {
+  struct waiter *w = arg;
+  w->result =
+      lpr_wait(&w->shm->entrances[0].lpr, w->plate, &w->seq, stopped);
+  __atomic_store_n(&w->done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+bool send_wait_ack(struct SharedMemory *shm) {
+  // a plate sent gets to the manager waiting for it, and once it's
+  // acknowledged the next one can be sent
+  struct LPR *lpr = &shm->entrances[0].lpr;
+  struct waiter w = {.shm = shm};
+  pthread_t thread;
+  pthread_create(&thread, NULL, wait_lpr, &w);
+  settle();
+  uint32_t seq = lpr_send(lpr, "ABC123");
+  pthread_join(thread, NULL);
+  if (!w.result || memcmp(w.plate, "ABC123", 6) != 0 || w.seq != seq)
+    return false;
+  lpr_ack(lpr, w.seq);
+  seq = lpr_send(lpr, "XYZ789");
+  char plate[6];
+  uint32_t read_seq;
+  bool passed = lpr_wait(lpr, plate, &read_seq, NULL) &&
+                memcmp(plate, "XYZ789", 6) == 0 && read_seq == seq;
+  lpr_ack(lpr, read_seq);
+  return passed;
+}
+
+static void *wait_gate(void *arg) {
+  struct waiter *w = arg;
+  w->status = gate_wait(&w->shm->entrances[0].gate, "O", stopped);
+  __atomic_store_n(&w->done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+static void *wait_sign(void *arg) {
+  struct waiter *w = arg;
+  int level;
+  w->status = sign_wait(&w->shm->entrances[0].sign, &level);
+  w->seq = level;
+  __atomic_store_n(&w->done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+bool gate_sign_wake(struct SharedMemory *shm) {
+  // waiters sleep through other states and wake for the one they want
+  struct waiter gate = {.shm = shm}, sign = {.shm = shm};
+  gate_set(&shm->entrances[0].gate, 'C');
+  sign_set(&shm->entrances[0].sign, '\0', 0);
+  pthread_t gate_thread, sign_thread;
+  pthread_create(&gate_thread, NULL, wait_gate, &gate);
+  pthread_create(&sign_thread, NULL, wait_sign, &sign);
+  settle();
+  gate_set(&shm->entrances[0].gate, 'R');
+  settle();
+  bool passed = !__atomic_load_n(&gate.done, __ATOMIC_ACQUIRE) &&
+                !__atomic_load_n(&sign.done, __ATOMIC_ACQUIRE);
+  gate_set(&shm->entrances[0].gate, 'O');
+  sign_set(&shm->entrances[0].sign, '3', 3);
+  pthread_join(gate_thread, NULL);
+  pthread_join(sign_thread, NULL);
+  passed = passed && gate.status == 'O' &&
+           gate_get(&shm->entrances[0].gate) == 'O';
+  int level;
+  return passed && sign.status == '3' && sign.seq == 3 &&
+         sign_get(&shm->entrances[0].sign, &level) == '3' && level == 3;
+}
+
+bool wake_stops(struct SharedMemory *shm) {
+  // once run is 0, lpr_wake and gate_wake get the waiters to give up
+  struct waiter lpr = {.shm = shm}, gate = {.shm = shm};
+  gate_set(&shm->entrances[0].gate, 'C');
+  pthread_t lpr_thread, gate_thread;
+  pthread_create(&lpr_thread, NULL, wait_lpr, &lpr);
+  pthread_create(&gate_thread, NULL, wait_gate, &gate);
+  settle();
+  run = 0;
+  lpr_wake(&shm->entrances[0].lpr);
+  gate_wake(&shm->entrances[0].gate);
+  pthread_join(lpr_thread, NULL);
+  pthread_join(gate_thread, NULL);
+  run = 1;
+  return !lpr.result && gate.status == '\0';
+}
+
+#if LPR_RING_SLOTS
+// the nth of a producer's plates, different for every producer and n
+static void test_plate(int producer, int n, char plate[6]) {
+  plate[0] = 'A' + producer;
+  for (int i = 5; i >= 1; i--) {
+    plate[i] = '0' + n % 10;
+    n /= 10;
+  }
+}
+
+// Put the LPR's counters at start, as if start plates had already been
+// through it (each slot holding the sequence number from last time round)
+static void ring_start_at(struct LPR *lpr, uint32_t start) {
+  for (uint32_t seq = start - LPR_RING_SLOTS; seq != start; seq++) {
+    fword_store(&lpr->slots[seq % LPR_RING_SLOTS].seq,
+                (seq + 1) & FWORD_VALUE_MASK);
+  }
+  fword_store(&lpr->head, start & FWORD_VALUE_MASK);
+  fword_store(&lpr->taken, start & FWORD_VALUE_MASK);
+  fword_store(&lpr->acked, start & FWORD_VALUE_MASK);
+}
+
+static void *send_one(void *arg) {
+  struct waiter *w = arg;
+  w->seq = lpr_send(&w->shm->entrances[1].lpr, "FUL000");
+  __atomic_store_n(&w->done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+bool ring_full(struct SharedMemory *shm) {
+  // a car blocks while the ring is full and goes once the manager's taken a
+  // plate out and acknowledged it
+  struct LPR *lpr = &shm->entrances[1].lpr;
+  char plate[6];
+  for (int i = 0; i < LPR_RING_SLOTS; i++) {
+    test_plate(0, i, plate);
+    lpr_send(lpr, plate);
+  }
+  struct waiter w = {.shm = shm};
+  pthread_t thread;
+  pthread_create(&thread, NULL, send_one, &w);
+  settle();
+  bool passed = !__atomic_load_n(&w.done, __ATOMIC_ACQUIRE);
+  uint32_t seq;
+  passed = passed && lpr_wait(lpr, plate, &seq, NULL);
+  lpr_ack(lpr, seq);
+  pthread_join(thread, NULL);
+  // then everything comes out in order, the last car's plate at the end
+  for (int i = 1; i <= LPR_RING_SLOTS; i++) {
+    passed = passed && lpr_wait(lpr, plate, &seq, NULL);
+    char want[6];
+    test_plate(0, i, want);
+    if (i == LPR_RING_SLOTS)
+      memcpy(want, "FUL000", 6);
+    passed = passed && memcmp(plate, want, 6) == 0;
+    lpr_ack(lpr, seq);
+  }
+  return passed && w.seq == (uint32_t)LPR_RING_SLOTS;
+}
+
+struct producer {
+  struct LPR *lpr;
+  int id;
+};
+
+static void *produce(void *arg) {
+  struct producer *p = arg;
+  char plate[6];
+  for (int i = 0; i < PLATES_PER_PRODUCER; i++) {
+    test_plate(p->id, i, plate);
+    lpr_send(p->lpr, plate);
+  }
+  return NULL;
+}
+
+bool many_producers(struct SharedMemory *shm) {
+  // cars sending to one LPR at once never lose or repeat a plate
+  struct LPR *lpr = &shm->entrances[2].lpr;
+  static char seen[NUM_PRODUCERS][PLATES_PER_PRODUCER];
+  memset(seen, 0, sizeof(seen));
+  pthread_t threads[NUM_PRODUCERS];
+  struct producer producers[NUM_PRODUCERS];
+  for (int i = 0; i < NUM_PRODUCERS; i++) {
+    producers[i] = (struct producer){lpr, i};
+    pthread_create(&threads[i], NULL, produce, &producers[i]);
+  }
+  bool passed = true;
+  for (int i = 0; i < NUM_PRODUCERS * PLATES_PER_PRODUCER; i++) {
+    char plate[6];
+    uint32_t seq;
+    lpr_wait(lpr, plate, &seq, NULL);
+    int producer = plate[0] - 'A';
+    int n = atoi((char[6]){plate[1], plate[2], plate[3], plate[4], plate[5]});
+    if (producer < 0 || producer >= NUM_PRODUCERS || n < 0 ||
+        n >= PLATES_PER_PRODUCER || seen[producer][n]++ || seq != (uint32_t)i)
+      passed = false;
+    lpr_ack(lpr, seq);
+  }
+  for (int i = 0; i < NUM_PRODUCERS; i++)
+    pthread_join(threads[i], NULL);
+  return passed;
+}
+
+struct turn {
+  struct LPR *lpr;
+  uint32_t seq;
+  int done;
+};
+
+static void *wait_turn(void *arg) {
+  struct turn *t = arg;
+  lpr_wait_turn(t->lpr, t->seq);
+  __atomic_store_n(&t->done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+// Plates through lpr from where its counters are, lpr_wait_turn only lets a
+// car go once every plate before it's been acknowledged
+static bool turns_in_order(struct LPR *lpr) {
+  uint32_t seqs[3];
+  seqs[0] = lpr_send(lpr, "TRN000");
+  seqs[1] = lpr_send(lpr, "TRN001");
+  seqs[2] = lpr_send(lpr, "TRN002");
+  // the first car's turn is now
+  lpr_wait_turn(lpr, seqs[0]);
+  struct turn last = {lpr, seqs[2], 0};
+  pthread_t thread;
+  pthread_create(&thread, NULL, wait_turn, &last);
+  char plate[6];
+  uint32_t seq;
+  bool passed = true;
+  for (int i = 0; i < 2; i++) {
+    settle();
+    passed = passed && !__atomic_load_n(&last.done, __ATOMIC_ACQUIRE);
+    passed = passed && lpr_wait(lpr, plate, &seq, NULL) && seq == seqs[i];
+    lpr_ack(lpr, seq);
+  }
+  pthread_join(thread, NULL);
+  passed = passed && lpr_wait(lpr, plate, &seq, NULL) && seq == seqs[2] &&
+           memcmp(plate, "TRN002", 6) == 0;
+  lpr_ack(lpr, seq);
+  return passed;
+}
+
+bool wait_turn_order(struct SharedMemory *shm) {
+  return turns_in_order(&shm->entrances[3].lpr);
+}
+
+bool seq_wrap(struct SharedMemory *shm) {
+  // sequence numbers wrap around at the top of the futex word's value
+  struct LPR *lpr = &shm->exits[0].lpr;
+  ring_start_at(lpr, FWORD_VALUE_MASK - 1);
+  if (!turns_in_order(lpr))
+    return false;
+  // the last plate went past the wrap, and a few more still go through
+  char plate[6];
+  uint32_t seq;
+  for (int i = 0; i < 3 * LPR_RING_SLOTS; i++) {
+    uint32_t sent = lpr_send(lpr, "WRP000");
+    lpr_wait_turn(lpr, sent);
+    if (!lpr_wait(lpr, plate, &seq, NULL) || seq != sent)
+      return false;
+    lpr_ack(lpr, seq);
+  }
+  return seq < FWORD_VALUE_MASK / 2;
+}
+#endif
+
+int main(void) {
+  // Initialise
+  // set color to yellow
+  printf("\033[0;33m");
+  printf("Testing Shared Memory Devices (%s)\n",
+         LPR_RING_SLOTS ? "futex, ring of plates"
+                        : (SHM_FUTEX ? "futex" : "mutex"));
+  // reset color
+  printf("\033[0m");
+  struct ShmTopology topology = {4, 1, 1, 10};
+  struct SharedMemory *shm = create_shm(TEST_SHM_NAME, &topology, 0);
+
+  // Run tests
+  setlocale(LC_CTYPE, "");
+  wchar_t cross = 0x00D7;
+  wchar_t check = 0x2713;
+
+  bool (*funcs[])(struct SharedMemory * shm) = {
+      send_wait_ack,   /*0*/
+      gate_sign_wake,  /*1*/
+      wake_stops,      /*2*/
+#if LPR_RING_SLOTS
+      ring_full,       /*3*/
+      many_producers,  /*4*/
+      wait_turn_order, /*5*/
+      seq_wrap,        /*6*/
+#endif
+  };
+  int num_tests = sizeof(funcs) / sizeof(funcs[0]);
+  int num_passed = 0;
+  for (int i = 0; i < num_tests; i++) {
+    if ((*funcs[i])(shm)) {
+      // set color to green
+      printf("\033[0;32m");
+      wprintf(L"%lc Test %d passed\n", check, i);
+      num_passed++;
+    } else {
+      // set color to red
+      printf("\033[0;31m");
+      wprintf(L"%lc Test %d failed\n", cross, i);
+    }
+  }
+
+  if (num_passed == num_tests) {
+    // set color to green
+    printf("\033[0;32m");
+    printf("---------------------\n");
+    printf("All Shared Memory Tests passed\n");
+    // reset color
+    printf("\033[0m");
+  } else {
+    // set color to red
+    printf("\033[0;31m");
+    printf("Passed %d/%d tests\n", num_passed, num_tests);
+    // reset color
+    printf("\033[0m");
+  }
+
+  destroy_shm(shm);
+  return 0;
+}
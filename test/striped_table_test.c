@@ -0,0 +1,187 @@
+#include "striped_table.h"
+#include "testing.h"
+#include <pthread.h>
+
+#define NUM_PLATES 1000
+#define NUM_WRITERS 2
+#define NUM_READERS 2
+#define ROUNDS 200000
+
+// both halves are always written together, a torn read would see a != -b
+struct test_struct {
+  long a;
+  long b;
+};
+
+static plate_t nth_plate(size_t n) {
+  char plate[PLATE_LEN];
+  for (int j = 5; j >= 3; j--) {
+    plate[j] = '0' + n % 10;
+    n /= 10;
+  }
+  for (int j = 2; j >= 0; j--) {
+    plate[j] = 'A' + n % 26;
+    n /= 26;
+  }
+  return plate_encode(plate);
+}
+
+bool add_items(sptab_t *t) {
+  // fill the table, starting small so the stripes grow
+  for (size_t i = 0; i < NUM_PLATES; i++) {
+    struct test_struct value = {(long)i, -(long)i};
+    if (!sptab_set(t, nth_plate(i), &value))
+      return false;
+  }
+  return sptab_size(t) == NUM_PLATES;
+}
+
+bool get_items(sptab_t *t) {
+  for (size_t i = 0; i < NUM_PLATES; i++) {
+    struct test_struct value;
+    if (!sptab_get(t, nth_plate(i), &value) || value.a != (long)i)
+      return false;
+  }
+  struct test_struct value;
+  return !sptab_get(t, plate_encode("ZZZ999"), &value);
+}
+
+static void negate(void *value, void *arg) {
+  struct test_struct *v = value;
+  v->a = *(long *)arg;
+  v->b = -v->a;
+}
+
+bool update_item(sptab_t *t) {
+  // update in place and get the result back
+  long a = 42;
+  struct test_struct result;
+  if (!sptab_update(t, nth_plate(7), negate, &a, &result))
+    return false;
+  if (result.a != 42 || result.b != -42)
+    return false;
+  // can't update a plate that isn't there
+  return !sptab_update(t, plate_encode("ZZZ999"), negate, &a, NULL);
+}
+
+bool upsert_item(sptab_t *t) {
+  // a new plate starts from init before being updated
+  long a = 5;
+  struct test_struct init = {0, 0};
+  struct test_struct result;
+  if (!sptab_upsert(t, plate_encode("ZZZ999"), &init, negate, &a, &result))
+    return false;
+  if (result.a != 5 || result.b != -5 || sptab_size(t) != NUM_PLATES + 1)
+    return false;
+  // an existing plate is updated without touching init
+  a = 6;
+  if (!sptab_upsert(t, plate_encode("ZZZ999"), &init, negate, &a, &result))
+    return false;
+  return result.a == 6 && sptab_remove(t, plate_encode("ZZZ999"));
+}
+
+static void *writer(void *arg) {
+  sptab_t *t = arg;
+  for (long i = 0; i < ROUNDS; i++) {
+    sptab_update(t, nth_plate(i % NUM_PLATES), negate, &i, NULL);
+  }
+  return NULL;
+}
+
+static void *reader(void *arg) {
+  sptab_t *t = arg;
+  long torn = 0;
+  for (long i = 0; i < ROUNDS; i++) {
+    struct test_struct value;
+    if (!sptab_get(t, nth_plate(i % NUM_PLATES), &value) ||
+        value.a != -value.b) {
+      torn++;
+    }
+  }
+  return (void *)torn;
+}
+
+bool concurrent_reads(sptab_t *t) {
+  // lock-free readers never see half of a write
+  pthread_t writers[NUM_WRITERS];
+  pthread_t readers[NUM_READERS];
+  for (int i = 0; i < NUM_WRITERS; i++)
+    pthread_create(&writers[i], NULL, writer, t);
+  for (int i = 0; i < NUM_READERS; i++)
+    pthread_create(&readers[i], NULL, reader, t);
+  bool passed = true;
+  for (int i = 0; i < NUM_READERS; i++) {
+    void *torn;
+    pthread_join(readers[i], &torn);
+    passed = passed && torn == NULL;
+  }
+  for (int i = 0; i < NUM_WRITERS; i++)
+    pthread_join(writers[i], NULL);
+  return passed;
+}
+
+bool remove_items(sptab_t *t) {
+  for (size_t i = 0; i < NUM_PLATES; i++) {
+    if (!sptab_remove(t, nth_plate(i)))
+      return false;
+  }
+  struct test_struct value;
+  return sptab_size(t) == 0 && !sptab_get(t, nth_plate(0), &value);
+}
+
+int main(void) {
+  // Initialise
+  // set color to yellow
+  printf("\033[0;33m");
+  printf("Testing Striped Table\n");
+  // reset color
+  printf("\033[0m");
+  sptab_t *t = sptab_create(8, sizeof(struct test_struct), 4);
+
+  // Run tests
+  setlocale(LC_CTYPE, "");
+  wchar_t cross = 0x00D7;
+  wchar_t check = 0x2713;
+
+  int num_tests = 6;
+  bool (*funcs[6])(sptab_t * t) = {
+      add_items,        /*0*/
+      get_items,        /*1*/
+      update_item,      /*2*/
+      upsert_item,      /*3*/
+      concurrent_reads, /*4*/
+      remove_items,     /*5*/
+  };
+  int num_passed = 0;
+  for (int i = 0; i < num_tests; i++) {
+    if ((*funcs[i])(t)) {
+      // set color to green
+      printf("\033[0;32m");
+      wprintf(L"%lc Test %d passed\n", check, i);
+      num_passed++;
+    } else {
+      // set color to red
+      printf("\033[0;31m");
+      wprintf(L"%lc Test %d failed\n", cross, i);
+    }
+  }
+
+  sptab_destroy(t);
+
+  if (num_passed == num_tests) {
+    // set color to green
+    printf("\033[0;32m");
+    printf("---------------------\n");
+    printf("All Striped Table Tests passed\n");
+    // reset color
+    printf("\033[0m");
+  } else {
+    // set color to red
+    printf("\033[0;31m");
+    printf("Passed %d/%d tests\n", num_passed, num_tests);
+    // reset color
+    printf("\033[0m");
+  }
+
+  return 0;
+}
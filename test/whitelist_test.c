@@ -0,0 +1,184 @@
+#include "testing.h"
+#include "whitelist.h"
+
+#define NUM_PLATES 1000
+#define TEXT_PATH "/tmp/whitelist_test.txt"
+#define IMAGE_PATH "/tmp/whitelist_test.wl"
+
+// nth distinct plate, AAA000, AAA001, ...
+static plate_t nth_plate(size_t n) {
+  char plate[PLATE_LEN];
+  for (int j = 5; j >= 3; j--) {
+    plate[j] = '0' + n % 10;
+    n /= 10;
+  }
+  for (int j = 2; j >= 0; j--) {
+    plate[j] = 'A' + n % 26;
+    n /= 26;
+  }
+  return plate_encode(plate);
+}
+
+// write NUM_PLATES plates, then the first 10 again and a blank line
+static bool write_text(void) {
+  FILE *fp = fopen(TEXT_PATH, "w");
+  if (fp == NULL)
+    return false;
+  char plate[PLATE_LEN + 1];
+  for (size_t i = 0; i < NUM_PLATES + 10; i++) {
+    fprintf(fp, "%s\n", plate_decode(nth_plate(i % NUM_PLATES), plate));
+  }
+  fprintf(fp, "\n");
+  return fclose(fp) == 0;
+}
+
+bool size(wl_t *wl) {
+  // repeats and blank lines aren't counted
+  return wl_size(wl) == NUM_PLATES;
+}
+
+bool contains_all(wl_t *wl) {
+  for (size_t i = 0; i < NUM_PLATES; i++) {
+    if (!wl_contains(wl, nth_plate(i)))
+      return false;
+  }
+  return true;
+}
+
+bool missing(wl_t *wl) {
+  // plates that were never in the file
+  for (size_t i = NUM_PLATES; i < NUM_PLATES * 2; i++) {
+    if (wl_contains(wl, nth_plate(i)))
+      return false;
+  }
+  return !wl_contains(wl, PLATE_NONE);
+}
+
+bool filter(wl_t *wl) {
+  // every plate on the list gets past the filter, most others don't
+  size_t passed = 0;
+  for (size_t i = 0; i < NUM_PLATES; i++) {
+    if (!wl_maybe_contains(wl, nth_plate(i)))
+      return false;
+    passed += wl_maybe_contains(wl, nth_plate(NUM_PLATES + i));
+  }
+  return passed < NUM_PLATES / 20;
+}
+
+bool no_filter(wl_t *wl) {
+  // without a filter everything might be there
+  (void)wl;
+  if (!wl_compile(TEXT_PATH, TEXT_PATH ".nf", 0))
+    return false;
+  wl_t *unfiltered = wl_open(TEXT_PATH ".nf");
+  remove(TEXT_PATH ".nf");
+  if (unfiltered == NULL)
+    return false;
+  bool ok = wl_maybe_contains(unfiltered, nth_plate(NUM_PLATES * 2)) &&
+            !wl_contains(unfiltered, nth_plate(NUM_PLATES * 2)) &&
+            wl_contains(unfiltered, nth_plate(0));
+  wl_close(unfiltered);
+  return ok;
+}
+
+bool in_order(wl_t *wl) {
+  // plates come back in the order they were in the file
+  for (size_t i = 0; i < NUM_PLATES; i++) {
+    if (wl_plate(wl, i) != nth_plate(i))
+      return false;
+  }
+  return wl_plate(wl, NUM_PLATES) == PLATE_NONE;
+}
+
+bool load(wl_t *wl) {
+  // loading an up to date image maps the same plates
+  wl_t *loaded = wl_load(TEXT_PATH, IMAGE_PATH);
+  if (loaded == NULL)
+    return false;
+  bool ok = wl_size(loaded) == wl_size(wl) &&
+            wl_contains(loaded, nth_plate(NUM_PLATES - 1));
+  wl_close(loaded);
+  return ok;
+}
+
+bool bad_image(wl_t *wl) {
+  (void)wl;
+  // anything that isn't a whole image is refused
+  FILE *fp = fopen(TEXT_PATH ".bad", "w");
+  if (fp == NULL)
+    return false;
+  fprintf(fp, "PLATEWL1 but not really an image\n");
+  fclose(fp);
+  wl_t *bad = wl_open(TEXT_PATH ".bad");
+  remove(TEXT_PATH ".bad");
+  return bad == NULL && wl_open(TEXT_PATH) == NULL;
+}
+
+int main(void) {
+  // Initialise
+  // set color to yellow
+  printf("\033[0;33m");
+  printf("Testing Whitelist\n");
+  // reset color
+  printf("\033[0m");
+  if (!write_text() || !wl_compile(TEXT_PATH, IMAGE_PATH, WL_FILTER_BITS)) {
+    perror("Error compiling test whitelist");
+    return 1;
+  }
+  wl_t *wl = wl_open(IMAGE_PATH);
+  if (wl == NULL) {
+    perror("Error opening test whitelist");
+    return 1;
+  }
+
+  // Run tests
+  setlocale(LC_CTYPE, "");
+  wchar_t cross = 0x00D7;
+  wchar_t check = 0x2713;
+
+  int num_tests = 8;
+  bool (*funcs[8])(wl_t * wl) = {
+      size,         /*0*/
+      contains_all, /*1*/
+      missing,      /*2*/
+      filter,       /*3*/
+      no_filter,    /*4*/
+      in_order,     /*5*/
+      load,         /*6*/
+      bad_image,    /*7*/
+  };
+  int num_passed = 0;
+  for (int i = 0; i < num_tests; i++) {
+    if ((*funcs[i])(wl)) {
+      // set color to green
+      printf("\033[0;32m");
+      wprintf(L"%lc Test %d passed\n", check, i);
+      num_passed++;
+    } else {
+      // set color to red
+      printf("\033[0;31m");
+      wprintf(L"%lc Test %d failed\n", cross, i);
+    }
+  }
+
+  wl_close(wl);
+  remove(TEXT_PATH);
+  remove(IMAGE_PATH);
+
+  if (num_passed == num_tests) {
+    // set color to green
+    printf("\033[0;32m");
+    printf("---------------------\n");
+    printf("All Whitelist Tests passed\n");
+    // reset color
+    printf("\033[0m");
+  } else {
+    // set color to red
+    printf("\033[0;31m");
+    printf("Passed %d/%d tests\n", num_passed, num_tests);
+    // reset color
+    printf("\033[0m");
+  }
+
+  return 0;
+}